@@ -4,6 +4,7 @@
 
 #include "Engine/Window/Window.h"
 #include "Engine/Frame/Frame.h"
+#include "Engine/Startup/CommandLineArgs.h"
 
 namespace RT
 {
@@ -12,11 +13,13 @@ namespace RT
 	{
 		std::string name;
 		std::function<Local<Frame>()> startupFrameMaker;
+		// Runs instead of the windowed application when started with --headless, returns the exit code
+		std::function<int32_t(const CommandLineArgs&)> headlessMain = {};
 	};
 
 	class Application final
 	{
-		friend void runCore();
+		friend int32_t runCore(const CommandLineArgs& args);
 	public:
 
 		void run();
@@ -50,4 +53,10 @@ namespace RT
 			return RT::ApplicationSpecs{ AppName, [] { return RT::makeLocal<StartupFrame>(); } }; \
 		}																						  \
 
+	#define RegisterStartupFrameWithHeadless(AppName, StartupFrame, HeadlessMain)							  \
+		RT::ApplicationSpecs CreateApplicationSpec()														  \
+		{																									  \
+			return RT::ApplicationSpecs{ AppName, [] { return RT::makeLocal<StartupFrame>(); }, HeadlessMain }; \
+		}																									  \
+
 }
@@ -0,0 +1,127 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#include "Engine/Core/Log.h"
+
+namespace RT
+{
+
+#ifdef _WIN32
+
+	MappedFile::MappedFile(const std::filesystem::path& path)
+	{
+		fileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (INVALID_HANDLE_VALUE == fileHandle)
+		{
+			fileHandle = nullptr;
+			return;
+		}
+
+		auto fileSize = LARGE_INTEGER{};
+		if (not GetFileSizeEx(fileHandle, &fileSize) or 0 == fileSize.QuadPart)
+		{
+			unmap();
+			return;
+		}
+
+		mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (nullptr == mappingHandle)
+		{
+			RT_LOG_ERROR("Failed to create file mapping: {}", path);
+			unmap();
+			return;
+		}
+
+		data = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+		size = nullptr != data ? static_cast<size_t>(fileSize.QuadPart) : 0u;
+		if (nullptr == data)
+		{
+			RT_LOG_ERROR("Failed to map view of file: {}", path);
+			unmap();
+		}
+	}
+
+	void MappedFile::unmap()
+	{
+		if (nullptr != data)
+		{
+			UnmapViewOfFile(data);
+		}
+		if (nullptr != mappingHandle)
+		{
+			CloseHandle(mappingHandle);
+		}
+		if (nullptr != fileHandle)
+		{
+			CloseHandle(fileHandle);
+		}
+
+		data = nullptr;
+		size = 0u;
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+	}
+
+#else
+
+	MappedFile::MappedFile(const std::filesystem::path& path)
+	{
+		fileDescriptor = open(path.c_str(), O_RDONLY);
+		if (-1 == fileDescriptor)
+		{
+			return;
+		}
+
+		struct stat fileStat = {};
+		if (-1 == fstat(fileDescriptor, &fileStat) or 0 == fileStat.st_size)
+		{
+			unmap();
+			return;
+		}
+
+		void* mapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+		if (MAP_FAILED == mapping)
+		{
+			RT_LOG_ERROR("Failed to map file: {}", path);
+			unmap();
+			return;
+		}
+
+		data = static_cast<const uint8_t*>(mapping);
+		size = static_cast<size_t>(fileStat.st_size);
+	}
+
+	void MappedFile::unmap()
+	{
+		if (nullptr != data)
+		{
+			munmap(const_cast<uint8_t*>(data), size);
+		}
+		if (-1 != fileDescriptor)
+		{
+			close(fileDescriptor);
+		}
+
+		data = nullptr;
+		size = 0u;
+		fileDescriptor = -1;
+	}
+
+#endif
+
+	MappedFile::~MappedFile()
+	{
+		unmap();
+	}
+
+}
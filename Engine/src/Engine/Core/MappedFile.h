@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+
+namespace RT
+{
+
+	/*
+	* Read only view of a whole file mapped into the address space. Pages are loaded
+	* lazily by the OS, so large binary blobs can be consumed without an extra copy.
+	*/
+	class MappedFile
+	{
+	public:
+		MappedFile(const std::filesystem::path& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool isValid() const { return nullptr != data; }
+		const uint8_t* getData() const { return data; }
+		size_t getSize() const { return size; }
+
+		template <typename T>
+		const T* as(const size_t offset = 0u) const
+		{
+			return reinterpret_cast<const T*>(data + offset);
+		}
+
+	private:
+		void unmap();
+
+	private:
+		const uint8_t* data = nullptr;
+		size_t size = 0u;
+
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#else
+		int fileDescriptor = -1;
+#endif
+	};
+
+}
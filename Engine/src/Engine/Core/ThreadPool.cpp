@@ -0,0 +1,131 @@
+#include "ThreadPool.h"
+
+namespace RT
+{
+
+	ThreadPool& ThreadPool::get()
+	{
+		static auto pool = ThreadPool{ std::max(std::thread::hardware_concurrency(), 1u) - 1u };
+		return pool;
+	}
+
+	ThreadPool::ThreadPool(const uint32_t workerCount)
+	{
+		queues.reserve(workerCount + 1u);
+		for (uint32_t i = 0u; i <= workerCount; i++)
+		{
+			queues.push_back(makeLocal<Queue>());
+		}
+
+		workers.reserve(workerCount);
+		for (uint32_t i = 0u; i < workerCount; i++)
+		{
+			workers.emplace_back([this, i] { workerLoop(i + 1u); });
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			auto lock = std::lock_guard{ sleepMutex };
+			isStopping = true;
+		}
+		wakeUp.notify_all();
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::run(TaskGroup& group, Task task)
+	{
+		group.pending.fetch_add(1u, std::memory_order_relaxed);
+		{
+			auto lock = std::lock_guard{ sleepMutex };
+			queuedCnt++;
+		}
+		{
+			auto& queue = *queues[currentQueue];
+			auto lock = std::lock_guard{ queue.mutex };
+			queue.entries.push_back(Entry{ std::move(task), &group });
+		}
+		wakeUp.notify_one();
+	}
+
+	void ThreadPool::wait(TaskGroup& group)
+	{
+		while (not group.isDone())
+		{
+			if (not tryRunTask())
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void ThreadPool::workerLoop(const uint32_t workerIdx)
+	{
+		currentQueue = workerIdx;
+
+		while (true)
+		{
+			if (tryRunTask())
+			{
+				continue;
+			}
+
+			auto lock = std::unique_lock{ sleepMutex };
+			wakeUp.wait(lock, [this] { return isStopping or queuedCnt > 0u; });
+			if (isStopping)
+			{
+				return;
+			}
+		}
+	}
+
+	bool ThreadPool::tryRunTask()
+	{
+		auto entry = Entry{};
+		if (not popTask(entry))
+		{
+			return false;
+		}
+
+		entry.task();
+		entry.group->pending.fetch_sub(1u, std::memory_order_release);
+		return true;
+	}
+
+	bool ThreadPool::popTask(Entry& entry)
+	{
+		{
+			auto& own = *queues[currentQueue];
+			auto lock = std::lock_guard{ own.mutex };
+			if (not own.entries.empty())
+			{
+				entry = std::move(own.entries.back());
+				own.entries.pop_back();
+				queuedCnt--;
+				return true;
+			}
+		}
+
+		const uint32_t queueCnt = queues.size();
+		for (uint32_t offset = 1u; offset < queueCnt; offset++)
+		{
+			auto& victim = *queues[(currentQueue + offset) % queueCnt];
+			auto lock = std::lock_guard{ victim.mutex };
+			if (not victim.entries.empty())
+			{
+				entry = std::move(victim.entries.front());
+				victim.entries.pop_front();
+				queuedCnt--;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+}
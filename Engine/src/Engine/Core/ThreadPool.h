@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Engine/Core/Base.h"
+
+namespace RT
+{
+
+	class TaskGroup
+	{
+		friend class ThreadPool;
+	public:
+		TaskGroup() = default;
+		~TaskGroup() = default;
+
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+
+		bool isDone() const { return 0u == pending.load(std::memory_order_acquire); }
+
+	private:
+		std::atomic<uint32_t> pending = 0u;
+	};
+
+	/*
+	* Work stealing pool. Every worker owns a deque, pops its own tasks from the back
+	* and steals from the front of the others. Threads waiting on a TaskGroup keep
+	* executing queued tasks, so nested fork/join never blocks the pool.
+	*/
+	class ThreadPool
+	{
+	public:
+		using Task = std::function<void()>;
+
+		static ThreadPool& get();
+
+		void run(TaskGroup& group, Task task);
+		void wait(TaskGroup& group);
+
+		template <typename Func>
+		void parallelFor(const uint32_t begin, const uint32_t end, const uint32_t grain, Func&& func);
+
+		uint32_t getThreadCount() const { return workers.size() + 1u; }
+
+	private:
+		struct Entry
+		{
+			Task task;
+			TaskGroup* group;
+		};
+
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<Entry> entries;
+		};
+
+	private:
+		ThreadPool(const uint32_t workerCount);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		void workerLoop(const uint32_t workerIdx);
+		bool tryRunTask();
+		bool popTask(Entry& entry);
+
+	private:
+		std::vector<Local<Queue>> queues = {};
+		std::vector<std::thread> workers = {};
+
+		std::mutex sleepMutex = {};
+		std::condition_variable wakeUp = {};
+		std::atomic<uint32_t> queuedCnt = 0u;
+		bool isStopping = false;
+
+		inline static thread_local uint32_t currentQueue = 0u;
+	};
+
+	template <typename Func>
+	void ThreadPool::parallelFor(const uint32_t begin, const uint32_t end, const uint32_t grain, Func&& func)
+	{
+		const uint32_t step = grain > 0u ? grain : 1u;
+		if (end - begin <= step)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				func(i);
+			}
+			return;
+		}
+
+		auto group = TaskGroup{};
+		for (uint32_t first = begin; first < end; first += step)
+		{
+			const uint32_t last = end - first > step ? first + step : end;
+			run(group, [&func, first, last]
+			{
+				for (uint32_t i = first; i < last; i++)
+				{
+					func(i);
+				}
+			});
+		}
+		wait(group);
+	}
+
+}
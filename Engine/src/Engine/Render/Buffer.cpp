@@ -46,6 +46,7 @@ namespace RT
 			{
 				case UniformType::Uniform: return "Uniform";
 				case UniformType::Storage: return "Storage";
+				case UniformType::StaticStorage: return "StaticStorage";
 				case UniformType::Sampler: return "Sampler";
 				case UniformType::Image:   return "Image";
 			}
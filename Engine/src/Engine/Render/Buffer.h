@@ -31,11 +31,14 @@ namespace RT
 		static Local<VertexBuffer> create(const uint32_t size, const void* data);
 	};
 
+	// StaticStorage lives in device local memory shared by all frames in flight and is written through
+	// a staging copy without keeping a CPU side copy. It binds like Storage in pipeline layouts.
 	enum class UniformType
 	{
 		None,
 		Uniform,
 		Storage,
+		StaticStorage,
 		Sampler,
 		Image
 	};
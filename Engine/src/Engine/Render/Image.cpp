@@ -0,0 +1,147 @@
+#include "Image.h"
+
+#include "Engine/Utils/LogDefinitions.h"
+
+#include "stb_image.h"
+#include "stb_image_write.h"
+
+namespace RT
+{
+
+	Image::Image(const glm::uvec2 size)
+		: pixels(size.x * size.y, glm::vec4{ 0.0f })
+		, size{size}
+	{
+	}
+
+	Image::Image(const std::filesystem::path& path, const Texture::Filter filter, const Texture::Mode mode)
+		: filter{filter}
+		, mode{mode}
+	{
+		// Same orientation and 8 bit conversion as the GPU textures
+		stbi_set_flip_vertically_on_load(1);
+		RT_LOG_INFO("Loading Image: {{ path = {} }}", path);
+
+		int32_t bytesPerPixel = 0;
+		auto* data = stbi_load(path.string().c_str(), (int32_t*)&size.x, (int32_t*)&size.y, &bytesPerPixel, STBI_rgb_alpha);
+		if (data == nullptr)
+		{
+			RT_LOG_WARN("Couldn't load image");
+			size = {};
+			return;
+		}
+
+		pixels.resize(size.x * size.y);
+		for (size_t i = 0u; i < pixels.size(); i++)
+		{
+			pixels[i] = glm::vec4{ data[4u * i + 0u], data[4u * i + 1u], data[4u * i + 2u], data[4u * i + 3u] } / 255.0f;
+		}
+
+		RT_LOG_INFO("Image loaded: {{ size = {} }}", size);
+		stbi_image_free(data);
+	}
+
+	glm::vec4 Image::sample(const glm::vec2 uv) const
+	{
+		if (not isValid())
+		{
+			return glm::vec4{ 0.0f };
+		}
+
+		const auto coord = uv * glm::vec2{ size };
+		if (Texture::Filter::Linear != filter)
+		{
+			const auto texelCoord = glm::ivec2{ glm::floor(coord) };
+			return texel(texelCoord.x, texelCoord.y);
+		}
+
+		// Texel centers sit at half coordinates, blend the four surrounding ones
+		const auto centered = coord - 0.5f;
+		const auto base = glm::floor(centered);
+		const auto weight = centered - base;
+		const int32_t x = (int32_t)base.x;
+		const int32_t y = (int32_t)base.y;
+
+		const auto bottom = glm::mix(texel(x, y), texel(x + 1, y), weight.x);
+		const auto top = glm::mix(texel(x, y + 1), texel(x + 1, y + 1), weight.x);
+		return glm::mix(bottom, top, weight.y);
+	}
+
+	bool Image::write(const std::filesystem::path& path) const
+	{
+		if (not isValid())
+		{
+			RT_LOG_WARN("Couldn't write empty image: {{ path = {} }}", path);
+			return false;
+		}
+
+		// Images are stored bottom row first like the textures they mirror
+		stbi_flip_vertically_on_write(1);
+
+		bool isWritten = false;
+		if (".hdr" == path.extension())
+		{
+			isWritten = 0 != stbi_write_hdr(path.string().c_str(), size.x, size.y, 4, &pixels[0].x);
+		}
+		else
+		{
+			auto data = std::vector<uint8_t>(4u * pixels.size());
+			for (size_t i = 0u; i < pixels.size(); i++)
+			{
+				const auto color = glm::clamp(pixels[i], 0.0f, 1.0f) * 255.0f + 0.5f;
+				for (uint8_t channel = 0u; channel < 4u; channel++)
+				{
+					data[4u * i + channel] = (uint8_t)color[channel];
+				}
+			}
+			isWritten = 0 != stbi_write_png(path.string().c_str(), size.x, size.y, 4, data.data(), 4 * size.x);
+		}
+
+		if (not isWritten)
+		{
+			RT_LOG_WARN("Couldn't write image: {{ path = {} }}", path);
+		}
+		return isWritten;
+	}
+
+	glm::vec4 Image::texel(int32_t x, int32_t y) const
+	{
+		if (not wrap(x, size.x) or not wrap(y, size.y))
+		{
+			return glm::vec4{ 0.0f };
+		}
+		return pixels[y * size.x + x];
+	}
+
+	bool Image::wrap(int32_t& coord, const int32_t extent) const
+	{
+		switch (mode)
+		{
+			case Texture::Mode::Repeat:
+			{
+				coord %= extent;
+				coord += coord < 0 ? extent : 0;
+				return true;
+			}
+			case Texture::Mode::Mirrored:
+			{
+				const int32_t period = 2 * extent;
+				coord %= period;
+				coord += coord < 0 ? period : 0;
+				coord = coord < extent ? coord : period - 1 - coord;
+				return true;
+			}
+			case Texture::Mode::ClampToEdge:
+			{
+				coord = glm::clamp(coord, 0, extent - 1);
+				return true;
+			}
+			case Texture::Mode::ClampToBorder:
+			{
+				return 0 <= coord and coord < extent;
+			}
+		}
+		return false;
+	}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Texture.h"
+
+namespace RT
+{
+
+	/*
+	* Host side float image. Loads through the same path as textures, so CPU renderers
+	* sample exactly the texels the GPU sees, and writes results back to disk.
+	*/
+	class Image
+	{
+	public:
+		Image() = default;
+		Image(const glm::uvec2 size);
+		Image(
+			const std::filesystem::path& path,
+			const Texture::Filter filter = Texture::Filter::Linear,
+			const Texture::Mode mode = Texture::Mode::Repeat);
+
+		bool isValid() const { return not pixels.empty(); }
+		const glm::uvec2 getSize() const { return size; }
+
+		glm::vec4& at(const uint32_t x, const uint32_t y) { return pixels[y * size.x + x]; }
+		const glm::vec4& at(const uint32_t x, const uint32_t y) const { return pixels[y * size.x + x]; }
+
+		glm::vec4 sample(const glm::vec2 uv) const;
+
+		// Format is picked by the extension, .hdr keeps floats and anything else is stored as 8 bit png
+		bool write(const std::filesystem::path& path) const;
+
+	private:
+		glm::vec4 texel(int32_t x, int32_t y) const;
+		bool wrap(int32_t& coord, const int32_t extent) const;
+
+	private:
+		std::vector<glm::vec4> pixels = {};
+		glm::uvec2 size = {};
+		Texture::Filter filter = Texture::Filter::Linear;
+		Texture::Mode mode = Texture::Mode::Repeat;
+	};
+
+}
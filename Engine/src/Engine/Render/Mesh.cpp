@@ -1,5 +1,6 @@
 #include "Mesh.h"
 
+#include "Engine/Render/MeshFile.h"
 #include "External/Render/Common/MeshLoader.h"
 
 #include <glm/gtc/matrix_transform.hpp>
@@ -8,13 +9,21 @@ namespace RT
 {
 
 	Mesh::Mesh(const std::vector<Triangle>& buffer)
-		: model{buffer}
-		, volume{
+		: volume{
 			glm::vec3{ std::numeric_limits<float>::max() }, 0,
 			glm::vec3{ std::numeric_limits<float>::lowest() }, 0}
 	{
-		for (const auto& tri : model)
+		// Hand built triangles keep their own corners, they may differ in uv where positions meet
+		model.vertices.reserve(3u * buffer.size());
+		model.indices.reserve(buffer.size());
+		for (const auto& tri : buffer)
 		{
+			const uint32_t first = model.vertices.size();
+			model.vertices.push_back(Vertex{ tri.A, tri.uvA });
+			model.vertices.push_back(Vertex{ tri.B, tri.uvB });
+			model.vertices.push_back(Vertex{ tri.C, tri.uvC });
+			model.indices.push_back(glm::uvec3{ first, first + 1u, first + 2u });
+
 			volume.leftBottomFront = glm::min(volume.leftBottomFront, tri.A);
 			volume.leftBottomFront = glm::min(volume.leftBottomFront, tri.B);
 			volume.leftBottomFront = glm::min(volume.leftBottomFront, tri.C);
@@ -34,6 +43,12 @@ namespace RT
 
 		model = loader.buildModel();
 		volume = loader.buildVolume();
+		sourcePath = path;
+	}
+
+	bool Mesh::save(const std::filesystem::path& path, std::span<const uint8_t> extension) const
+	{
+		return MeshFile::write(path, model, volume, extension);
 	}
 
 	MeshInstance::MeshInstance(const int32_t meshId)
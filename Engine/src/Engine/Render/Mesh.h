@@ -1,5 +1,6 @@
 #pragma once
 #include "filesystem"
+#include <span>
 
 #include <glm/glm.hpp>
 
@@ -32,6 +33,19 @@ namespace RT
 	};
 	#pragma pack(pop)
 	
+	struct Vertex
+	{
+		glm::vec3 position;
+		glm::vec2 uv;
+	};
+
+	// Shared vertices and one index triplet per triangle, a vertex used by several triangles is stored once
+	struct Model
+	{
+		std::vector<Vertex> vertices;
+		std::vector<glm::uvec3> indices;
+	};
+
 	#pragma pack(push, 1)
 	struct Box
 	{
@@ -50,13 +64,18 @@ namespace RT
 		Mesh(const std::vector<Triangle>& buffer);
 
 		void load(const std::filesystem::path& path);
+		// Writes the native .rtmesh format, extension is stored untouched next to the streams
+		bool save(const std::filesystem::path& path, std::span<const uint8_t> extension = {}) const;
 
-		const std::vector<Triangle>& getModel() const { return model; }
+		const Model& getModel() const { return model; }
+		uint32_t getTriangleCount() const { return model.indices.size(); }
 		const Box& getVolume() const { return volume; }
+		const std::filesystem::path& getSourcePath() const { return sourcePath; }
 
 	private:
-		std::vector<Triangle> model;
+		Model model = {};
 		Box volume = {};
+		std::filesystem::path sourcePath = {};
 	};
 
 	class MeshInstance
@@ -0,0 +1,130 @@
+#include "MeshFile.h"
+
+#include <fstream>
+
+#include "Engine/Core/Log.h"
+
+namespace
+{
+
+	constexpr uint64_t alignUp(const uint64_t offset, const uint64_t alignment)
+	{
+		return (offset + alignment - 1u) / alignment * alignment;
+	}
+
+	bool isInside(const uint64_t offset, const uint64_t size, const uint64_t fileSize)
+	{
+		return offset <= fileSize and size <= fileSize - offset;
+	}
+
+}
+
+namespace RT
+{
+
+	MeshFile::MeshFile(const std::filesystem::path& path)
+		: file{ path }
+	{
+		if (not file.isValid() or file.getSize() < sizeof(Header))
+		{
+			return;
+		}
+
+		const auto* fileHeader = file.as<Header>();
+		const uint64_t verticesSize = sizeof(Vertex) * (uint64_t)fileHeader->vertexCnt;
+		const uint64_t indicesSize = sizeof(glm::uvec3) * (uint64_t)fileHeader->triangleCnt;
+		if (magic != fileHeader->magic or version != fileHeader->version)
+		{
+			RT_LOG_ERROR("Unsupported mesh file {}", path);
+			return;
+		}
+
+		const bool isAligned = 0u == fileHeader->verticesOffset % alignment and 0u == fileHeader->indicesOffset % alignment;
+		if (not isAligned
+			or not isInside(fileHeader->verticesOffset, verticesSize, file.getSize())
+			or not isInside(fileHeader->indicesOffset, indicesSize, file.getSize())
+			or not isInside(fileHeader->extensionOffset, fileHeader->extensionSize, file.getSize()))
+		{
+			RT_LOG_ERROR("Corrupted mesh file {}", path);
+			return;
+		}
+
+		// Indices are copied into the model as they are, one past the vertices would be read by the BVH build and the shader
+		const auto* indices = file.as<glm::uvec3>(fileHeader->indicesOffset);
+		uint32_t maxIndex = 0u;
+		for (uint32_t triangle = 0u; triangle < fileHeader->triangleCnt; triangle++)
+		{
+			maxIndex = glm::max(maxIndex, glm::max(indices[triangle].x, glm::max(indices[triangle].y, indices[triangle].z)));
+		}
+		if (fileHeader->triangleCnt > 0u and maxIndex >= fileHeader->vertexCnt)
+		{
+			RT_LOG_ERROR("Corrupted mesh file {}, index {} past {} vertices", path, maxIndex, fileHeader->vertexCnt);
+			return;
+		}
+
+		header = fileHeader;
+	}
+
+	std::span<const Vertex> MeshFile::getVertices() const
+	{
+		return { file.as<Vertex>(header->verticesOffset), header->vertexCnt };
+	}
+
+	std::span<const glm::uvec3> MeshFile::getIndices() const
+	{
+		return { file.as<glm::uvec3>(header->indicesOffset), header->triangleCnt };
+	}
+
+	std::span<const uint8_t> MeshFile::getExtension() const
+	{
+		return { file.as<uint8_t>(header->extensionOffset), header->extensionSize };
+	}
+
+	bool MeshFile::write(const std::filesystem::path& path, const Model& model, const Box& volume, std::span<const uint8_t> extension)
+	{
+		auto header = Header{
+			.magic = magic,
+			.version = version,
+			.vertexCnt = (uint32_t)model.vertices.size(),
+			.triangleCnt = (uint32_t)model.indices.size(),
+			.volume = volume };
+		header.verticesOffset = alignUp(sizeof(Header), alignment);
+		header.indicesOffset = alignUp(header.verticesOffset + sizeof(Vertex) * model.vertices.size(), alignment);
+		header.extensionOffset = alignUp(header.indicesOffset + sizeof(glm::uvec3) * model.indices.size(), alignment);
+		header.extensionSize = extension.size();
+
+		const auto writeSection = [](std::ofstream& file, const uint64_t offset, const void* data, const uint64_t size)
+		{
+			static constexpr char padding[alignment] = {};
+			file.write(padding, offset - (uint64_t)file.tellp());
+			file.write(static_cast<const char*>(data), size);
+		};
+
+		// Write aside and rename, so readers mapping the file never see a partial mesh
+		auto tmpPath = path;
+		tmpPath += ".tmp";
+		{
+			auto file = std::ofstream(tmpPath, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+			writeSection(file, header.verticesOffset, model.vertices.data(), sizeof(Vertex) * model.vertices.size());
+			writeSection(file, header.indicesOffset, model.indices.data(), sizeof(glm::uvec3) * model.indices.size());
+			writeSection(file, header.extensionOffset, extension.data(), extension.size());
+			if (not file)
+			{
+				RT_LOG_ERROR("Failed to write mesh file {}", tmpPath);
+				return false;
+			}
+		}
+
+		auto error = std::error_code{};
+		std::filesystem::rename(tmpPath, path, error);
+		if (error)
+		{
+			RT_LOG_ERROR("Failed to store mesh file {}: {}", path, error.message());
+			std::filesystem::remove(tmpPath, error);
+			return false;
+		}
+		return true;
+	}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <span>
+
+#include "Engine/Core/MappedFile.h"
+#include "Engine/Render/Mesh.h"
+
+namespace RT
+{
+
+	/*
+	* Native .rtmesh container. The vertex and index streams are stored exactly as Model
+	* keeps them, each starting at a 64 byte boundary, so a mapping of the file is consumed
+	* without parsing. The optional extension blob carries data an application derived from
+	* the mesh, the ray tracer keeps its serialized BVH there.
+	*
+	*     Header | Vertex[vertexCnt] | uvec3[triangleCnt] | extension
+	*/
+	class MeshFile
+	{
+	public:
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vertexCnt;
+			uint32_t triangleCnt;
+			Box volume;
+			uint64_t verticesOffset;
+			uint64_t indicesOffset;
+			uint64_t extensionOffset;
+			uint64_t extensionSize;
+		};
+
+	public:
+		MeshFile(const std::filesystem::path& path);
+
+		bool isValid() const { return nullptr != header; }
+		std::span<const Vertex> getVertices() const;
+		std::span<const glm::uvec3> getIndices() const;
+		const Box& getVolume() const { return header->volume; }
+		std::span<const uint8_t> getExtension() const;
+
+		static bool write(const std::filesystem::path& path, const Model& model, const Box& volume, std::span<const uint8_t> extension = {});
+
+	public:
+		static constexpr auto fileExtension = ".rtmesh";
+
+	private:
+		MappedFile file;
+		const Header* header = nullptr;
+
+		static constexpr uint32_t magic = 0x48534d52u; // "RMSH"
+		static constexpr uint32_t version = 1u;
+		static constexpr uint64_t alignment = 64u;
+	};
+
+}
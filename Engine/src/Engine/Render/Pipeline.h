@@ -1,4 +1,7 @@
 #pragma once
+#include <compare>
+#include <string>
+#include <utility>
 #include <vector>
 #include <filesystem>
 
@@ -15,21 +18,41 @@ namespace RT
 	{
 		UniformType type = {};
 		uint32_t count = 1;
+
+		bool operator==(const UniformBinding&) const = default;
 	};
 
 	struct UniformLayout
 	{
 		uint32_t nrOfSets = 0u;
 		std::vector<UniformBinding> layout = {};
+
+		bool operator==(const UniformLayout&) const = default;
 	};
 
 	using UniformLayouts = std::vector<UniformLayout>;
 
+	using ShaderDefines = std::vector<std::pair<std::string, std::string>>;
+
+	/*
+	* Compile time configuration of a pipeline. Defines are handed to the shader preprocessor, so every
+	* distinct set compiles its own module. Constants are specialization constant values, the value at
+	* index i feeds constant_id = i, and only cost a pipeline build on top of an already compiled module.
+	*/
+	struct ShaderVariant
+	{
+		ShaderDefines defines = {};
+		std::vector<uint32_t> constants = {};
+
+		auto operator<=>(const ShaderVariant&) const = default;
+	};
+
 	struct PipelineSpec
 	{
 		std::filesystem::path shaderPath = ".";
 		UniformLayouts uniformLayouts = {};
 		AttachmentFormats attachmentFormats = {};
+		ShaderVariant variant = {};
 	};
 
 	struct Pipeline
@@ -44,6 +67,12 @@ namespace RT
 		virtual void bind() const = 0;
 		virtual void dispatch(const glm::uvec2 groups) const = 0;
 
+		// Never builds on the calling thread, the previous variant stays bound until the selected one is ready
+		virtual void selectVariant(const ShaderVariant& variant) = 0;
+		// Queues variants for a background build, so selecting them later only rebinds a pipeline. Replaces the
+		// previous queue, and the least recently used built variants are dropped once too many are kept
+		virtual void prepareVariants(const std::vector<ShaderVariant>& variants) = 0;
+
 		static Local<Pipeline> create(PipelineSpec& spec);
 	};
 
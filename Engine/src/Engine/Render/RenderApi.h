@@ -1,9 +1,34 @@
 #pragma once
+#include <array>
+#include <span>
+
 #include <Engine/Core/Base.h>
 
 namespace RT
 {
 
+	struct MemoryStats
+	{
+		uint32_t blockCnt = 0u;
+		uint32_t allocationCnt = 0u;
+		uint64_t reservedSize = 0u;
+		uint64_t usedSize = 0u;
+		float fragmentation = 0.0f;
+		uint64_t frameUploadSize = 0u;	// bytes copied to the device during the last frame
+	};
+
+	struct GpuScope
+	{
+		static constexpr uint32_t historySize = 128u;
+
+		const char* name = "";
+		float lastMs = 0.0f;
+		float averageMs = 0.0f;	// over the frames kept in history
+		std::array<float, historySize> history = {};
+		uint32_t historyHead = 0u;	// oldest entry, the next one to be overwritten
+		uint32_t sampleCnt = 0u;
+	};
+
 	struct RenderApi
 	{
 	public:
@@ -24,6 +49,9 @@ namespace RT
 		virtual void beginFrame() = 0;
 		virtual void endFrame() = 0;
 
+		virtual MemoryStats getMemoryStats() const = 0;
+		virtual std::span<const GpuScope> getGpuScopes() const = 0;
+
 	public:
 		static Api api;
 	};
@@ -34,6 +34,16 @@ namespace RT
 			renderApi->endFrame();
 		}
 
+		static MemoryStats getMemoryStats()
+		{
+			return renderApi->getMemoryStats();
+		}
+
+		static std::span<const GpuScope> getGpuScopes()
+		{
+			return renderApi->getGpuScopes();
+		}
+
 	private:
 		inline static Local<RenderApi> renderApi = nullptr;
 	};
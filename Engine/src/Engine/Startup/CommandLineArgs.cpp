@@ -0,0 +1,30 @@
+#include "CommandLineArgs.h"
+
+namespace RT
+{
+
+	bool CommandLineArgs::has(const std::string_view flag) const
+	{
+		for (int32_t i = 1; i < argc; i++)
+		{
+			if (flag == argv[i])
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::optional<std::string_view> CommandLineArgs::getValue(const std::string_view flag) const
+	{
+		for (int32_t i = 1; i + 1 < argc; i++)
+		{
+			if (flag == argv[i])
+			{
+				return std::string_view{ argv[i + 1] };
+			}
+		}
+		return std::nullopt;
+	}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "Engine/Core/Log.h"
+
+namespace RT
+{
+
+	/*
+	* Raw process arguments with flag lookup. Flags are matched verbatim and take
+	* their value from the following argument, e.g. "--scene 3".
+	*/
+	struct CommandLineArgs
+	{
+		int32_t argc;
+		char** argv;
+
+		bool has(const std::string_view flag) const;
+		std::optional<std::string_view> getValue(const std::string_view flag) const;
+
+		template <typename T>
+		T getNumber(const std::string_view flag, const T fallback) const;
+	};
+
+	template <typename T>
+	T CommandLineArgs::getNumber(const std::string_view flag, const T fallback) const
+	{
+		const auto value = getValue(flag);
+		if (not value.has_value())
+		{
+			return fallback;
+		}
+
+		auto number = T{};
+		const auto [end, error] = std::from_chars(value->data(), value->data() + value->size(), number);
+		if (std::errc{} != error or value->data() + value->size() != end)
+		{
+			RT_LOG_WARN("Ignoring invalid value {} of {}", *value, flag);
+			return fallback;
+		}
+		return number;
+	}
+
+}
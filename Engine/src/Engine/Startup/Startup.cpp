@@ -8,12 +8,6 @@ extern RT::ApplicationSpecs CreateApplicationSpec();
 
 namespace RT
 {
-	
-	struct CommandLineArgs
-	{
-		int32_t argc;
-		char** argv;
-	};
 
 	static void preInitCore(CommandLineArgs args)
 	{
@@ -26,13 +20,25 @@ namespace RT
 	}
 	
 
-	static void runCore()
+	static int32_t runCore(const CommandLineArgs& args)
 	{
 		auto specs = CreateApplicationSpec();
 
+		// Headless runs never touch the window, swapchain or UI
+		if (args.has("--headless"))
+		{
+			if (not specs.headlessMain)
+			{
+				RT_LOG_ERROR("APP ** {} ** has no headless mode", specs.name);
+				return EXIT_FAILURE;
+			}
+			return specs.headlessMain(args);
+		}
+
 		auto* application = new Application(specs);
 		application->run();
 		delete application;
+		return EXIT_SUCCESS;
 	}
 
 	static void postShutdownCore()
@@ -46,9 +52,9 @@ namespace RT
 	{
 		auto args = CommandLineArgs{ argc, argv };
 		preInitCore(args);
-		runCore();
+		const int32_t exitCode = runCore(args);
 		postShutdownCore();
-		return EXIT_SUCCESS;
+		return exitCode;
 	}
 
 }
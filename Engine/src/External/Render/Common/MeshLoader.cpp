@@ -1,8 +1,373 @@
 #include "MeshLoader.h"
 
+#include <atomic>
+#include <charconv>
+#include <cstring>
+
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Engine/Core/Log.h"
+#include "Engine/Core/ThreadPool.h"
+#include "Engine/Core/Time.h"
+
+namespace
+{
+
+    // Chunks are cut at the first line break after this many bytes
+    constexpr size_t objChunkSize = 4u << 20u;
+    constexpr uint32_t objNoIndex = ~0u;
+
+    enum class ObjLine : uint8_t { Position, TexCoord, Face, Other };
+
+    struct ObjChunk
+    {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        uint32_t positionRoot = 0u;
+        uint32_t texCoordRoot = 0u;
+        uint32_t triangleRoot = 0u;
+        uint32_t positionCnt = 0u;
+        uint32_t texCoordCnt = 0u;
+        uint32_t skippedFaceCnt = 0u;
+        glm::vec3 vMin = glm::vec3{ std::numeric_limits<float>::max() };
+        glm::vec3 vMax = glm::vec3{ std::numeric_limits<float>::lowest() };
+        std::vector<glm::uvec2> corners;    // position and texture coordinate index, three per triangle
+
+        // Welding state of the corners whose position this chunk uses first
+        std::vector<glm::uvec2> keys;                       // distinct corners in order of first use
+        std::vector<uint32_t> cornerKeys;                   // key of every owned corner
+        std::unordered_map<uint64_t, uint32_t> seamKeys;    // keys past the first one of their position
+        std::vector<uint32_t> sharedCorners;                // corners of positions an earlier chunk owns
+        uint32_t vertexRoot = 0u;
+    };
+
+    const char* skipBlanks(const char* it, const char* end)
+    {
+        while (it < end and (' ' == *it or '\t' == *it))
+        {
+            it++;
+        }
+        return it;
+    }
+
+    const char* findLineEnd(const char* it, const char* end)
+    {
+        const auto* lineBreak = static_cast<const char*>(std::memchr(it, '\n', end - it));
+        return nullptr != lineBreak ? lineBreak : end;
+    }
+
+    // Moves the iterator past the keyword, both passes have to agree on what a line is
+    ObjLine classifyLine(const char*& it, const char* end)
+    {
+        it = skipBlanks(it, end);
+        const auto isBlank = [&](const char* c) { return c < end and (' ' == *c or '\t' == *c); };
+        if (it < end and 'v' == it[0] and isBlank(it + 1))
+        {
+            it += 2;
+            return ObjLine::Position;
+        }
+        if (it < end and 'f' == it[0] and isBlank(it + 1))
+        {
+            it += 2;
+            return ObjLine::Face;
+        }
+        if (it + 1 < end and 'v' == it[0] and 't' == it[1] and isBlank(it + 2))
+        {
+            it += 3;
+            return ObjLine::TexCoord;
+        }
+        return ObjLine::Other;
+    }
+
+    template <typename T>
+    const char* parseNumber(const char* it, const char* end, T& value)
+    {
+        it = skipBlanks(it, end);
+        // from_chars rejects the leading plus some exporters write
+        if (it < end and '+' == *it)
+        {
+            it++;
+        }
+        return std::from_chars(it, end, value).ptr;
+    }
+
+    // Indices start at one, negative ones count back from the last element read before the face
+    uint32_t resolveIndex(const int64_t index, const uint32_t readCnt, const uint32_t totalCnt)
+    {
+        const int64_t resolved = index > 0 ? index - 1 : readCnt + index;
+        return 0 != index and resolved >= 0 and resolved < totalCnt ? (uint32_t)resolved : objNoIndex;
+    }
+
+    void countChunk(ObjChunk& chunk)
+    {
+        for (const char* line = chunk.begin; line < chunk.end;)
+        {
+            const char* lineEnd = findLineEnd(line, chunk.end);
+            const auto type = classifyLine(line, lineEnd);
+            chunk.positionCnt += ObjLine::Position == type;
+            chunk.texCoordCnt += ObjLine::TexCoord == type;
+            line = lineEnd + 1;
+        }
+    }
+
+    void parseChunk(ObjChunk& chunk, std::vector<glm::vec3>& positions, std::vector<glm::vec2>& texCoords)
+    {
+        uint32_t positionsRead = chunk.positionRoot;
+        uint32_t texCoordsRead = chunk.texCoordRoot;
+        auto face = std::vector<glm::uvec2>{};
+
+        for (const char* line = chunk.begin; line < chunk.end;)
+        {
+            const char* lineEnd = findLineEnd(line, chunk.end);
+            const char* it = line;
+            line = lineEnd + 1;
+
+            switch (classifyLine(it, lineEnd))
+            {
+                case ObjLine::Position:
+                {
+                    auto& position = positions[positionsRead++];
+                    it = parseNumber(it, lineEnd, position.x);
+                    it = parseNumber(it, lineEnd, position.y);
+                    it = parseNumber(it, lineEnd, position.z);
+                    break;
+                }
+                case ObjLine::TexCoord:
+                {
+                    auto& texCoord = texCoords[texCoordsRead++];
+                    it = parseNumber(it, lineEnd, texCoord.x);
+                    it = parseNumber(it, lineEnd, texCoord.y);
+                    break;
+                }
+                case ObjLine::Face:
+                {
+                    // Corners are v, v/vt, v//vn or v/vt/vn, normals are not supported yet
+                    face.clear();
+                    bool isValid = true;
+                    for (it = skipBlanks(it, lineEnd); it < lineEnd and '\r' != *it and '#' != *it; it = skipBlanks(it, lineEnd))
+                    {
+                        int64_t position = 0;
+                        int64_t texCoord = 0;
+                        int64_t normal = 0;
+                        it = parseNumber(it, lineEnd, position);
+                        if (it < lineEnd and '/' == *it)
+                        {
+                            it++;
+                            if (it < lineEnd and '/' != *it)
+                            {
+                                it = parseNumber(it, lineEnd, texCoord);
+                            }
+                            if (it < lineEnd and '/' == *it)
+                            {
+                                it = parseNumber(it + 1, lineEnd, normal);
+                            }
+                        }
+                        while (it < lineEnd and ' ' != *it and '\t' != *it and '\r' != *it and '#' != *it)
+                        {
+                            isValid = false;
+                            it++;
+                        }
+
+                        const auto corner = glm::uvec2{
+                            resolveIndex(position, positionsRead, positions.size()),
+                            0 != texCoord ? resolveIndex(texCoord, texCoordsRead, texCoords.size()) : objNoIndex };
+                        isValid = isValid and objNoIndex != corner.x and (0 == texCoord or objNoIndex != corner.y);
+                        face.push_back(corner);
+                    }
+
+                    if (not isValid or face.size() < 3u)
+                    {
+                        chunk.skippedFaceCnt++;
+                        break;
+                    }
+
+                    // N-gons are split into a fan around their first corner
+                    for (uint32_t corner = 1u; corner + 1u < face.size(); corner++)
+                    {
+                        chunk.corners.push_back(face[0]);
+                        chunk.corners.push_back(face[corner]);
+                        chunk.corners.push_back(face[corner + 1u]);
+                    }
+                    break;
+                }
+                case ObjLine::Other:
+                    break;
+            }
+        }
+    }
+
+    // Without texture coordinates every position is a vertex, so chunks copy their triangles in parallel
+    void indexPositions(std::vector<ObjChunk>& chunks, const std::vector<glm::vec3>& positions, RT::Model& model, RT::Box& volume)
+    {
+        model.vertices.resize(positions.size());
+        RT::ThreadPool::get().parallelFor(0u, chunks.size(), 1u, [&](const uint32_t chunkId)
+        {
+            auto& chunk = chunks[chunkId];
+            for (uint32_t position = chunk.positionRoot; position < chunk.positionRoot + chunk.positionCnt; position++)
+            {
+                model.vertices[position] = RT::Vertex{ positions[position], glm::vec2{ 0.0f } };
+            }
+
+            // Only referenced positions count towards the volume
+            const auto& corners = chunk.corners;
+            for (uint32_t corner = 0u; corner < corners.size(); corner++)
+            {
+                chunk.vMin = glm::min(chunk.vMin, positions[corners[corner].x]);
+                chunk.vMax = glm::max(chunk.vMax, positions[corners[corner].x]);
+                model.indices[chunk.triangleRoot + corner / 3u][corner % 3u] = corners[corner].x;
+            }
+        });
+
+        for (const auto& chunk : chunks)
+        {
+            volume.leftBottomFront = glm::min(volume.leftBottomFront, chunk.vMin);
+            volume.rightTopBack = glm::max(volume.rightTopBack, chunk.vMax);
+        }
+    }
+
+    uint64_t packCorner(const glm::uvec2 corner)
+    {
+        return ((uint64_t)corner.x << 32u) | corner.y;
+    }
+
+    // Corners sharing a position and a texture coordinate become one vertex. A position belongs to the
+    // first chunk using it and only that chunk writes its entry, so chunks weld in parallel. Vertices
+    // are placed by a prefix sum over the chunks and only corners of positions owned by an earlier
+    // chunk are matched serially. Most positions only ever see one texture coordinate, the rest
+    // fall back to a map.
+    void weldCorners(std::vector<ObjChunk>& chunks, const std::vector<glm::vec3>& positions, const std::vector<glm::vec2>& texCoords, RT::Model& model, RT::Box& volume)
+    {
+        auto& threadPool = RT::ThreadPool::get();
+        auto firstChunk = std::vector<std::atomic<uint32_t>>(positions.size());
+        auto positionKeys = std::vector<uint32_t>(positions.size());
+        threadPool.parallelFor(0u, chunks.size(), 1u, [&](const uint32_t chunkId)
+        {
+            const auto& chunk = chunks[chunkId];
+            for (uint32_t position = chunk.positionRoot; position < chunk.positionRoot + chunk.positionCnt; position++)
+            {
+                firstChunk[position].store(objNoIndex, std::memory_order_relaxed);
+                positionKeys[position] = objNoIndex;
+            }
+        });
+
+        threadPool.parallelFor(0u, chunks.size(), 1u, [&](const uint32_t chunkId)
+        {
+            for (const auto& corner : chunks[chunkId].corners)
+            {
+                auto& owner = firstChunk[corner.x];
+                auto current = owner.load(std::memory_order_relaxed);
+                while (chunkId < current and not owner.compare_exchange_weak(current, chunkId, std::memory_order_relaxed))
+                {
+                }
+            }
+        });
+
+        threadPool.parallelFor(0u, chunks.size(), 1u, [&](const uint32_t chunkId)
+        {
+            auto& chunk = chunks[chunkId];
+            chunk.cornerKeys.assign(chunk.corners.size(), objNoIndex);
+            for (uint32_t cornerId = 0u; cornerId < chunk.corners.size(); cornerId++)
+            {
+                const auto corner = chunk.corners[cornerId];
+                if (chunkId != firstChunk[corner.x].load(std::memory_order_relaxed))
+                {
+                    chunk.sharedCorners.push_back(cornerId);
+                    continue;
+                }
+
+                auto& key = positionKeys[corner.x];
+                if (objNoIndex == key)
+                {
+                    key = chunk.keys.size();
+                    chunk.keys.push_back(corner);
+                }
+                else if (chunk.keys[key].y != corner.y)
+                {
+                    const auto seamKey = chunk.seamKeys.try_emplace(packCorner(corner), chunk.keys.size());
+                    if (seamKey.second)
+                    {
+                        chunk.keys.push_back(corner);
+                    }
+                    chunk.cornerKeys[cornerId] = seamKey.first->second;
+                    continue;
+                }
+                chunk.cornerKeys[cornerId] = key;
+            }
+        });
+
+        uint32_t vertexCnt = 0u;
+        for (auto& chunk : chunks)
+        {
+            chunk.vertexRoot = vertexCnt;
+            vertexCnt += chunk.keys.size();
+        }
+
+        model.vertices.resize(vertexCnt);
+        auto vertexTexCoords = std::vector<uint32_t>(vertexCnt);
+        threadPool.parallelFor(0u, chunks.size(), 1u, [&](const uint32_t chunkId)
+        {
+            auto& chunk = chunks[chunkId];
+            for (uint32_t key = 0u; key < chunk.keys.size(); key++)
+            {
+                const auto corner = chunk.keys[key];
+                auto& vertex = model.vertices[chunk.vertexRoot + key];
+                vertex.position = positions[corner.x];
+                vertex.uv = objNoIndex != corner.y ? texCoords[corner.y] : glm::vec2{ 0.0f };
+                vertexTexCoords[chunk.vertexRoot + key] = corner.y;
+                chunk.vMin = glm::min(chunk.vMin, vertex.position);
+                chunk.vMax = glm::max(chunk.vMax, vertex.position);
+            }
+
+            for (uint32_t cornerId = 0u; cornerId < chunk.cornerKeys.size(); cornerId++)
+            {
+                if (objNoIndex != chunk.cornerKeys[cornerId])
+                {
+                    model.indices[chunk.triangleRoot + cornerId / 3u][cornerId % 3u] = chunk.vertexRoot + chunk.cornerKeys[cornerId];
+                }
+            }
+        });
+
+        // Seams first met outside of the owner chunk are the only vertices added here
+        auto seamVertices = std::unordered_map<uint64_t, uint32_t>{};
+        for (const auto& chunk : chunks)
+        {
+            for (const uint32_t cornerId : chunk.sharedCorners)
+            {
+                const auto corner = chunk.corners[cornerId];
+                const auto& owner = chunks[firstChunk[corner.x].load(std::memory_order_relaxed)];
+                uint32_t vertexId = owner.vertexRoot + positionKeys[corner.x];
+                if (vertexTexCoords[vertexId] != corner.y)
+                {
+                    const auto ownerSeam = owner.seamKeys.find(packCorner(corner));
+                    if (owner.seamKeys.end() != ownerSeam)
+                    {
+                        vertexId = owner.vertexRoot + ownerSeam->second;
+                    }
+                    else
+                    {
+                        const auto seamVertex = seamVertices.try_emplace(packCorner(corner), model.vertices.size());
+                        if (seamVertex.second)
+                        {
+                            model.vertices.push_back(RT::Vertex{ positions[corner.x], objNoIndex != corner.y ? texCoords[corner.y] : glm::vec2{ 0.0f } });
+                            vertexTexCoords.push_back(corner.y);
+                        }
+                        vertexId = seamVertex.first->second;
+                    }
+                }
+                model.indices[chunk.triangleRoot + cornerId / 3u][cornerId % 3u] = vertexId;
+            }
+        }
+
+        // Vertices added serially share their position with an owned one, so the chunk bounds cover them
+        for (auto& chunk : chunks)
+        {
+            volume.leftBottomFront = glm::min(volume.leftBottomFront, chunk.vMin);
+            volume.rightTopBack = glm::max(volume.rightTopBack, chunk.vMax);
+            chunk = ObjChunk{};
+        }
+    }
+
+}
 
 namespace RT
 {
@@ -16,7 +381,7 @@ namespace RT
         return false;
     }
 
-    std::vector<Triangle> UnknownLoader::buildModel() const
+    Model UnknownLoader::buildModel() const
     {
         RT_LOG_ERROR("Cannot build model from unknown format");
         return {};
@@ -60,9 +425,9 @@ namespace RT
         return ret;
     }
 
-    std::vector<Triangle> GltfLoader::buildModel() const
+    Model GltfLoader::buildModel() const
     {
-        auto rtModel = std::vector<Triangle>();
+        auto rtModel = Model{};
 
         for (const auto& mesh : model.meshes)
         {
@@ -118,32 +483,33 @@ namespace RT
                     ? primBufferView.byteStride
                     : primitiveComponentTypeToSize(primAccessor.componentType) * primitiveTypeToSize(primAccessor.type);
 
-                constexpr size_t nrOfTrianglesInFace = 3;
-                uint32_t lastTriangleSize = rtModel.size();
-                rtModel.resize(lastTriangleSize + primIndicesAccessor.count / nrOfTrianglesInFace);
-                for (int32_t lt = lastTriangleSize; lt < rtModel.size(); lt++)
+                // Primitives keep their own vertices, so their indices are offset by the vertices added before them
+                const uint32_t firstVertex = rtModel.vertices.size();
+                rtModel.vertices.resize(firstVertex + primAccessor.count);
+                for (uint32_t v = 0u; v < primAccessor.count; v++)
                 {
-                    uint32_t primPtr = *(uint32_t*)(primIndicesBuffer + primIndicesPtr) & maskPrimitiveType(primIndicesAccessor.componentType);
-                    std::memcpy(glm::value_ptr(rtModel[lt].A), primRawBuffer + primPtr * primStride, sizeof(glm::vec3));
-                    primIndicesPtr += primIndicesIncrement;
-
-                    primPtr = *(uint32_t*)(primIndicesBuffer + primIndicesPtr) & maskPrimitiveType(primIndicesAccessor.componentType);
-                    std::memcpy(glm::value_ptr(rtModel[lt].B), primRawBuffer + primPtr * primStride, sizeof(glm::vec3));
-                    primIndicesPtr += primIndicesIncrement;
-
-                    primPtr = *(uint32_t*)(primIndicesBuffer + primIndicesPtr) & maskPrimitiveType(primIndicesAccessor.componentType);
-                    std::memcpy(glm::value_ptr(rtModel[lt].C), primRawBuffer + primPtr * primStride, sizeof(glm::vec3));
-                    primIndicesPtr += primIndicesIncrement;
+                    auto& vertex = rtModel.vertices[firstVertex + v];
+                    std::memcpy(glm::value_ptr(vertex.position), primRawBuffer + v * primStride, sizeof(glm::vec3));
+                    vertex.uv = { 0, 0 };
+                }
 
-                    rtModel[lt].uvA = { 0, 0 };
-                    rtModel[lt].uvB = { 0, 0 };
-                    rtModel[lt].uvC = { 0, 0 };
+                constexpr size_t nrOfTrianglesInFace = 3;
+                uint32_t lastTriangleSize = rtModel.indices.size();
+                rtModel.indices.resize(lastTriangleSize + primIndicesAccessor.count / nrOfTrianglesInFace);
+                for (int32_t lt = lastTriangleSize; lt < rtModel.indices.size(); lt++)
+                {
+                    for (uint32_t corner = 0u; corner < nrOfTrianglesInFace; corner++)
+                    {
+                        const uint32_t primPtr = *(uint32_t*)(primIndicesBuffer + primIndicesPtr) & maskPrimitiveType(primIndicesAccessor.componentType);
+                        rtModel.indices[lt][corner] = firstVertex + primPtr;
+                        primIndicesPtr += primIndicesIncrement;
+                    }
                 }
                 //break;
             }
         }
 
-        if (rtModel.empty())
+        if (rtModel.indices.empty())
         {
             LOG_WARN("Colnd not find any Triangle primitive. No data in mesh");
         }
@@ -243,137 +609,77 @@ namespace RT
     */
     bool ObjLoader::load(const std::filesystem::path& path)
     {
-        model.open(path);
-        return model.is_open();
+        RT_LOG_INFO("Reading OBJ: {}", path);
+        model = makeLocal<MappedFile>(path);
+        return model->isValid();
     }
 
-    std::vector<Triangle> ObjLoader::buildModel() const
+    Model ObjLoader::buildModel() const
     {
+        auto timer = Timer{};
+
         volume.leftBottomFront = glm::vec3{ std::numeric_limits<float>::max() };
         volume.rightTopBack = glm::vec3{ std::numeric_limits<float>::lowest() };
 
-        auto vertices = std::vector<glm::vec3>{};
-        vertices.reserve(1000);
-        auto texCoords = std::vector<glm::vec2>{};
-        texCoords.reserve(1000);
-        auto triangles = std::vector<RT::Triangle>{};
-        triangles.reserve(1000);
+        const auto* data = model->as<char>();
+        const auto* dataEnd = data + model->getSize();
 
-        auto line = std::string{};
-        while (std::getline(model, line))
+        auto chunks = std::vector<ObjChunk>{};
+        for (const char* begin = data; begin < dataEnd;)
         {
-            auto ss = std::stringstream{ line };
-            auto prefix = std::string{ "" };
-            ss >> prefix;
+            const char* end = (size_t)(dataEnd - begin) > objChunkSize ? findLineEnd(begin + objChunkSize, dataEnd) : dataEnd;
+            end = end < dataEnd ? end + 1 : dataEnd;
+            chunks.push_back(ObjChunk{ .begin = begin, .end = end });
+            begin = end;
+        }
 
-            if (line.empty() or prefix == "#")
-            {
-                continue;
-            }
+        // Counting first gives every chunk its place in the shared arrays, so relative indices resolve while parsing
+        auto& threadPool = ThreadPool::get();
+        threadPool.parallelFor(0u, chunks.size(), 1u, [&](const uint32_t chunkId) { countChunk(chunks[chunkId]); });
 
-            if (prefix == "v")
-            {
-                auto& v = vertices.emplace_back();
-                ss >> v.x >> v.y >> v.z;
-            }
-            else if (prefix == "vt")
-            {
-                auto& vt = texCoords.emplace_back();
-                ss >> vt.x >> vt.y;
-            }
-            else if (prefix == "vn")
-            {
-                // not supported yet
-                // for future, normal may not be normalized
-            }
-            else if (prefix == "l")
-            {
-                // not supported yet
-            }
-            else if (prefix == "f")
-            {
-                const auto setVertex = [&](auto vertexData, auto& v, auto& vt /*, auto& vn*/) -> void
-                {
-                    int32_t vIdx = 0;
-                    int32_t vtIdx = 0;
-                    //int32_t vnIdx = 0;
+        uint32_t positionCnt = 0u;
+        uint32_t texCoordCnt = 0u;
+        for (auto& chunk : chunks)
+        {
+            chunk.positionRoot = positionCnt;
+            chunk.texCoordRoot = texCoordCnt;
+            positionCnt += chunk.positionCnt;
+            texCoordCnt += chunk.texCoordCnt;
+        }
 
-                    size_t delim = vertexData.find("//");
-                    if (std::string::npos != delim)
-                    {
-                        vertexData.replace(delim, 2u, " ");
-                        auto vA = std::stringstream{ vertexData };
-
-                        vA >> vIdx;
-                        //vA >> vnIdx;
-                        v = vertices[vIdx - 1];
-                        //vn = vertices[vnIdx - 1];
-                        return;
-                    }
+        auto positions = std::vector<glm::vec3>(positionCnt);
+        auto texCoords = std::vector<glm::vec2>(texCoordCnt);
+        threadPool.parallelFor(0u, chunks.size(), 1u, [&](const uint32_t chunkId) { parseChunk(chunks[chunkId], positions, texCoords); });
 
-                    delim = vertexData.find("/");
-                    if (std::string::npos != delim)
-                    {
-                        std::replace(vertexData.begin(), vertexData.end(), '/', ' ');
-                        auto vA = std::stringstream{ vertexData };
-
-                        vA >> vIdx;
-                        vA >> vtIdx;
-                        v = vertices[vIdx - 1];
-                        vt = texCoords[vtIdx - 1];
-                        //if (' ' == vA.peek())
-                        //{
-                        //    v >> vnIdx;
-                        //    vn = vertices[vnIdx - 1];
-                        //}
-                    }
-                    else
-                    {
-                        auto vA = std::stringstream{ vertexData };
-                        vA >> vIdx;
-                        v = vertices[vIdx - 1];
-                    }
-                };
-
-                auto vertexDataA = std::string{ "" };
-                auto vertexDataB = std::string{ "" };
-                auto vertexDataC = std::string{ "" };
-                ss >> vertexDataA;
-                ss >> vertexDataB;
-                ss >> vertexDataC;
-
-                auto& face = triangles.emplace_back();
-                setVertex(vertexDataA, face.A, face.uvA);
-                setVertex(vertexDataB, face.B, face.uvB);
-                setVertex(vertexDataC, face.C, face.uvC);
-
-                volume.leftBottomFront = glm::min(volume.leftBottomFront, face.A);
-                volume.leftBottomFront = glm::min(volume.leftBottomFront, face.B);
-                volume.leftBottomFront = glm::min(volume.leftBottomFront, face.C);
-                volume.rightTopBack = glm::max(volume.rightTopBack, face.A);
-                volume.rightTopBack = glm::max(volume.rightTopBack, face.B);
-                volume.rightTopBack = glm::max(volume.rightTopBack, face.C);
-
-                if (' ' == ss.peek())
-                {
-                    auto vertexDataD = std::string{ "" };
-                    ss >> vertexDataD;
-                    auto& additionalFace = triangles.emplace_back();
-                    setVertex(vertexDataA, additionalFace.A, additionalFace.uvA);
-                    setVertex(vertexDataC, additionalFace.B, additionalFace.uvB);
-                    setVertex(vertexDataD, additionalFace.C, additionalFace.uvC);
-
-                    volume.leftBottomFront = glm::min(volume.leftBottomFront, additionalFace.A);
-                    volume.leftBottomFront = glm::min(volume.leftBottomFront, additionalFace.B);
-                    volume.leftBottomFront = glm::min(volume.leftBottomFront, additionalFace.C);
-                    volume.rightTopBack = glm::max(volume.rightTopBack, additionalFace.A);
-                    volume.rightTopBack = glm::max(volume.rightTopBack, additionalFace.B);
-                    volume.rightTopBack = glm::max(volume.rightTopBack, additionalFace.C);
-                }
-            }
+        uint32_t cornerCnt = 0u;
+        uint32_t skippedFaceCnt = 0u;
+        for (auto& chunk : chunks)
+        {
+            chunk.triangleRoot = cornerCnt / 3u;
+            cornerCnt += chunk.corners.size();
+            skippedFaceCnt += chunk.skippedFaceCnt;
+        }
+        if (skippedFaceCnt > 0u)
+        {
+            RT_LOG_WARN("Skipped {} malformed OBJ faces", skippedFaceCnt);
+        }
+
+        auto rtModel = Model{};
+        rtModel.indices.resize(cornerCnt / 3u);
+        if (0u == texCoordCnt)
+        {
+            indexPositions(chunks, positions, rtModel, volume);
+        }
+        else
+        {
+            weldCorners(chunks, positions, texCoords, rtModel, volume);
         }
 
-        return triangles;
+        const float time = timer.Ellapsed();
+        RT_LOG_INFO("Parsed {:.1f} MB of OBJ in {:.1f} ms ({:.2f} GB/s), {} vertices, {} triangles",
+            model->getSize() / 1e6f, time, model->getSize() / (time * 1e6f), rtModel.vertices.size(), rtModel.indices.size());
+
+        return rtModel;
     }
 
     Box ObjLoader::buildVolume() const
@@ -381,6 +687,29 @@ namespace RT
         return volume;
     }
 
+    /*
+        RtMeshLoader impl
+    */
+    bool RtMeshLoader::load(const std::filesystem::path& path)
+    {
+        RT_LOG_INFO("Reading RTMESH: {}", path);
+        model = makeLocal<MeshFile>(path);
+        return model->isValid();
+    }
+
+    Model RtMeshLoader::buildModel() const
+    {
+        // Streams already have the in memory layout, building is a plain copy out of the mapping
+        const auto vertices = model->getVertices();
+        const auto indices = model->getIndices();
+        return Model{ { vertices.begin(), vertices.end() }, { indices.begin(), indices.end() } };
+    }
+
+    Box RtMeshLoader::buildVolume() const
+    {
+        return model->getVolume();
+    }
+
     /*
         MeshLoader impl
     */
@@ -389,7 +718,8 @@ namespace RT
     {
         SELECTOR(".gltf", GltfLoader),
         SELECTOR(".glb",  GltfLoader),
-        SELECTOR(".obj",  ObjLoader)
+        SELECTOR(".obj",  ObjLoader),
+        SELECTOR(".rtmesh", RtMeshLoader)
     };
 
     bool MeshLoader::load(const std::filesystem::path& path)
@@ -407,7 +737,7 @@ namespace RT
         return std::visit([&path](auto& loader) { return loader.load(path); }, loader);
     }
 
-    std::vector<Triangle> MeshLoader::buildModel() const
+    Model MeshLoader::buildModel() const
     {
         return std::visit([](const auto& loader) { return loader.buildModel(); }, loader);
     }
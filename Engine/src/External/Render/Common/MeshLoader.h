@@ -5,7 +5,9 @@
 #include <unordered_map>
 #include <variant>
 
+#include "Engine/Core/MappedFile.h"
 #include "Engine/Core/Utils.h"
+#include "Engine/Render/MeshFile.h"
 #include "Engine/Render/Scene.h"
 
 #include "tiny_gltf.h"
@@ -15,7 +17,7 @@ namespace RT
 
 	#define LOADER_IMPL								  \
 		bool load(const std::filesystem::path& path); \
-		std::vector<Triangle> buildModel() const;	  \
+		Model buildModel() const;					  \
 		Box buildVolume() const;
 
 	class UnknownLoader
@@ -46,17 +48,26 @@ namespace RT
 
 	private:
 		mutable Box volume = {};
-		mutable std::ifstream model = {};
+		Local<MappedFile> model = {};
+	};
+
+	class RtMeshLoader
+	{
+	public:
+		LOADER_IMPL
+
+	private:
+		Local<MeshFile> model = {};
 	};
 
 	class MeshLoader
 	{
-		using Loader = std::variant<UnknownLoader, GltfLoader, ObjLoader>;
+		using Loader = std::variant<UnknownLoader, GltfLoader, ObjLoader, RtMeshLoader>;
 
 	public:
 		bool load(const std::filesystem::path& path);
 
-		std::vector<Triangle> buildModel() const;
+		Model buildModel() const;
 		Box buildVolume() const;
 
 	private:
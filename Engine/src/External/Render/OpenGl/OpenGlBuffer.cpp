@@ -169,6 +169,7 @@ namespace RT::OpenGl
 		{
 			case UniformType::Uniform: return GL_UNIFORM_BUFFER;
 			case UniformType::Storage: return GL_SHADER_STORAGE_BUFFER;
+			case UniformType::StaticStorage: return GL_SHADER_STORAGE_BUFFER;
 			case UniformType::Sampler: return GL_TEXTURE_BUFFER;
 		}
 		return 0u;
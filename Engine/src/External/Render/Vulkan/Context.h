@@ -14,6 +14,7 @@ namespace RT::Vulkan
 	public:
 		static inline uint32_t imgIdx = 0u;
 		static inline VkCommandBuffer frameCmd = {};
+		static inline uint64_t frameNr = 0u;	// frames begun so far, the ones in flight are at most MAX_FRAMES_IN_FLIGHT behind
 	};
 
 }
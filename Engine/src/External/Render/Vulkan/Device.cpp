@@ -1,4 +1,6 @@
 #include "Device.h"
+#include <cstring>
+#include <fstream>
 #include <unordered_set>
 
 #include "utils/Debug.h"
@@ -55,11 +57,16 @@ namespace RT::Vulkan
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
+        memoryArena.init(device, physicalDevice, deviceProperties.limits);
         createCommandPool();
+        createPipelineCache();
     }
 
     void Device::shutdown()
     {
+        storePipelineCache();
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
+        memoryArena.release();
         vkDestroyCommandPool(device, commandPool, nullptr);
         vkDestroyDevice(device, nullptr);
          
@@ -78,20 +85,23 @@ namespace RT::Vulkan
         const VkImageCreateInfo& imageInfo,
         const VkMemoryPropertyFlags properties,
         VkImage& image,
-        VkDeviceMemory& imageMemory) const
+        MemoryAllocation& imageMemory)
     {
         CHECK_VK(vkCreateImage(device, &imageInfo, nullptr, &image), "failed to create image!");
+        bindImageMemory(image, properties, imageMemory);
+    }
 
+    void Device::bindImageMemory(
+        const VkImage image,
+        const VkMemoryPropertyFlags properties,
+        MemoryAllocation& imageMemory)
+    {
         auto memRequirements = VkMemoryRequirements{};
         vkGetImageMemoryRequirements(device, image, &memRequirements);
 
-        auto allocInfo = VkMemoryAllocateInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-        CHECK_VK(vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory), "failed to allocate image memory!");
-        CHECK_VK(vkBindImageMemory(device, image, imageMemory, 0), "failed to bind image memory!");
+        const uint32_t memoryType = findMemoryType(memRequirements.memoryTypeBits, properties);
+        imageMemory = memoryArena.allocate(memRequirements, memoryType, MemoryArena::Resource::Image);
+        CHECK_VK(vkBindImageMemory(device, image, imageMemory.memory, imageMemory.offset), "failed to bind image memory!");
     }
 
     VkFormat Device::findSupportedFormat(
@@ -118,7 +128,8 @@ namespace RT::Vulkan
         const VkBufferUsageFlags usage,
         const VkMemoryPropertyFlags properties,
         VkBuffer& buffer,
-        VkDeviceMemory& bufferMemory) const
+        MemoryAllocation& bufferMemory,
+        const MemoryArena::Strategy strategy)
     {
         auto bufferInfo = VkBufferCreateInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -133,16 +144,14 @@ namespace RT::Vulkan
         auto memRequirements = VkMemoryRequirements{};
         vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-        auto allocInfo = VkMemoryAllocateInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-        CHECK_VK(
-            vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory),
-            "failed to allocate vertex buffer");
+        const uint32_t memoryType = findMemoryType(memRequirements.memoryTypeBits, properties);
+        bufferMemory = memoryArena.allocate(memRequirements, memoryType, MemoryArena::Resource::Buffer, strategy);
+        vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset);
+    }
 
-        vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    void Device::freeMemory(MemoryAllocation& memory)
+    {
+        memoryArena.free(memory);
     }
 
     uint32_t Device::findMemoryType(const uint32_t typeFilter, const VkMemoryPropertyFlags properties) const
@@ -280,6 +289,89 @@ namespace RT::Vulkan
         CHECK_VK(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool), "failed to create command pool!");
     }
 
+    void Device::createPipelineCache()
+    {
+        auto cacheData = std::vector<char>{};
+        auto file = std::ifstream(pipelineCachePath(), std::ios::ate | std::ios::binary);
+        if (file.is_open())
+        {
+            cacheData.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(cacheData.data(), cacheData.size());
+        }
+
+        // A blob of another driver version is dropped here rather than trusting every driver to reject it
+        if (not file or not isPipelineCacheCompatible(cacheData))
+        {
+            cacheData.clear();
+        }
+
+        auto cacheInfo = VkPipelineCacheCreateInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = cacheData.size();
+        cacheInfo.pInitialData = cacheData.data();
+        CHECK_VK(vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache), "failed to create pipeline cache!");
+
+        RT_LOG_INFO("Pipeline cache created: {{ initial size = {} }}", cacheData.size());
+    }
+
+    void Device::storePipelineCache() const
+    {
+        size_t cacheSize = 0u;
+        CHECK_VK(vkGetPipelineCacheData(device, pipelineCache, &cacheSize, nullptr), "failed to query pipeline cache size!");
+        auto cacheData = std::vector<char>(cacheSize);
+        CHECK_VK(vkGetPipelineCacheData(device, pipelineCache, &cacheSize, cacheData.data()), "failed to read pipeline cache!");
+
+        const auto path = pipelineCachePath();
+        auto error = std::error_code{};
+        std::filesystem::create_directories(path.parent_path(), error);
+
+        auto tmpPath = path;
+        tmpPath += ".tmp";
+        {
+            auto file = std::ofstream(tmpPath, std::ios::binary | std::ios::trunc);
+            file.write(cacheData.data(), cacheSize);
+            if (not file)
+            {
+                RT_LOG_WARN("Failed to write pipeline cache {}", tmpPath);
+                return;
+            }
+        }
+
+        std::filesystem::rename(tmpPath, path, error);
+        if (error)
+        {
+            RT_LOG_WARN("Failed to store pipeline cache {}: {}", path, error.message());
+            std::filesystem::remove(tmpPath, error);
+        }
+    }
+
+    bool Device::isPipelineCacheCompatible(const std::vector<char>& cacheData) const
+    {
+        auto header = VkPipelineCacheHeaderVersionOne{};
+        if (cacheData.size() < sizeof(header))
+        {
+            return false;
+        }
+
+        std::memcpy(&header, cacheData.data(), sizeof(header));
+        return VK_PIPELINE_CACHE_HEADER_VERSION_ONE == header.headerVersion
+            and deviceProperties.vendorID == header.vendorID
+            and deviceProperties.deviceID == header.deviceID
+            and 0 == std::memcmp(deviceProperties.pipelineCacheUUID, header.pipelineCacheUUID, VK_UUID_SIZE);
+    }
+
+    std::filesystem::path Device::pipelineCachePath() const
+    {
+        // Keyed by the cache UUID, so switching GPUs or drivers keeps each blob apart
+        auto uuid = std::string{};
+        for (const auto byte : deviceProperties.pipelineCacheUUID)
+        {
+            uuid += fmt::format("{:02x}", byte);
+        }
+        return pipelineCacheDir / fmt::format("{:04x}-{:04x}-{}.bin", deviceProperties.vendorID, deviceProperties.deviceID, uuid);
+    }
+
     bool Device::isDeviceSuitable(VkPhysicalDevice phyDev)
     {
         bool swapChainAdequate = false;
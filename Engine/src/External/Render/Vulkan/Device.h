@@ -1,10 +1,12 @@
 #pragma once
 #include <array>
+#include <filesystem>
 #include <vector>
 
 #include <vulkan/vulkan.h>
 
 #include "utils/Utils.h"
+#include "MemoryArena.h"
 
 namespace RT::Vulkan
 {
@@ -30,7 +32,11 @@ namespace RT::Vulkan
             const VkImageCreateInfo& imageInfo,
             const VkMemoryPropertyFlags properties,
             VkImage& image,
-            VkDeviceMemory& imageMemory) const;
+            MemoryAllocation& imageMemory);
+        void bindImageMemory(
+            const VkImage image,
+            const VkMemoryPropertyFlags properties,
+            MemoryAllocation& imageMemory);
         VkFormat findSupportedFormat(
             const std::vector<VkFormat>& candidates,
             const VkImageTiling tiling,
@@ -40,7 +46,9 @@ namespace RT::Vulkan
             const VkBufferUsageFlags usage,
             const VkMemoryPropertyFlags properties,
             VkBuffer& buffer,
-            VkDeviceMemory& bufferMemory) const;
+            MemoryAllocation& bufferMemory,
+            const MemoryArena::Strategy strategy = MemoryArena::Strategy::FreeList);
+        void freeMemory(MemoryAllocation& memory);
         uint32_t findMemoryType(const uint32_t typeFilter, const VkMemoryPropertyFlags properties) const;
 
         template <typename Proc>
@@ -58,8 +66,10 @@ namespace RT::Vulkan
         VkQueue getGraphicsQueue() const { return graphicsQueue; }
         VkQueue getPresentQueue() const { return presentQueue; }
         VkCommandPool getCommandPool() const { return commandPool; }
+        VkPipelineCache getPipelineCache() const { return pipelineCache; }
 
         const VkPhysicalDeviceLimits& getLimits() const { return deviceProperties.limits; }
+        MemoryArena::Stats getMemoryStats() const { return memoryArena.getStats(); }
         
         const Utils::SwapChainSupportDetails& getSwapChainSupportDetails() const { return swapChainSupportDetails; }
         Utils::QueueFamilyIndices getQueueFamilyIndices() const { return queueFamilyIndices; }
@@ -73,6 +83,10 @@ namespace RT::Vulkan
         void pickPhysicalDevice();
         void createLogicalDevice();
         void createCommandPool();
+        void createPipelineCache();
+        void storePipelineCache() const;
+        bool isPipelineCacheCompatible(const std::vector<char>& cacheData) const;
+        std::filesystem::path pipelineCachePath() const;
 
         bool isDeviceSuitable(VkPhysicalDevice phyDev);
         Utils::QueueFamilyIndices findQueueFamilies(VkPhysicalDevice phyDev) const;
@@ -92,11 +106,14 @@ namespace RT::Vulkan
         VkQueue graphicsQueue = {};
         VkQueue presentQueue = {};
         VkCommandPool commandPool = {};
+        VkPipelineCache pipelineCache = {};
         VkPhysicalDeviceProperties deviceProperties = {};
+        MemoryArena memoryArena = {};
 
         Utils::SwapChainSupportDetails swapChainSupportDetails = {};
         Utils::QueueFamilyIndices queueFamilyIndices = {};
 
+        inline static const auto pipelineCacheDir = std::filesystem::path("cache") / "pipelines";
         static constexpr std::array<const char*, 1> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
         static Device deviceInstance;
@@ -0,0 +1,164 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include "utils/Debug.h"
+#include "Device.h"
+
+namespace RT::Vulkan
+{
+
+	GpuProfiler GpuProfiler::profilerInstance = GpuProfiler{};
+
+	void GpuProfiler::init()
+	{
+		const auto& deviceInstance = DeviceInstance;
+		const auto& limits = deviceInstance.getLimits();
+
+		uint32_t queueFamilyCount = 0u;
+		vkGetPhysicalDeviceQueueFamilyProperties(deviceInstance.getPhysicalDevice(), &queueFamilyCount, nullptr);
+		auto queueFamilies = std::vector<VkQueueFamilyProperties>(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(deviceInstance.getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+		const uint32_t validBits = queueFamilies[deviceInstance.getQueueFamilyIndices().graphicsFamily].timestampValidBits;
+		if (0u == validBits or 0.0f == limits.timestampPeriod)
+		{
+			RT_LOG_WARN("Timestamp queries are not supported, GPU profiling is disabled");
+			return;
+		}
+
+		timestampPeriod = limits.timestampPeriod;
+		timestampMask = validBits < 64u ? (1ull << validBits) - 1u : ~0ull;
+
+		auto poolInfo = VkQueryPoolCreateInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = queriesPerSlot * Constants::MAX_FRAMES_IN_FLIGHT;
+		CHECK_VK(vkCreateQueryPool(deviceInstance.getDevice(), &poolInfo, nullptr, &queryPool), "failed to create timestamp query pool!");
+	}
+
+	void GpuProfiler::shutdown()
+	{
+		for (const auto& scope : scopes)
+		{
+			RT_LOG_INFO("GPU {}: {:.3f} ms average over the last {} frames", scope.name, scope.averageMs, scope.sampleCnt);
+		}
+
+		vkDestroyQueryPool(DeviceInstance.getDevice(), queryPool, nullptr);
+		queryPool = VK_NULL_HANDLE;
+		scopes.clear();
+		for (auto& pending : pendingScopes)
+		{
+			pending.clear();
+		}
+	}
+
+	void GpuProfiler::beginFrame(const VkCommandBuffer cmdBuffer, const uint32_t frameSlot)
+	{
+		if (VK_NULL_HANDLE == queryPool)
+		{
+			return;
+		}
+
+		// The fence of this slot was waited on before recording, its queries are complete
+		collect(frameSlot);
+
+		currentSlot = frameSlot;
+		pendingScopes[currentSlot].clear();
+		vkCmdResetQueryPool(cmdBuffer, queryPool, currentSlot * queriesPerSlot, queriesPerSlot);
+	}
+
+	uint32_t GpuProfiler::beginScope(const VkCommandBuffer cmdBuffer, const char* name)
+	{
+		auto& pending = pendingScopes[currentSlot];
+		if (VK_NULL_HANDLE == queryPool or pending.size() >= maxScopesPerFrame)
+		{
+			return invalidScope;
+		}
+
+		const auto& scope = pending.emplace_back(PendingScope{ name, currentSlot * queriesPerSlot + 2u * (uint32_t)pending.size() });
+		vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, scope.firstQuery);
+		return pending.size() - 1u;
+	}
+
+	void GpuProfiler::endScope(const VkCommandBuffer cmdBuffer, const uint32_t scopeIdx)
+	{
+		if (invalidScope == scopeIdx)
+		{
+			return;
+		}
+
+		const auto& scope = pendingScopes[currentSlot][scopeIdx];
+		vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, scope.firstQuery + 1u);
+	}
+
+	void GpuProfiler::collect(const uint32_t frameSlot)
+	{
+		const auto& pending = pendingScopes[frameSlot];
+		if (pending.empty())
+		{
+			return;
+		}
+
+		auto timestamps = std::array<uint64_t, queriesPerSlot>{};
+		const uint32_t queryCnt = 2u * pending.size();
+		const auto result = vkGetQueryPoolResults(
+			DeviceInstance.getDevice(),
+			queryPool,
+			frameSlot * queriesPerSlot,
+			queryCnt,
+			queryCnt * sizeof(uint64_t),
+			timestamps.data(),
+			sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT);
+		if (VK_SUCCESS != result)
+		{
+			return;
+		}
+
+		auto frameMs = std::vector<float>(scopes.size(), 0.0f);
+		auto isRecorded = std::vector<bool>(scopes.size(), false);
+		for (uint32_t scopeIdx = 0u; scopeIdx < pending.size(); scopeIdx++)
+		{
+			const uint64_t ticks = (timestamps[2u * scopeIdx + 1u] - timestamps[2u * scopeIdx]) & timestampMask;
+			const uint32_t idx = findScope(pending[scopeIdx].name);
+			frameMs.resize(scopes.size(), 0.0f);
+			isRecorded.resize(scopes.size(), false);
+			frameMs[idx] += ticks * timestampPeriod / 1e6f;
+			isRecorded[idx] = true;
+		}
+
+		for (uint32_t idx = 0u; idx < scopes.size(); idx++)
+		{
+			if (not isRecorded[idx])
+			{
+				continue;
+			}
+
+			auto& scope = scopes[idx];
+			scope.lastMs = frameMs[idx];
+			scope.history[scope.historyHead] = frameMs[idx];
+			scope.historyHead = (scope.historyHead + 1u) % GpuScope::historySize;
+			scope.sampleCnt = std::min(scope.sampleCnt + 1u, GpuScope::historySize);
+			scope.averageMs = std::accumulate(scope.history.begin(), scope.history.end(), 0.0f) / scope.sampleCnt;
+		}
+	}
+
+	uint32_t GpuProfiler::findScope(const char* name)
+	{
+		for (uint32_t idx = 0u; idx < scopes.size(); idx++)
+		{
+			if (0 == std::strcmp(scopes[idx].name, name))
+			{
+				return idx;
+			}
+		}
+
+		auto& scope = scopes.emplace_back();
+		scope.name = name;
+		return scopes.size() - 1u;
+	}
+
+}
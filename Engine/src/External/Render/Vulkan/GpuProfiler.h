@@ -0,0 +1,75 @@
+#pragma once
+#include <array>
+#include <span>
+#include <vector>
+
+#include "Engine/Render/RenderApi.h"
+
+#include "utils/Constants.h"
+
+#include <vulkan/vulkan.h>
+
+namespace RT::Vulkan
+{
+
+	/*
+	* Measures GPU time of command buffer sections with timestamp queries. Every frame in flight
+	* owns a slice of the query pool; the slice is read back when the frame comes around again,
+	* after its fence was waited on, so reading never stalls the queue. Scopes recorded several
+	* times a frame under the same name are summed.
+	*/
+	class GpuProfiler
+	{
+	public:
+		~GpuProfiler() = default;
+
+		GpuProfiler(const GpuProfiler&) = delete;
+		GpuProfiler(GpuProfiler&&) = delete;
+		GpuProfiler& operator=(const GpuProfiler&) = delete;
+		GpuProfiler&& operator=(GpuProfiler&&) = delete;
+
+		static GpuProfiler& getProfilerInstance() { return profilerInstance; }
+
+		void init();
+		void shutdown();
+
+		void beginFrame(const VkCommandBuffer cmdBuffer, const uint32_t frameSlot);
+		uint32_t beginScope(const VkCommandBuffer cmdBuffer, const char* name);
+		void endScope(const VkCommandBuffer cmdBuffer, const uint32_t scopeIdx);
+
+		std::span<const GpuScope> getScopes() const { return scopes; }
+
+	public:
+		static constexpr uint32_t invalidScope = 0xFFFFFFFF;
+
+	private:
+		struct PendingScope
+		{
+			const char* name = "";
+			uint32_t firstQuery = 0u;
+		};
+
+	private:
+		GpuProfiler() = default;
+
+		void collect(const uint32_t frameSlot);
+		uint32_t findScope(const char* name);
+
+	private:
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		float timestampPeriod = 0.0f;	// nanoseconds per tick
+		uint64_t timestampMask = 0u;
+
+		uint32_t currentSlot = 0u;
+		std::array<std::vector<PendingScope>, Constants::MAX_FRAMES_IN_FLIGHT> pendingScopes = {};
+		std::vector<GpuScope> scopes = {};
+
+		static constexpr uint32_t maxScopesPerFrame = 32u;
+		static constexpr uint32_t queriesPerSlot = 2u * maxScopesPerFrame;
+
+		static GpuProfiler profilerInstance;
+	};
+
+	#define GpuProfilerInstance ::RT::Vulkan::GpuProfiler::getProfilerInstance()
+
+}
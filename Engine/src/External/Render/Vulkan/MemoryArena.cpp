@@ -0,0 +1,311 @@
+#include "MemoryArena.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "utils/Debug.h"
+
+namespace
+{
+
+	constexpr VkDeviceSize alignUp(const VkDeviceSize offset, const VkDeviceSize alignment)
+	{
+		return (offset + alignment - 1u) / alignment * alignment;
+	}
+
+	constexpr const char* resource2Str(const RT::Vulkan::MemoryArena::Resource resource)
+	{
+		return RT::Vulkan::MemoryArena::Resource::Buffer == resource ? "buffers" : "images";
+	}
+
+	constexpr const char* strategy2Str(const RT::Vulkan::MemoryArena::Strategy strategy)
+	{
+		return RT::Vulkan::MemoryArena::Strategy::FreeList == strategy ? "free list" : "linear";
+	}
+
+	constexpr float toMB(const VkDeviceSize size)
+	{
+		return size / (1024.0f * 1024.0f);
+	}
+
+}
+
+namespace RT::Vulkan
+{
+
+	void MemoryArena::init(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkPhysicalDeviceLimits& limits)
+	{
+		this->device = device;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		nonCoherentAtomSize = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1u);
+		maxAllocationCnt = limits.maxMemoryAllocationCount;
+	}
+
+	void MemoryArena::release()
+	{
+		logReport();
+		for (auto& pool : pools)
+		{
+			for (uint32_t blockIdx = 0u; blockIdx < pool.blocks.size(); blockIdx++)
+			{
+				if (pool.blocks[blockIdx])
+				{
+					releaseBlock(pool, blockIdx);
+				}
+			}
+		}
+		pools.clear();
+	}
+
+	MemoryAllocation MemoryArena::allocate(
+		const VkMemoryRequirements& requirements,
+		const uint32_t memoryType,
+		const Resource resource,
+		const Strategy strategy)
+	{
+		// Mapped ranges are flushed in whole atoms, neighbours must not share one
+		const bool isHostVisible = 0u != (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		const VkDeviceSize alignment = isHostVisible ? std::lcm(requirements.alignment, nonCoherentAtomSize) : requirements.alignment;
+		const VkDeviceSize size = alignUp(requirements.size, isHostVisible ? nonCoherentAtomSize : 1u);
+
+		const uint32_t poolIdx = findPool(memoryType, resource, strategy);
+		auto& pool = pools[poolIdx];
+
+		auto allocation = MemoryAllocation{};
+		allocation.size = size;
+		allocation.poolIdx = poolIdx;
+
+		bool isCarved = false;
+		for (uint32_t blockIdx = 0u; blockIdx < pool.blocks.size() and not isCarved; blockIdx++)
+		{
+			if (pool.blocks[blockIdx] and carve(*pool.blocks[blockIdx], strategy, size, alignment, allocation.offset))
+			{
+				allocation.blockIdx = blockIdx;
+				isCarved = true;
+			}
+		}
+
+		if (not isCarved)
+		{
+			allocation.blockIdx = createBlock(pool, size);
+			carve(*pool.blocks[allocation.blockIdx], strategy, size, alignment, allocation.offset);
+		}
+
+		auto& block = *pool.blocks[allocation.blockIdx];
+		block.allocationCnt++;
+		block.usedSize += size;
+		allocation.memory = block.memory;
+		allocation.mapped = nullptr != block.mapped ? block.mapped + allocation.offset : nullptr;
+		return allocation;
+	}
+
+	void MemoryArena::free(MemoryAllocation& allocation)
+	{
+		if (VK_NULL_HANDLE == allocation.memory)
+		{
+			return;
+		}
+
+		auto& pool = pools[allocation.poolIdx];
+		auto& block = *pool.blocks[allocation.blockIdx];
+		block.allocationCnt--;
+		block.usedSize -= allocation.size;
+
+		if (Strategy::Linear == pool.strategy)
+		{
+			block.linearHead = 0u == block.allocationCnt ? 0u : block.linearHead;
+		}
+		else
+		{
+			// Merge with the free neighbours, so repeated resizes keep one large range instead of splinters
+			auto range = block.freeRanges.emplace(allocation.offset, allocation.size).first;
+			const auto next = std::next(range);
+			if (block.freeRanges.end() != next and range->first + range->second == next->first)
+			{
+				range->second += next->second;
+				block.freeRanges.erase(next);
+			}
+			if (block.freeRanges.begin() != range)
+			{
+				const auto prev = std::prev(range);
+				if (prev->first + prev->second == range->first)
+				{
+					prev->second += range->second;
+					block.freeRanges.erase(range);
+				}
+			}
+		}
+
+		// One empty block per pool is kept, so recreating a resource does not reach vkAllocateMemory again
+		const auto liveBlockCnt = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const Local<Block>& candidate) { return nullptr != candidate; });
+		if (0u == block.allocationCnt and liveBlockCnt > 1)
+		{
+			releaseBlock(pool, allocation.blockIdx);
+		}
+		allocation = MemoryAllocation{};
+	}
+
+	MemoryArena::Stats MemoryArena::getStats() const
+	{
+		auto stats = Stats{};
+		for (const auto& pool : pools)
+		{
+			for (const auto& block : pool.blocks)
+			{
+				if (block)
+				{
+					addStats(*block, pool.strategy, stats);
+				}
+			}
+		}
+		return stats;
+	}
+
+	void MemoryArena::logReport() const
+	{
+		const auto stats = getStats();
+		RT_LOG_INFO("Device memory: {:.1f} of {:.1f} MB used in {} blocks, {} allocations, fragmentation {:.1f}%",
+			toMB(stats.usedSize), toMB(stats.reservedSize), stats.blockCnt, stats.allocationCnt, 100.0f * stats.fragmentation());
+		RT_LOG_INFO("Device memory: {} live of {} allowed vkAllocateMemory, {} made so far",
+			deviceAllocationCnt, maxAllocationCnt, totalDeviceAllocationCnt);
+
+		for (const auto& pool : pools)
+		{
+			auto poolStats = Stats{};
+			for (const auto& block : pool.blocks)
+			{
+				if (block)
+				{
+					addStats(*block, pool.strategy, poolStats);
+				}
+			}
+			RT_LOG_INFO("  type {} {} {}: {:.1f} of {:.1f} MB in {} blocks, {} allocations, {} free ranges, largest {:.1f} MB",
+				pool.memoryType, resource2Str(pool.resource), strategy2Str(pool.strategy), toMB(poolStats.usedSize), toMB(poolStats.reservedSize),
+				poolStats.blockCnt, poolStats.allocationCnt, poolStats.freeRangeCnt, toMB(poolStats.largestFreeRange));
+		}
+	}
+
+	uint32_t MemoryArena::findPool(const uint32_t memoryType, const Resource resource, const Strategy strategy)
+	{
+		const auto pool = std::find_if(pools.begin(), pools.end(), [&](const Pool& pool)
+		{
+			return memoryType == pool.memoryType and resource == pool.resource and strategy == pool.strategy;
+		});
+		if (pools.end() != pool)
+		{
+			return pool - pools.begin();
+		}
+
+		pools.push_back(Pool{ memoryType, resource, strategy });
+		return pools.size() - 1u;
+	}
+
+	uint32_t MemoryArena::createBlock(Pool& pool, const VkDeviceSize minSize)
+	{
+		// Resources larger than a block get a dedicated one of their own size
+		auto block = makeLocal<Block>();
+		block->size = std::max(blockSize, minSize);
+		if (Strategy::FreeList == pool.strategy)
+		{
+			block->freeRanges.emplace(0u, block->size);
+		}
+
+		auto allocInfo = VkMemoryAllocateInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = block->size;
+		allocInfo.memoryTypeIndex = pool.memoryType;
+		CHECK_VK(vkAllocateMemory(device, &allocInfo, nullptr, &block->memory), "failed to allocate memory block!");
+		deviceAllocationCnt++;
+		totalDeviceAllocationCnt++;
+
+		if (0u != (memoryProperties.memoryTypes[pool.memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+		{
+			void* mapped = nullptr;
+			CHECK_VK(vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &mapped), "failed to map memory block!");
+			block->mapped = static_cast<uint8_t*>(mapped);
+		}
+
+		RT_LOG_DEBUG("Memory block allocated: {{ type = {}, {}, size = {:.1f} MB }}", pool.memoryType, resource2Str(pool.resource), toMB(block->size));
+
+		const auto emptySlot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+		if (pool.blocks.end() != emptySlot)
+		{
+			*emptySlot = std::move(block);
+			return emptySlot - pool.blocks.begin();
+		}
+		pool.blocks.push_back(std::move(block));
+		return pool.blocks.size() - 1u;
+	}
+
+	void MemoryArena::releaseBlock(Pool& pool, const uint32_t blockIdx)
+	{
+		auto& block = pool.blocks[blockIdx];
+		if (nullptr != block->mapped)
+		{
+			vkUnmapMemory(device, block->memory);
+		}
+		vkFreeMemory(device, block->memory, nullptr);
+		deviceAllocationCnt--;
+		block.reset();
+	}
+
+	bool MemoryArena::carve(Block& block, const Strategy strategy, const VkDeviceSize size, const VkDeviceSize alignment, VkDeviceSize& offset) const
+	{
+		if (Strategy::Linear == strategy)
+		{
+			offset = alignUp(block.linearHead, alignment);
+			if (offset + size > block.size)
+			{
+				return false;
+			}
+			block.linearHead = offset + size;
+			return true;
+		}
+
+		for (auto range = block.freeRanges.begin(); range != block.freeRanges.end(); range++)
+		{
+			const VkDeviceSize rangeBegin = range->first;
+			const VkDeviceSize rangeEnd = range->first + range->second;
+			offset = alignUp(rangeBegin, alignment);
+			if (offset + size > rangeEnd)
+			{
+				continue;
+			}
+
+			// Alignment padding in front and the rest behind stay free
+			block.freeRanges.erase(range);
+			if (offset > rangeBegin)
+			{
+				block.freeRanges.emplace(rangeBegin, offset - rangeBegin);
+			}
+			if (rangeEnd > offset + size)
+			{
+				block.freeRanges.emplace(offset + size, rangeEnd - offset - size);
+			}
+			return true;
+		}
+		return false;
+	}
+
+	void MemoryArena::addStats(const Block& block, const Strategy strategy, Stats& stats) const
+	{
+		stats.blockCnt++;
+		stats.allocationCnt += block.allocationCnt;
+		stats.reservedSize += block.size;
+		stats.usedSize += block.usedSize;
+
+		if (Strategy::Linear == strategy)
+		{
+			stats.freeRangeCnt += block.linearHead < block.size ? 1u : 0u;
+			stats.largestFreeRange = std::max(stats.largestFreeRange, block.size - block.linearHead);
+			return;
+		}
+
+		stats.freeRangeCnt += block.freeRanges.size();
+		for (const auto& [offset, size] : block.freeRanges)
+		{
+			stats.largestFreeRange = std::max(stats.largestFreeRange, size);
+		}
+	}
+
+}
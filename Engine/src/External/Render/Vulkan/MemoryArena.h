@@ -0,0 +1,112 @@
+#pragma once
+#include <map>
+#include <vector>
+
+#include "Engine/Core/Base.h"
+
+#include <vulkan/vulkan.h>
+
+namespace RT::Vulkan
+{
+
+	struct MemoryAllocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0u;
+		VkDeviceSize size = 0u;
+		uint8_t* mapped = nullptr;	// host visible memory stays mapped while its block lives
+		uint32_t poolIdx = 0u;
+		uint32_t blockIdx = 0u;
+	};
+
+	/*
+	* Sub-allocates device memory out of large blocks. Every memory type has its own pools for
+	* buffers and images, so bufferImageGranularity never has to be respected between neighbours.
+	* Free list pools serve long living resources with first fit and coalescing on free, linear
+	* pools bump a head for short living staging memory and rewind once their block is empty.
+	* Host visible blocks are mapped once, allocations only hand out pointers into that mapping.
+	*/
+	class MemoryArena
+	{
+	public:
+		enum class Resource : uint8_t { Buffer, Image };
+		enum class Strategy : uint8_t { FreeList, Linear };
+
+		struct Stats
+		{
+			uint32_t blockCnt = 0u;
+			uint32_t allocationCnt = 0u;
+			uint32_t freeRangeCnt = 0u;
+			VkDeviceSize reservedSize = 0u;
+			VkDeviceSize usedSize = 0u;
+			VkDeviceSize largestFreeRange = 0u;
+
+			// Share of the free space outside of the largest free range, 0 while it is contiguous
+			float fragmentation() const
+			{
+				const VkDeviceSize freeSize = reservedSize - usedSize;
+				return freeSize > 0u ? 1.0f - (float)largestFreeRange / (float)freeSize : 0.0f;
+			}
+		};
+
+	public:
+		MemoryArena() = default;
+		~MemoryArena() = default;
+
+		MemoryArena(const MemoryArena&) = delete;
+		MemoryArena& operator=(const MemoryArena&) = delete;
+
+		void init(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkPhysicalDeviceLimits& limits);
+		void release();
+
+		MemoryAllocation allocate(
+			const VkMemoryRequirements& requirements,
+			const uint32_t memoryType,
+			const Resource resource,
+			const Strategy strategy = Strategy::FreeList);
+		void free(MemoryAllocation& allocation);
+
+		Stats getStats() const;
+		void logReport() const;
+
+	private:
+		struct Block
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0u;
+			uint8_t* mapped = nullptr;
+			uint32_t allocationCnt = 0u;
+			VkDeviceSize usedSize = 0u;
+			VkDeviceSize linearHead = 0u;
+			std::map<VkDeviceSize, VkDeviceSize> freeRanges = {};	// offset -> size
+		};
+
+		struct Pool
+		{
+			uint32_t memoryType = 0u;
+			Resource resource = Resource::Buffer;
+			Strategy strategy = Strategy::FreeList;
+			std::vector<Local<Block>> blocks = {};	// released blocks leave an empty slot, so indices stay valid
+		};
+
+	private:
+		uint32_t findPool(const uint32_t memoryType, const Resource resource, const Strategy strategy);
+		uint32_t createBlock(Pool& pool, const VkDeviceSize minSize);
+		void releaseBlock(Pool& pool, const uint32_t blockIdx);
+		bool carve(Block& block, const Strategy strategy, const VkDeviceSize size, const VkDeviceSize alignment, VkDeviceSize& offset) const;
+		void addStats(const Block& block, const Strategy strategy, Stats& stats) const;
+
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties = {};
+		VkDeviceSize nonCoherentAtomSize = 1u;
+		uint32_t maxAllocationCnt = 0u;
+
+		std::vector<Pool> pools = {};
+		uint32_t deviceAllocationCnt = 0u;
+		uint64_t totalDeviceAllocationCnt = 0u;
+
+		static constexpr VkDeviceSize blockSize = 64ull << 20u;
+	};
+
+}
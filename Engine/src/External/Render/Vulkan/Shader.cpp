@@ -8,10 +8,31 @@
 
 #include "utils/Debug.h"
 
+namespace
+{
+
+    constexpr uint64_t fnvOffsetBasis = 14695981039346656037ull;
+    constexpr uint64_t fnvPrime = 1099511628211ull;
+    constexpr uint32_t spirvMagic = 0x07230203u;
+
+    uint64_t fnv1a(const void* data, const size_t size, uint64_t hash = fnvOffsetBasis)
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0u; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= fnvPrime;
+        }
+        return hash;
+    }
+
+}
+
 namespace RT::Vulkan
 {
 
-    Shader::Shader(const Path& shaderName)
+    Shader::Shader(const Path& shaderName, const ShaderDefines& defines)
+        : defines{defines}
     {
         load(shaderName);
     }
@@ -32,7 +53,25 @@ namespace RT::Vulkan
 
 		auto shadersSources = readSources();
         RT_ASSERT(shadersSources.size() != 0, "Failed to find source code!");
-        auto compiledSources = compileSources(shadersSources);
+
+        // Compiling with full optimization is slow, unchanged sources reuse the SPIR-V of an earlier run
+        auto compiledSources = SourceMap<std::vector<uint32_t>>();
+        for (const auto& [type, source] : shadersSources)
+        {
+            const auto sourceText = source.str();
+            const auto cachePath = binaryPath(type, sourceText);
+            auto binary = readBinary(cachePath);
+            if (binary.empty())
+            {
+                binary = compileSource(type, sourceText);
+                writeBinary(cachePath, binary);
+            }
+            else
+            {
+                RT_LOG_INFO("Shader {} stage loaded from cache {}", shaderType2String(type), cachePath);
+            }
+            compiledSources[type] = std::move(binary);
+        }
 
         shaderModules.reserve(compiledSources.size());
         stages.reserve(compiledSources.size());
@@ -108,57 +147,97 @@ namespace RT::Vulkan
         return shadersSource;
     }
 
-    // TODO: when cashing shaders will be implemented
-    Shader::SourceMap<std::vector<char>> Shader::readBinaries() const
+    Shader::Path Shader::binaryPath(const Type type, const std::string& source) const
     {
-        auto file = std::ifstream(shaderPath, std::ios::ate | std::ios::binary);
+        auto key = fnv1a(source.data(), source.size());
+        key = fnv1a(&type, sizeof(type), key);
+        key = fnv1a(&compilerRevision, sizeof(compilerRevision), key);
+        key = fnv1a(&targetEnv, sizeof(targetEnv), key);
+        key = fnv1a(&optimizationLevel, sizeof(optimizationLevel), key);
+        for (const auto& [name, value] : defines)
+        {
+            // Terminators included, so {"AB", ""} and {"A", "B"} do not collide
+            key = fnv1a(name.c_str(), name.size() + 1u, key);
+            key = fnv1a(value.c_str(), value.size() + 1u, key);
+        }
+        return cacheDir / fmt::format("{}-{:016x}{}.spv", shaderPath.stem().string(), key, shaderType2Suffix(type));
+    }
 
-        RT_ASSERT(file.is_open(), "failed to open shader binary: {}", shaderPath);
+    std::vector<uint32_t> Shader::readBinary(const Path& path) const
+    {
+        auto file = std::ifstream(path, std::ios::ate | std::ios::binary);
+        if (not file.is_open())
+        {
+            return {};
+        }
 
-        auto fileSize = static_cast<size_t>(file.tellg());
-        auto buffer = std::vector<char>(fileSize);
-        
+        const auto fileSize = static_cast<size_t>(file.tellg());
+        if (0u == fileSize or 0u != fileSize % sizeof(uint32_t))
+        {
+            return {};
+        }
+
+        auto binary = std::vector<uint32_t>(fileSize / sizeof(uint32_t));
         file.seekg(0);
-        file.read(buffer.data(), fileSize);
+        file.read(reinterpret_cast<char*>(binary.data()), fileSize);
+        if (not file or spirvMagic != binary.front())
+        {
+            RT_LOG_WARN("Ignoring corrupted shader binary {}", path);
+            return {};
+        }
+        return binary;
+    }
+
+    void Shader::writeBinary(const Path& path, const std::vector<uint32_t>& binary) const
+    {
+        auto error = std::error_code{};
+        std::filesystem::create_directories(path.parent_path(), error);
 
-        file.close();
+        // Written aside and renamed, a crash while writing never leaves a truncated module behind
+        auto tmpPath = path;
+        tmpPath += ".tmp";
+        {
+            auto file = std::ofstream(tmpPath, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(binary.data()), binary.size() * sizeof(uint32_t));
+            if (not file)
+            {
+                RT_LOG_WARN("Failed to write shader binary {}", tmpPath);
+                return;
+            }
+        }
 
-        return {};
+        std::filesystem::rename(tmpPath, path, error);
+        if (error)
+        {
+            RT_LOG_WARN("Failed to store shader binary {}: {}", path, error.message());
+            std::filesystem::remove(tmpPath, error);
+        }
     }
 
-    Shader::SourceMap<std::vector<uint32_t>> Shader::compileSources(const SourceMap<std::stringstream>& sources) const
+    std::vector<uint32_t> Shader::compileSource(const Type type, const std::string& source) const
     {
         auto compiler = shaderc::Compiler{};
         auto options = shaderc::CompileOptions{};
-
-        options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
-        constexpr bool optimize = false;
-        if (optimize)
+        options.SetTargetEnvironment(shaderc_target_env_vulkan, targetEnv);
+        options.SetOptimizationLevel(optimizationLevel);
+        for (const auto& [name, value] : defines)
         {
-            options.SetOptimizationLevel(shaderc_optimization_level_performance);
+            options.AddMacroDefinition(name, value);
         }
 
-        auto sourceMap = SourceMap<std::vector<uint32_t>>();
-        for (const auto& [type, source] : sources)
-        {
-            //auto dstPath = shaderPath.parent_path() / shaderPath.stem() / shaderType2suffix(type) / ".spv";
+        auto shaderModule = compiler.CompileGlslToSpv(
+            source,
+            shaderType2ShaderC(type),
+            shaderPath.string().c_str(),
+            "main",
+            options);
 
-            auto shaderModule = compiler.CompileGlslToSpv(
-                source.str(),
-                shaderType2ShaderC(type),
-                shaderPath.string().c_str(),
-                "main",
-                options);
-            
-            RT_ASSERT(
-                shaderModule.GetCompilationStatus() == shaderc_compilation_status_success,
-                "Compilation Errors:\n{}",
-                shaderModule.GetErrorMessage().c_str());
-
-            sourceMap[type] = std::vector<uint32_t>(shaderModule.begin(), shaderModule.end());
-        }
+        RT_ASSERT(
+            shaderModule.GetCompilationStatus() == shaderc_compilation_status_success,
+            "Compilation Errors:\n{}",
+            shaderModule.GetErrorMessage().c_str());
 
-        return sourceMap;
+        return std::vector<uint32_t>(shaderModule.begin(), shaderModule.end());
     }
 
     void Shader::reflect(const Type type, const std::vector<uint32_t>& shaderData) const
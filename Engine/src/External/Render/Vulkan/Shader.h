@@ -4,6 +4,8 @@
 #include <vector>
 #include <filesystem>
 
+#include "Engine/Render/Pipeline.h"
+
 #include <shaderc/shaderc.hpp>
 #include <vulkan/vulkan.h>
 
@@ -32,7 +34,7 @@ namespace RT::Vulkan
 		using Path = std::filesystem::path;
 
 	public:
-        Shader(const Path& shaderName);
+        Shader(const Path& shaderName, const ShaderDefines& defines = {});
         ~Shader();
 
 		void load(const Path& shaderName);
@@ -42,8 +44,10 @@ namespace RT::Vulkan
 
 	private:
 		SourceMap<std::stringstream> readSources() const;
-		SourceMap<std::vector<char>> readBinaries() const;
-		SourceMap<std::vector<uint32_t>> compileSources(const SourceMap<std::stringstream>& sources) const;
+		Path binaryPath(const Type type, const std::string& source) const;
+		std::vector<uint32_t> readBinary(const Path& path) const;
+		void writeBinary(const Path& path, const std::vector<uint32_t>& binary) const;
+		std::vector<uint32_t> compileSource(const Type type, const std::string& source) const;
 		void reflect(const Type type, const std::vector<uint32_t>& shaderData) const;
 
 		static constexpr VkShaderStageFlagBits shaderType2VkType(const Type type);
@@ -53,11 +57,18 @@ namespace RT::Vulkan
 
 	private:
 		Path shaderPath = "";
+		ShaderDefines defines = {};
 
 		std::vector<VkShaderModule> shaderModules = {};
 		Stages stages = {};
 
 		static constexpr std::string_view shaderDir = "..\\Engine\\assets\\shaders\\";
+		inline static const auto cacheDir = Path("cache") / "shaders";
+
+		// Part of the binary cache key, bump on any change to how sources are compiled
+		static constexpr uint32_t compilerRevision = 1u;
+		static constexpr shaderc_env_version targetEnv = shaderc_env_version_vulkan_1_1;
+		static constexpr shaderc_optimization_level optimizationLevel = shaderc_optimization_level_performance;
 	};
 
 }
@@ -11,6 +11,7 @@ namespace RT::Vulkan
 {
 
 	auto uniformsToFlush = std::vector<VulkanUniform*>();
+	uint64_t uploadedSize = 0u;
 
 	VulkanVertexBuffer::VulkanVertexBuffer(const uint32_t size)
 	{
@@ -33,7 +34,7 @@ namespace RT::Vulkan
 	{
 		const auto device = DeviceInstance.getDevice();
 		vkDestroyBuffer(device, vertexBuffer, nullptr);
-		vkFreeMemory(device, vertexMemory, nullptr);
+		DeviceInstance.freeMemory(vertexMemory);
 	}
 
 	void VulkanVertexBuffer::registerAttributes(const VertexElements& elements) const
@@ -42,12 +43,7 @@ namespace RT::Vulkan
 
 	void VulkanVertexBuffer::setData(const uint32_t size, const void* data) const
 	{
-		const auto device = DeviceInstance.getDevice();
-		
-		void* dstData = nullptr;
-		vkMapMemory(device, vertexMemory, 0, size, 0, &dstData);
-		std::memcpy(dstData, data, size);
-		vkUnmapMemory(device, vertexMemory);
+		std::memcpy(vertexMemory.mapped, data, size);
 	}
 
 	void VulkanVertexBuffer::bind(const VkCommandBuffer commandBuffer) const
@@ -109,23 +105,45 @@ namespace RT::Vulkan
 		RT_LOG_INFO("Creating Uniform: {{ type = {}, size = {} }}", RT::Utils::uniformType2Str(uniformType), instanceSize);
 
 		alignedSize = calculateAlignedSize(instanceSize, getMinOffsetAlignment());
+		atomSize = (uint32_t)std::max<VkDeviceSize>(DeviceInstance.getLimits().nonCoherentAtomSize, 1u);
 
-		masterBuffer.resize(alignedSize);
-		std::fill(masterBuffer.begin(), masterBuffer.end(), 0);
-
-		DeviceInstance.createBuffer(
-			wholeSize(),
-			uniformType2VkBuffBit(uniformType),
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-			uniBuffer,
-			uniMemory);
-		CHECK_VK(vkMapMemory(DeviceInstance.getDevice(), uniMemory, 0, wholeSize(), 0, &mapped), "faile to map Uniform memory!");
+		if (isStatic())
+		{
+			// Only staging copies write it, so a single region serves every frame in flight
+			DeviceInstance.createBuffer(
+				wholeSize(),
+				uniformType2VkBuffBit(uniformType) | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				uniBuffer,
+				uniMemory);
+			DeviceInstance.execSingleCmdPass([&](const VkCommandBuffer cmdBuffer)
+			{
+				vkCmdFillBuffer(cmdBuffer, uniBuffer, 0, VK_WHOLE_SIZE, 0u);
+			});
+		}
+		else
+		{
+			masterBuffer.resize(alignedSize);
+			std::fill(masterBuffer.begin(), masterBuffer.end(), 0);
+
+			DeviceInstance.createBuffer(
+				wholeSize(),
+				uniformType2VkBuffBit(uniformType),
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+				uniBuffer,
+				uniMemory);
+			mapped = uniMemory.mapped;
+
+			// Every region starts as a copy of the zeroed master buffer
+			uniformsToFlush.push_back(this);
+			markDirty(0u, alignedSize);
+		}
 
 		descriptorInfo = std::array<VkDescriptorBufferInfo, Constants::MAX_FRAMES_IN_FLIGHT>{};
 		for (uint32_t offsetIdx = 0u; offsetIdx < descriptorInfo.size(); offsetIdx++)
 		{
 			auto& bufferInfo = descriptorInfo[offsetIdx];
-			bufferInfo.offset = offsetIdx * alignedSize;
+			bufferInfo.offset = isStatic() ? 0u : offsetIdx * alignedSize;
 			bufferInfo.range = alignedSize;
 			bufferInfo.buffer = uniBuffer;
 		}
@@ -135,10 +153,8 @@ namespace RT::Vulkan
 	VulkanUniform::~VulkanUniform()
 	{
 		DeviceInstance.waitForIdle();
-		const auto device = DeviceInstance.getDevice();
-		vkUnmapMemory(device, uniMemory);
-		vkDestroyBuffer(device, uniBuffer, nullptr);
-		vkFreeMemory(device, uniMemory, nullptr);
+		vkDestroyBuffer(DeviceInstance.getDevice(), uniBuffer, nullptr);
+		DeviceInstance.freeMemory(uniMemory);
 
 		auto self = std::find(uniformsToFlush.begin(), uniformsToFlush.end(), this);
 		if (uniformsToFlush.end() != self)
@@ -160,6 +176,12 @@ namespace RT::Vulkan
 			return;
 		}
 
+		if (isStatic())
+		{
+			uploadStatic(data, size, offset);
+			return;
+		}
+
 		auto* dst = masterBuffer.data() + offset;
 		std::memcpy(dst, data, size);
 
@@ -167,41 +189,118 @@ namespace RT::Vulkan
 		{
 			uniformsToFlush.push_back(this);
 		}
-		std::fill(flashInThisFrame.begin(), flashInThisFrame.end(), true);
+		markDirty(offset, size);
 	}
 
 	bool VulkanUniform::flush() const
 	{
 		const auto currFrame = SwapchainInstance->getCurrentFrame();
-		if (not flashInThisFrame[currFrame])
+		auto& ranges = dirtyRanges[currFrame];
+		if (ranges.empty())
 		{
 			return true;
 		}
 
-		copyToRegionBuff(currFrame);
-
-		auto memRange = VkMappedMemoryRange{};
-		memRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		memRange.memory = uniMemory;
-		memRange.offset = alignedSize * currFrame;
-		memRange.size = alignedSize;
+		// Only what changed since this frame slot was written last goes to the device
+		auto memRanges = std::array<VkMappedMemoryRange, maxDirtyRanges>{};
+		const uint32_t regionOffset = alignedSize * currFrame;
+		for (uint32_t rangeIdx = 0u; rangeIdx < ranges.size(); rangeIdx++)
+		{
+			const auto& range = ranges[rangeIdx];
+			std::memcpy(mapped + regionOffset + range.begin, masterBuffer.data() + range.begin, range.end - range.begin);
+			uploadedSize += range.end - range.begin;
+
+			auto& memRange = memRanges[rangeIdx];
+			memRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			memRange.memory = uniMemory.memory;
+			memRange.offset = uniMemory.offset + regionOffset + range.begin;
+			memRange.size = range.end - range.begin;
+		}
 		CHECK_VK(
-			vkFlushMappedMemoryRanges(DeviceInstance.getDevice(), 1, &memRange),
+			vkFlushMappedMemoryRanges(DeviceInstance.getDevice(), (uint32_t)ranges.size(), memRanges.data()),
 			"Failed to flush uniform buffer!");
-		
-		flashInThisFrame[currFrame] = false;
+
+		ranges.clear();
 		return stillNeedFlush();
 	}
 
+	void VulkanUniform::uploadStatic(const void* data, const uint32_t size, const uint32_t offset) const
+	{
+		if (0u == size)
+		{
+			return;
+		}
+
+		const auto device = DeviceInstance.getDevice();
+		auto stagingBuffer = VkBuffer{};
+		auto stagingMemory = MemoryAllocation{};
+		DeviceInstance.createBuffer(
+			size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			stagingBuffer,
+			stagingMemory,
+			MemoryArena::Strategy::Linear);
+		std::memcpy(stagingMemory.mapped, data, size);
+		uploadedSize += size;
+
+		DeviceInstance.execSingleCmdPass([&](const VkCommandBuffer cmdBuffer)
+		{
+			// Frames submitted earlier may still be reading the region that gets replaced
+			auto barrier = VkMemoryBarrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+			auto region = VkBufferCopy{};
+			region.srcOffset = 0u;
+			region.dstOffset = offset;
+			region.size = size;
+			vkCmdCopyBuffer(cmdBuffer, stagingBuffer, uniBuffer, 1, &region);
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		});
+
+		vkDestroyBuffer(device, stagingBuffer, nullptr);
+		DeviceInstance.freeMemory(stagingMemory);
+	}
+
 	bool VulkanUniform::stillNeedFlush() const
 	{
-		return std::any_of(flashInThisFrame.begin(), flashInThisFrame.end(), [](bool flashed) { return flashed; });
+		return std::any_of(dirtyRanges.begin(), dirtyRanges.end(), [](const auto& ranges) { return not ranges.empty(); });
 	}
 
-	void VulkanUniform::copyToRegionBuff(const uint8_t buffIdx) const
+	void VulkanUniform::markDirty(const uint32_t offset, const uint32_t size)
 	{
-		auto dst = (uint8_t*)mapped + buffIdx * alignedSize;
-		std::memcpy(dst, masterBuffer.data(), alignedSize);
+		// Widened to whole atoms, so every range is flushable on its own
+		const uint32_t begin = offset / atomSize * atomSize;
+		const uint32_t end = std::min((offset + size + atomSize - 1u) / atomSize * atomSize, alignedSize);
+
+		for (auto& ranges : dirtyRanges)
+		{
+			auto newRange = DirtyRange{ begin, end };
+			auto first = std::lower_bound(ranges.begin(), ranges.end(), begin, [](const DirtyRange& range, const uint32_t offset)
+			{
+				return range.end < offset;
+			});
+			auto last = first;
+			while (ranges.end() != last and last->begin <= end)
+			{
+				newRange.begin = std::min(newRange.begin, last->begin);
+				newRange.end = std::max(newRange.end, last->end);
+				last++;
+			}
+			ranges.insert(ranges.erase(first, last), newRange);
+
+			// Past the limit a single span is cheaper to flush than many small ones
+			if (ranges.size() > maxDirtyRanges)
+			{
+				ranges = { DirtyRange{ ranges.front().begin, ranges.back().end } };
+			}
+		}
 	}
 
 	uint64_t VulkanUniform::getMinOffsetAlignment() const
@@ -221,6 +320,7 @@ namespace RT::Vulkan
 		{
 			case UniformType::Uniform: return VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
 			case UniformType::Storage: return VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+			case UniformType::StaticStorage: return VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 		}
 		return VkBufferUsageFlagBits{};
 	}
@@ -231,6 +331,7 @@ namespace RT::Vulkan
 		{
 			case UniformType::Uniform: return "Uniform";
 			case UniformType::Storage: return "Storage";
+			case UniformType::StaticStorage: return "StaticStorage";
 			case UniformType::Sampler: return "Sampler";
 			case UniformType::Image:   return "Image";
 		}
@@ -247,4 +348,9 @@ namespace RT::Vulkan
 		return uniformsToFlush;
 	}
 
+	uint64_t& getUploadedSize()
+	{
+		return uploadedSize;
+	}
+
 }
@@ -45,7 +45,7 @@ namespace RT::Vulkan
 
 	private:
 		VkBuffer vertexBuffer = {};
-		VkDeviceMemory vertexMemory = {};
+		MemoryAllocation vertexMemory = {};
 		uint32_t vertexCount = 0u;
 	};
 
@@ -73,10 +73,19 @@ namespace RT::Vulkan
 		VkBuffer getBuffer() const { return uniBuffer; }
 
 	private:
-		const uint32_t wholeSize() const { return alignedSize * Constants::MAX_FRAMES_IN_FLIGHT; }
+		struct DirtyRange
+		{
+			uint32_t begin = 0u;
+			uint32_t end = 0u;
+		};
+
+	private:
+		bool isStatic() const { return UniformType::StaticStorage == uniformType; }
+		const uint32_t wholeSize() const { return isStatic() ? alignedSize : alignedSize * Constants::MAX_FRAMES_IN_FLIGHT; }
 
+		void uploadStatic(const void* data, const uint32_t size, const uint32_t offset) const;
 		bool stillNeedFlush() const;
-		void copyToRegionBuff(const uint8_t buffIdx) const;
+		void markDirty(const uint32_t offset, const uint32_t size);
 		uint64_t getMinOffsetAlignment() const;
 
 		static constexpr VkBufferUsageFlagBits uniformType2VkBuffBit(const UniformType uniformType);
@@ -86,18 +95,22 @@ namespace RT::Vulkan
 	private:
 		UniformType uniformType = UniformType::None;
 		uint32_t alignedSize = 0u;
+		uint32_t atomSize = 1u;
 		std::vector<uint8_t> masterBuffer = {};
 
 		VkBuffer uniBuffer = {};
-		VkDeviceMemory uniMemory = {};
-		void* mapped = nullptr;
+		MemoryAllocation uniMemory = {};
+		uint8_t* mapped = nullptr;
 		
 		std::array<VkDescriptorBufferInfo, Constants::MAX_FRAMES_IN_FLIGHT> descriptorInfo = {};
-		mutable std::array<bool, Constants::MAX_FRAMES_IN_FLIGHT> flashInThisFrame = {};
+		mutable std::array<std::vector<DirtyRange>, Constants::MAX_FRAMES_IN_FLIGHT> dirtyRanges = {};	// sorted, disjoint
+
+		static constexpr uint32_t maxDirtyRanges = 8u;
 		
 		//VkDescriptorImageInfo imgInfo;
 	};
 
 	std::vector<VulkanUniform*>& getUniformsToFlush();
+	uint64_t& getUploadedSize();
 
 }
@@ -1,8 +1,13 @@
 #include "VulkanPipeline.h"
+
+#include <algorithm>
+
 #include "Context.h"
 
+#include "utils/Constants.h"
 #include "utils/Debug.h"
 
+#include "GpuProfiler.h"
 #include "VulkanBuffer.h"
 #include "VulkanRenderPass.h"
 
@@ -101,32 +106,38 @@ namespace RT::Vulkan
     }
 
     VulkanPipeline::VulkanPipeline(PipelineSpec& spec)
-        : layouts{std::move(spec.uniformLayouts)}, descriptors{layouts}
+        : layouts{std::move(spec.uniformLayouts)}
+        , descriptors{layouts}
+        , shaderPath{spec.shaderPath}
+        , attachmentFormats{spec.attachmentFormats}
     {
         createPipelineLayout();
 
-        auto pipelineConfigInfo = ConfigInfo::defaultConfig();
-        pipelineConfigInfo.pipelineLayout = pipelineLayout;
-        
-        auto shader = Shader(spec.shaderPath);
-        if (shader.isCompute())
+        // Nothing is bound yet, so the first variant is the only one built up front
+        selected = spec.variant;
+        bound = selected;
+        pipeline = createVariant(selected);
+        variants.emplace(selected, BuiltVariant{ pipeline, Context::frameNr });
+    }
+
+    VulkanPipeline::~VulkanPipeline()
+    {
         {
-            RT_LOG_INFO("Creating Pipeline: {{ mode = compute }}");
-            createComputePipeline(pipelineConfigInfo, shader);
+            auto lock = std::lock_guard{ variantMutex };
+            isStopping = true;
         }
-        else
+        // The variant in flight is finished, the queued ones are dropped
+        if (builder.valid())
         {
-            RT_LOG_INFO("Creating Pipeline: {{ mode = graphics }}");
-            createGraphicsPipeline(pipelineConfigInfo, shader, spec.attachmentFormats);
+            builder.wait();
         }
-        RT_LOG_INFO("Pipeline created");
-    }
 
-    VulkanPipeline::~VulkanPipeline()
-    {
         auto device = DeviceInstance.getDevice();
         vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-        vkDestroyPipeline(device, pipeline, nullptr);
+        for (const auto& [variant, built] : variants)
+        {
+            vkDestroyPipeline(device, built.pipeline, nullptr);
+        }
     }
 
     void VulkanPipeline::updateSet(const uint32_t layout, const uint32_t set, const uint32_t binding, const Uniform& uniform) const
@@ -156,15 +167,111 @@ namespace RT::Vulkan
     void VulkanPipeline::bind() const
     {
         bindDescriptors<VK_PIPELINE_BIND_POINT_GRAPHICS>();
-        vkCmdBindPipeline(Context::frameCmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        vkCmdBindPipeline(Context::frameCmd, VK_PIPELINE_BIND_POINT_GRAPHICS, selectedPipeline());
     }
 
     void VulkanPipeline::dispatch(const glm::uvec2 groups) const
     {
         bindDescriptors<VK_PIPELINE_BIND_POINT_COMPUTE>();
-        vkCmdBindPipeline(Context::frameCmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        vkCmdBindPipeline(Context::frameCmd, VK_PIPELINE_BIND_POINT_COMPUTE, selectedPipeline());
         const auto dispatchGroup = (groups + group - 1u) / group;
+        const uint32_t scope = GpuProfilerInstance.beginScope(Context::frameCmd, "Dispatch");
         vkCmdDispatch(Context::frameCmd, dispatchGroup.x, dispatchGroup.y, 1);
+        GpuProfilerInstance.endScope(Context::frameCmd, scope);
+    }
+
+    void VulkanPipeline::selectVariant(const ShaderVariant& variant)
+    {
+        selected = variant;
+
+        auto lock = std::lock_guard{ variantMutex };
+        requestFrame = Context::frameNr;
+        const auto found = variants.find(selected);
+        isSelectedBuilt = variants.end() != found;
+        if (isSelectedBuilt)
+        {
+            bindVariant(found->first, found->second.pipeline);
+            return;
+        }
+
+        // Asked for right now, so it jumps ahead of the prepared variants
+        std::erase(queuedVariants, selected);
+        queuedVariants.push_front(selected);
+        startBuilder();
+    }
+
+    void VulkanPipeline::prepareVariants(const std::vector<ShaderVariant>& upcoming)
+    {
+        auto lock = std::lock_guard{ variantMutex };
+        requestFrame = Context::frameNr;
+
+        // Only the latest neighbourhood is worth building, the selected variant keeps its place
+        std::erase_if(queuedVariants, [this](const ShaderVariant& queued) { return queued != selected; });
+        for (const auto& variant : upcoming)
+        {
+            const auto found = variants.find(variant);
+            if (variants.end() != found)
+            {
+                found->second.lastFrame = requestFrame;
+            }
+            else if (queuedVariants.end() == std::ranges::find(queuedVariants, variant))
+            {
+                queuedVariants.push_back(variant);
+            }
+        }
+        startBuilder();
+    }
+
+    VkPipeline VulkanPipeline::selectedPipeline() const
+    {
+        auto lock = std::lock_guard{ variantMutex };
+        if (not isSelectedBuilt)
+        {
+            const auto found = variants.find(selected);
+            isSelectedBuilt = variants.end() != found;
+            if (isSelectedBuilt)
+            {
+                bindVariant(found->first, found->second.pipeline);
+            }
+        }
+        variants.at(bound).lastFrame = Context::frameNr;
+        evictVariants();
+        return pipeline;
+    }
+
+    // Called with the variant mutex held
+    void VulkanPipeline::bindVariant(const ShaderVariant& variant, const VkPipeline variantPipeline) const
+    {
+        // The previous variant may still run in the frames in flight, its last use is stamped for the eviction
+        variants.at(bound).lastFrame = Context::frameNr;
+        bound = variant;
+        pipeline = variantPipeline;
+    }
+
+    // Called with the variant mutex held. Least recently used go first, but never the selected or the bound
+    // variant, nor one a frame in flight may still execute, so the map can briefly stay above the cap
+    void VulkanPipeline::evictVariants() const
+    {
+        while (variants.size() > maxVariantCnt)
+        {
+            auto oldest = variants.end();
+            for (auto it = variants.begin(); it != variants.end(); ++it)
+            {
+                const bool isInFlight = it->second.lastFrame + Constants::MAX_FRAMES_IN_FLIGHT > Context::frameNr;
+                const bool isInUse = it->first == selected or it->first == bound or isInFlight;
+                if (not isInUse and (variants.end() == oldest or it->second.lastFrame < oldest->second.lastFrame))
+                {
+                    oldest = it;
+                }
+            }
+            if (variants.end() == oldest)
+            {
+                return;
+            }
+
+            vkDestroyPipeline(DeviceInstance.getDevice(), oldest->second.pipeline, nullptr);
+            variants.erase(oldest);
+        }
     }
 
     template <VkPipelineBindPoint PipelinePoint>
@@ -196,39 +303,126 @@ namespace RT::Vulkan
             "Could not create pipeline Layout");
     }
 
-    void VulkanPipeline::createComputePipeline(ConfigInfo& configInfo, const Shader& shader)
+    // Called with the variant mutex held
+    void VulkanPipeline::startBuilder()
+    {
+        if (isBuilding or queuedVariants.empty())
+        {
+            return;
+        }
+
+        isBuilding = true;
+        builder = std::async(std::launch::async, [this]
+        {
+            buildVariants();
+        });
+    }
+
+    void VulkanPipeline::buildVariants()
+    {
+        while (true)
+        {
+            auto variant = ShaderVariant{};
+            {
+                auto lock = std::lock_guard{ variantMutex };
+                if (isStopping or queuedVariants.empty())
+                {
+                    isBuilding = false;
+                    return;
+                }
+                variant = std::move(queuedVariants.front());
+                queuedVariants.pop_front();
+            }
+
+            const auto variantPipeline = createVariant(variant);
+
+            // Selecting the variant in flight queues it again, the second build is dropped
+            auto lock = std::lock_guard{ variantMutex };
+            if (not variants.emplace(std::move(variant), BuiltVariant{ variantPipeline, requestFrame }).second)
+            {
+                vkDestroyPipeline(DeviceInstance.getDevice(), variantPipeline, nullptr);
+            }
+        }
+    }
+
+    VkPipeline VulkanPipeline::createVariant(const ShaderVariant& variant)
+    {
+        auto& shader = shaders[variant.defines];
+        if (nullptr == shader)
+        {
+            shader = makeLocal<Shader>(shaderPath, variant.defines);
+        }
+
+        auto mapEntries = std::vector<VkSpecializationMapEntry>(variant.constants.size());
+        for (uint32_t constantId = 0u; constantId < mapEntries.size(); constantId++)
+        {
+            mapEntries[constantId].constantID = constantId;
+            mapEntries[constantId].offset = constantId * sizeof(uint32_t);
+            mapEntries[constantId].size = sizeof(uint32_t);
+        }
+
+        auto specialization = VkSpecializationInfo{};
+        specialization.mapEntryCount = mapEntries.size();
+        specialization.pMapEntries = mapEntries.data();
+        specialization.dataSize = variant.constants.size() * sizeof(uint32_t);
+        specialization.pData = variant.constants.data();
+        const auto* specializationInfo = variant.constants.empty() ? nullptr : &specialization;
+
+        auto pipelineConfigInfo = ConfigInfo::defaultConfig();
+        pipelineConfigInfo.pipelineLayout = pipelineLayout;
+
+        RT_LOG_INFO("Creating Pipeline: {{ mode = {}, defines = {}, constants = {} }}",
+            shader->isCompute() ? "compute" : "graphics",
+            variant.defines.size(),
+            variant.constants.size());
+        const auto variantPipeline = shader->isCompute() ?
+            createComputePipeline(pipelineConfigInfo, *shader, specializationInfo) :
+            createGraphicsPipeline(pipelineConfigInfo, *shader, specializationInfo, attachmentFormats);
+        RT_LOG_INFO("Pipeline created");
+        return variantPipeline;
+    }
+
+    VkPipeline VulkanPipeline::createComputePipeline(ConfigInfo& configInfo, const Shader& shader, const VkSpecializationInfo* specialization) const
     {
         auto shaderStages = shader.getStages();
 
         auto pipelineInfo = VkComputePipelineCreateInfo{};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
         pipelineInfo.stage = shaderStages[0];
+        pipelineInfo.stage.pSpecializationInfo = specialization;
 
         pipelineInfo.layout = configInfo.pipelineLayout;
 
         pipelineInfo.basePipelineIndex = -1;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
+        auto computePipeline = VkPipeline{};
         CHECK_VK(
             vkCreateComputePipelines(
                 DeviceInstance.getDevice(),
-                VK_NULL_HANDLE,
+                DeviceInstance.getPipelineCache(),
                 1,
                 &pipelineInfo,
                 nullptr,
-                &pipeline),
+                &computePipeline),
             "failed to create graphics pipeline");
+        return computePipeline;
     }
 
-    void VulkanPipeline::createGraphicsPipeline(
+    VkPipeline VulkanPipeline::createGraphicsPipeline(
         ConfigInfo& configInfo,
         const Shader& shader,
-        const AttachmentFormats& formats)
+        const VkSpecializationInfo* specialization,
+        const AttachmentFormats& formats) const
     {
         auto renderPass = VulkanRenderPass(formats);
         configInfo.renderPass = renderPass.getRenderPass();
 
         auto shaderStages = shader.getStages();
+        for (auto& stage : shaderStages)
+        {
+            stage.pSpecializationInfo = specialization;
+        }
 
         auto attriDesc = Vertex::getAttributeDescriptions();
         auto bindDesc = Vertex::getBindingDescriptions();
@@ -260,15 +454,17 @@ namespace RT::Vulkan
         pipelineInfo.basePipelineIndex = -1;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
+        auto graphicsPipeline = VkPipeline{};
         CHECK_VK(
             vkCreateGraphicsPipelines(
                 DeviceInstance.getDevice(),
-                VK_NULL_HANDLE,
+                DeviceInstance.getPipelineCache(),
                 1,
                 &pipelineInfo,
                 nullptr,
-                &pipeline),
+                &graphicsPipeline),
             "failed to create graphics pipeline");
+        return graphicsPipeline;
     }
 
 }
@@ -1,6 +1,10 @@
 #pragma once
 #include <vulkan/vulkan.h>
 
+#include <deque>
+#include <future>
+#include <map>
+#include <mutex>
 #include <vector>
 
 #include "Engine/Render/Pipeline.h"
@@ -34,6 +38,12 @@ namespace RT::Vulkan
             static ConfigInfo defaultConfig();
         };
 
+        struct BuiltVariant
+        {
+            VkPipeline pipeline = {};
+            uint64_t lastFrame = 0u;	// frame it was last bound in, or asked for if it was never bound
+        };
+
     public:
         VulkanPipeline(PipelineSpec& spec);
         ~VulkanPipeline() final;
@@ -50,28 +60,55 @@ namespace RT::Vulkan
 
         void bind() const final;
         void dispatch(const glm::uvec2 groups) const final;
-        
+
+        void selectVariant(const ShaderVariant& variant) final;
+        void prepareVariants(const std::vector<ShaderVariant>& upcoming) final;
+
     private:
         template <VkPipelineBindPoint PipelinePoint>
         void bindDescriptors() const;
+        VkPipeline selectedPipeline() const;
+        void bindVariant(const ShaderVariant& variant, const VkPipeline variantPipeline) const;
+        void evictVariants() const;
 
         void createPipelineLayout();
+        void startBuilder();
+        void buildVariants();
+        VkPipeline createVariant(const ShaderVariant& variant);
 
-        void createComputePipeline(ConfigInfo& configInfo, const Shader& shader);
-        void createGraphicsPipeline(
+        VkPipeline createComputePipeline(ConfigInfo& configInfo, const Shader& shader, const VkSpecializationInfo* specialization) const;
+        VkPipeline createGraphicsPipeline(
             ConfigInfo& configInfo,
             const Shader& shader,
-            const AttachmentFormats& formats);
+            const VkSpecializationInfo* specialization,
+            const AttachmentFormats& formats) const;
 
     private:
-        VkPipeline pipeline = {};
+        mutable VkPipeline pipeline = {};	// the selected variant once it is built, the previous one until then
+        mutable ShaderVariant bound = {};	// the variant pipeline was built from
+        mutable bool isSelectedBuilt = true;
+        ShaderVariant selected = {};
         VkPipelineLayout pipelineLayout = {};
 
         UniformLayouts layouts = {};
         Descriptors descriptors;
         mutable std::vector<VkDescriptorSet> bindingSets = {};
 
+        std::filesystem::path shaderPath = {};
+        AttachmentFormats attachmentFormats = {};
+        std::map<ShaderDefines, Local<Shader>> shaders = {};	// variants differing only in constants share a module, owned by the builder
+
+        // Variants are built one at a time on the builder thread, the map and the queue are shared with it
+        mutable std::mutex variantMutex = {};
+        mutable std::map<ShaderVariant, BuiltVariant> variants = {};
+        std::deque<ShaderVariant> queuedVariants = {};
+        uint64_t requestFrame = 0u;
+        std::future<void> builder = {};
+        bool isBuilding = false;
+        bool isStopping = false;
+
         static constexpr glm::uvec2 group = { 8u, 8u };
+        static constexpr uint32_t maxVariantCnt = 16u;
     };
 
 }
@@ -2,6 +2,7 @@
 #include "utils/Debug.h"
 #include "Context.h"
 #include "Device.h"
+#include "GpuProfiler.h"
 #include "Swapchain.h"
 #include "VulkanBuffer.h"
 
@@ -28,6 +29,7 @@ namespace RT::Vulkan
 		extent = VkExtent2D{ (uint32_t)size.x, (uint32_t)size.y };
 
 		DeviceInstance.init();
+		GpuProfilerInstance.init();
 		recreateSwapchain();
 		
 		initImGui();
@@ -58,6 +60,7 @@ namespace RT::Vulkan
 		freeCmdBuffers(imGuiCmdBuffers);
 		
 		SwapchainInstance->shutdown();
+		GpuProfilerInstance.shutdown();
 		deviceInstance.shutdown();
 	}
 
@@ -71,7 +74,9 @@ namespace RT::Vulkan
 		uint32_t imgIdx = 0u;
 		auto result = SwapchainInstance->acquireNextImage(imgIdx);
 
+		// Uniform writes of the last frame are flushed here, sampling after them keeps one frame's bytes together
 		flushUniforms();
+		frameUploadSize = std::exchange(getUploadedSize(), 0u);
 
 		// Probably not needed as it is handled by WindowResize event callback, but keept for safty
 		if (VK_ERROR_OUT_OF_DATE_KHR == result)
@@ -84,15 +89,20 @@ namespace RT::Vulkan
 
 		Context::imgIdx = imgIdx;
 		Context::frameCmd = cmdBuffers[imgIdx];
+		Context::frameNr++;
 
 		auto beginInfo = VkCommandBufferBeginInfo{};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 		vkResetCommandBuffer(Context::frameCmd, 0);
 		CHECK_VK(vkBeginCommandBuffer(Context::frameCmd, &beginInfo), "failed to begin command buffer!");
+
+		GpuProfilerInstance.beginFrame(Context::frameCmd, SwapchainInstance->getCurrentFrame());
+		frameScope = GpuProfilerInstance.beginScope(Context::frameCmd, "Frame");
 	}
 
 	void VulkanRenderApi::endFrame()
 	{
+		GpuProfilerInstance.endScope(Context::frameCmd, frameScope);
 		CHECK_VK(vkEndCommandBuffer(Context::frameCmd), "failed to record command buffer");
 
 		recordGuiCommandbuffer(Context::imgIdx);
@@ -112,6 +122,24 @@ namespace RT::Vulkan
 		Context::frameCmd = VK_NULL_HANDLE;
 	}
 
+	MemoryStats VulkanRenderApi::getMemoryStats() const
+	{
+		const auto arenaStats = DeviceInstance.getMemoryStats();
+		auto stats = MemoryStats{};
+		stats.blockCnt = arenaStats.blockCnt;
+		stats.allocationCnt = arenaStats.allocationCnt;
+		stats.reservedSize = arenaStats.reservedSize;
+		stats.usedSize = arenaStats.usedSize;
+		stats.fragmentation = arenaStats.fragmentation();
+		stats.frameUploadSize = frameUploadSize;
+		return stats;
+	}
+
+	std::span<const GpuScope> VulkanRenderApi::getGpuScopes() const
+	{
+		return GpuProfilerInstance.getScopes();
+	}
+
 	void VulkanRenderApi::recreateSwapchain()
 	{
 		auto size = Application::getWindow()->getSize();
@@ -169,6 +197,7 @@ namespace RT::Vulkan
 		renderPassInfo.clearValueCount = clearValues.size();
 		renderPassInfo.pClearValues = clearValues.data();
 
+		const uint32_t guiScope = GpuProfilerInstance.beginScope(currCmdBuff, "ImGui");
 		vkCmdBeginRenderPass(currCmdBuff, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 		auto viewport = VkViewport{};
@@ -188,6 +217,7 @@ namespace RT::Vulkan
 		ImGui_ImplVulkan_RenderDrawData(drawData, currCmdBuff);
 
 		vkCmdEndRenderPass(currCmdBuff);
+		GpuProfilerInstance.endScope(currCmdBuff, guiScope);
 
 		CHECK_VK(vkEndCommandBuffer(currCmdBuff), "failed to record command buffer");
 	}
@@ -231,7 +261,7 @@ namespace RT::Vulkan
 		vkInfo.Device = device.getDevice();
 		vkInfo.QueueFamily = device.getQueueFamilyIndices().graphicsFamily;
 		vkInfo.Queue = device.getGraphicsQueue();
-		vkInfo.PipelineCache = pipelineCache;
+		vkInfo.PipelineCache = device.getPipelineCache();
 		vkInfo.DescriptorPool = descriptorPool;
 		vkInfo.RenderPass = SwapchainInstance->getRenderPass();
 		vkInfo.Subpass = 0;
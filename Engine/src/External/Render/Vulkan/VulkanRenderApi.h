@@ -28,6 +28,9 @@ namespace RT::Vulkan
 		void beginFrame() final;
 		void endFrame() final;
 
+		MemoryStats getMemoryStats() const final;
+		std::span<const GpuScope> getGpuScopes() const final;
+
 		void recreateSwapchain();
 
 	private:
@@ -44,8 +47,9 @@ namespace RT::Vulkan
 		std::vector<VkCommandBuffer> imGuiCmdBuffers = {};
 		
 		VkExtent2D extent = {};
+		uint64_t frameUploadSize = 0u;
+		uint32_t frameScope = 0u;
 
-		VkPipelineCache pipelineCache = {};
 		VkDescriptorPool descriptorPool = {};
 	};
 
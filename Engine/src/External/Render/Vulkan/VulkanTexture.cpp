@@ -5,6 +5,7 @@
 
 #include "utils/Debug.h"
 #include "Device.h"
+#include "GpuProfiler.h"
 #include "Swapchain.h"
 #include "utils/Utils.h"
 
@@ -61,9 +62,9 @@ namespace RT::Vulkan
 		vkDestroySampler(device, sampler, nullptr);
 		vkDestroyImageView(device, imageView, nullptr);
 		vkDestroyImage(device, image, nullptr);
-		vkFreeMemory(device, memory, nullptr);
+		DeviceInstance.freeMemory(memory);
 		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
+		DeviceInstance.freeMemory(stagingBufferMemory);
 	}
 
 	void VulkanTexture::setBuffer(const void* data)
@@ -93,7 +94,9 @@ namespace RT::Vulkan
 		auto dstAccessMask = imageAccess2VulkanAccess(imageAccess);
 		auto newLayout = imageLayout2VulkanLayout(imageLayout);
 
+		const uint32_t scope = GpuProfilerInstance.beginScope(Context::frameCmd, "Barrier");
 		vulkanBarrier(Context::frameCmd, dstAccessMask, newLayout);
+		GpuProfilerInstance.endScope(Context::frameCmd, scope);
 
 		currAccessMask = dstAccessMask;
 		currLayout = newLayout;
@@ -247,57 +250,22 @@ namespace RT::Vulkan
 
 	void VulkanTexture::allocateMemory()
 	{
-		auto device = DeviceInstance.getDevice();
-
 		auto memReq = VkMemoryRequirements{};
-		vkGetImageMemoryRequirements(device, image, &memReq);
-
-		auto allocInfo = VkMemoryAllocateInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memReq.size;
-		allocInfo.memoryTypeIndex = DeviceInstance.findMemoryType(
-			memReq.memoryTypeBits,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		vkGetImageMemoryRequirements(DeviceInstance.getDevice(), image, &memReq);
 
-		CHECK_VK(
-			vkAllocateMemory(device, &allocInfo, nullptr, &memory),
-			"failed to allocate image memory!");
-		CHECK_VK(
-			vkBindImageMemory(device, image, memory, 0),
-			"failed to bind image memory!");
+		DeviceInstance.bindImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memory);
 
 		imSize = memReq.size;
 	}
 
 	void VulkanTexture::allocateStaginBuffer()
 	{
-		auto device = DeviceInstance.getDevice();
-
-		auto bufferInfo = VkBufferCreateInfo{};
-		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferInfo.size = imSize;
-		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		CHECK_VK(
-			vkCreateBuffer(device, &bufferInfo, nullptr, &stagingBuffer),
-			"failed to create staging buffer!");
-
-		auto memReq = VkMemoryRequirements{};
-		vkGetBufferMemoryRequirements(device, stagingBuffer, &memReq);
-
-		auto allocInfo = VkMemoryAllocateInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memReq.size;
-		allocInfo.memoryTypeIndex = DeviceInstance.findMemoryType(
-			memReq.memoryTypeBits,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-		CHECK_VK(
-			vkAllocateMemory(device, &allocInfo, nullptr, &stagingBufferMemory),
-			"failed to allocate image memory!");
-		CHECK_VK(
-			vkBindBufferMemory(device, stagingBuffer, stagingBufferMemory, 0),
-			"failed to bind image memory!");
+		DeviceInstance.createBuffer(
+			imSize,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			stagingBuffer,
+			stagingBufferMemory);
 	}
 
 	void VulkanTexture::createImageView()
@@ -352,20 +320,14 @@ namespace RT::Vulkan
 
 	void VulkanTexture::uploadToBuffer(const void* data)
 	{
-		auto device = DeviceInstance.getDevice();
-
-		void* dstData = nullptr;
-		vkMapMemory(device, stagingBufferMemory, 0, imSize, 0, &dstData);
-
-		std::memcpy(dstData, data, imSize);
+		std::memcpy(stagingBufferMemory.mapped, data, imSize);
 
 		auto range = VkMappedMemoryRange{};
 		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		range.memory = stagingBufferMemory;
-		range.size = imSize;
-		vkFlushMappedMemoryRanges(device, 1, &range);
-
-		vkUnmapMemory(device, stagingBufferMemory);
+		range.memory = stagingBufferMemory.memory;
+		range.offset = stagingBufferMemory.offset;
+		range.size = stagingBufferMemory.size;
+		vkFlushMappedMemoryRanges(DeviceInstance.getDevice(), 1, &range);
 	}
 
 	void VulkanTexture::copyToImage()
@@ -1,6 +1,8 @@
 #pragma once
 #include "Engine/Render/Texture.h"
 
+#include "MemoryArena.h"
+
 #include <vulkan/vulkan.h>
 
 namespace RT::Vulkan
@@ -58,12 +60,12 @@ namespace RT::Vulkan
 
 		VkImage image = {};
 		VkImageView imageView = {};
-		VkDeviceMemory memory = {};
+		MemoryAllocation memory = {};
 		VkSampler sampler = {};
 
 		// TODO: will be needed when writing to image memory
 		VkBuffer stagingBuffer = {};
-		VkDeviceMemory stagingBufferMemory = {};
+		MemoryAllocation stagingBufferMemory = {};
 
 		VkDescriptorImageInfo imageInfo = {};
 		VkDescriptorSet descriptorSet = {};
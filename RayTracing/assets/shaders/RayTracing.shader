@@ -9,18 +9,30 @@
 #define PI 3.141592653589793
 #define FLT_EPS 1.192092896e-07F
 #define DBL_EPS 2.2204460492503131e-016
+#define BVH_WIDTH 4u
+#define SPHERE_FLAG 0x80000000u
+
+// BVH::binaryStackDepth and BVH::wideStackDepth, defined by the client so both sides derive them from BVH::maxDepth
+#if !defined(BINARY_STACK_DEPTH) || !defined(WIDE_STACK_DEPTH)
+#error BINARY_STACK_DEPTH and WIDE_STACK_DEPTH have to be defined
+#endif
 
 layout (local_size_x = 8, local_size_y = 8, local_size_y = 1) in;
 
+// Selected per pipeline variant, so the trace loops get constant bounds and dead settings fold away
+layout (constant_id = 0) const uint BOUNCE_LIMIT = 1u;
+layout (constant_id = 1) const uint FRAME_LIMIT = 1u;
+layout (constant_id = 2) const bool DRAW_ENVIRONMENT = false;
+
 layout(set = 0, binding = 0, rgba32f) uniform image2D AccumulationTexture;
 layout(set = 0, binding = 1, rgba8) uniform image2D OutTexture;
 layout(set = 0, binding = 2) uniform sampler2D SkyMap;
 
 layout(std140, set = 0, binding = 3) uniform Amounts
 {
-    float DrawEnvironment;
-    uint MaxBounces;
-    uint MaxFrames;
+    float DrawEnvironment;  // superseded by DRAW_ENVIRONMENT, kept for the layout
+    uint MaxBounces;        // superseded by BOUNCE_LIMIT, kept for the layout
+    uint MaxFrames;         // superseded by FRAME_LIMIT, kept for the layout
     uint FrameIndex;
     vec2 Resolution;
     int MaterialsCount;
@@ -65,20 +77,22 @@ struct Box
     uvec2 bufferRegion;
 };
 
-struct Triangle
+struct WideNode
 {
-    vec3 A;
-    vec3 B;
-    vec3 C;
-    vec2 uvA;
-    vec2 uvB;
-    vec2 uvC;
+    vec3 origin;
+    uint scale;
+    uint bounds[6];
+    uint children[4];
+    uint counts[2];
 };
 
 struct Mesh
 {
     uint BVHRoot;
     uint ModelRoot;
+    int MaterialId;
+    uint BoxesRoot;
+    uint VertexRoot;
 };
 
 struct MeshInstance
@@ -98,14 +112,15 @@ layout(std140, set = 1, binding = 1) readonly buffer SpheresBuffer
     Sphere Spheres[];
 };
 
-layout(std140, set = 1, binding = 2) readonly buffer BoxBuffer
+layout(std430, set = 1, binding = 2) readonly buffer NodeBuffer
 {
-    Box Boxes[];
+    WideNode Nodes[];
 };
 
-layout(std140, set = 1, binding = 3) readonly buffer TriangleBuffer
+// Three vertex indices per triangle, relative to the VertexRoot of its mesh
+layout(std430, set = 1, binding = 3) readonly buffer TriangleBuffer
 {
-    Triangle Triangles[];
+    uint TriangleIndices[];
 };
 
 layout(std140, set = 1, binding = 4) readonly buffer MeshBuffer
@@ -120,6 +135,33 @@ layout(std140, set = 1, binding = 5) readonly buffer MeshInstanceBuffer
 
 layout(set = 1, binding = 6) uniform sampler2D Textures[];
 
+layout(std140, set = 1, binding = 7) readonly buffer InstanceBoxBuffer
+{
+    Box InstanceBoxes[];
+};
+
+layout(std430, set = 1, binding = 8) readonly buffer InstanceIndexBuffer
+{
+    uint InstanceIndices[];
+};
+
+// Positions only, the intersection loop never touches uvs
+layout(std430, set = 1, binding = 9) readonly buffer VertexPositionBuffer
+{
+    vec4 VertexPositions[];
+};
+
+layout(std430, set = 1, binding = 10) readonly buffer VertexUVBuffer
+{
+    vec2 VertexUVs[];
+};
+
+uvec3 triangleVertices(in uint triangleId, in uint vertexRoot)
+{
+    uint first = 3u * triangleId;
+    return vertexRoot + uvec3(TriangleIndices[first], TriangleIndices[first + 1u], TriangleIndices[first + 2u]);
+}
+
 uint PCGhash(in uint random)
 {
     uint state = random * 747796405u + 2891336453u;
@@ -249,12 +291,14 @@ Payload closestHit(in Ray ray, in float closestDistance, in int closestObject, i
     {
         MeshInstance object = MeshInstances[closestInstance];
 
-        vec3 edgeAB = Triangles[closestObject].B - Triangles[closestObject].A;
-        vec3 edgeAC = Triangles[closestObject].C - Triangles[closestObject].A;
+        uvec3 vertices = triangleVertices(uint(closestObject), Meshes[object.MeshId].VertexRoot);
+        vec3 A = VertexPositions[vertices.x].xyz;
+        vec3 edgeAB = VertexPositions[vertices.y].xyz - A;
+        vec3 edgeAC = VertexPositions[vertices.z].xyz - A;
         vec3 normalVec = cross(edgeAB, edgeAC);
         payload.HitNormal = normalize(inverse(object.worldToLocalMatrix) * vec4(normalVec, 0.0)).xyz;
 
-        vec3 ao = ray.Origin - Triangles[closestObject].A;
+        vec3 ao = ray.Origin - A;
         vec3 dao = cross(ao, ray.Direction);
         float determinant = -dot(ray.Direction, normalVec);
         float invDet = 1 / determinant;
@@ -263,30 +307,23 @@ Payload closestHit(in Ray ray, in float closestDistance, in int closestObject, i
         float w = 1 - u - v;
         
         vec2 texUV =
-            Triangles[payload.HitObject].uvA * w +
-            Triangles[payload.HitObject].uvB * u +
-            Triangles[payload.HitObject].uvC * v;
+            VertexUVs[vertices.x] * w +
+            VertexUVs[vertices.y] * u +
+            VertexUVs[vertices.z] * v;
 
         payload.HitUV = texUV;
 
         payload.HitMaterial = object.MaterialId;
-
-        //////////////// DEL
-        // if (closestObject == 0)
-        // {
-        //     payload.HitNormal = normalize(vec3(1.0));
-        // }
-        //////////////// DEL
     }
 
     return payload;
 }
 
-float triangleHit(in Ray ray, in Triangle triangle)
+float triangleHit(in Ray ray, in vec3 A, in vec3 B, in vec3 C)
 {
-    dvec3 edgeAB = dvec3(triangle.B) - dvec3(triangle.A);
-    dvec3 edgeAC = dvec3(triangle.C) - dvec3(triangle.A);
-    dvec3 ao = dvec3(ray.Origin) - dvec3(triangle.A);
+    dvec3 edgeAB = dvec3(B) - dvec3(A);
+    dvec3 edgeAC = dvec3(C) - dvec3(A);
+    dvec3 ao = dvec3(ray.Origin) - dvec3(A);
     dvec3 normalVec = cross(edgeAB, edgeAC);
     dvec3 dao = cross(ao, ray.Direction);
 
@@ -302,6 +339,24 @@ float triangleHit(in Ray ray, in Triangle triangle)
     return didHit ? float(t) : FLT_MAX;
 }
 
+// Boxes reaching the closest hit may still hold a primitive tying it
+bool isInRange(in float boxDistance, in float closestDistance)
+{
+    return boxDistance < closestDistance || (boxDistance == closestDistance && boxDistance < FLT_MAX);
+}
+
+// Ties go to the lower id, so the order a traversal visits primitives in never picks the hit. No hit (-1) loses every tie
+bool isCloser(in float distance, in int id, in float closestDistance, in int closestId)
+{
+    return distance < closestDistance || (distance == closestDistance && distance < FLT_MAX && uint(id) < uint(closestId));
+}
+
+// Instances tie on their id first, spheres carry instance -1
+bool isCloserHit(in float distance, in int instance, in int object, in float closestDistance, in int closestInstance, in int closestObject)
+{
+    return instance == closestInstance ? isCloser(distance, object, closestDistance, closestObject) : isCloser(distance, instance, closestDistance, closestInstance);
+}
+
 float hitBox(in Ray ray, in Box box)
 {
     vec3 lbf = (box.leftBottomFront - ray.Origin) / ray.Direction;
@@ -317,13 +372,40 @@ float hitBox(in Ray ray, in Box box)
     return didHit ? tNear : FLT_MAX;
 }
 
-//////////////// DEL
+vec3 nodeScale(in WideNode node)
+{
+    uvec3 biasedExponent = (uvec3(node.scale) >> uvec3(0u, 8u, 16u)) & 0xFFu;
+    return uintBitsToFloat(biasedExponent << 23u);
+}
+
+Box decodeChild(in WideNode node, in vec3 scale, in uint child)
+{
+    uint shift = 8u * child;
+    uvec3 qMin = (uvec3(node.bounds[0], node.bounds[1], node.bounds[2]) >> shift) & 0xFFu;
+    uvec3 qMax = (uvec3(node.bounds[3], node.bounds[4], node.bounds[5]) >> shift) & 0xFFu;
+
+    Box box;
+    box.leftBottomFront = node.origin + vec3(qMin) * scale;
+    box.rightTopBack = node.origin + vec3(qMax) * scale;
+    box.bufferRegion = uvec2(0u);
+    return box;
+}
+
+Box decodeFrame(in WideNode node)
+{
+    Box box;
+    box.leftBottomFront = node.origin;
+    box.rightTopBack = node.origin + 255.0 * nodeScale(node);
+    box.bufferRegion = uvec2(0u);
+    return box;
+}
+
+#ifdef DEBUG_BVH
 float boxDepth = 0;
-vec3 boxColor = vec3(0.0);
-//////////////// DEL
-HitInfo bvhTraverse(in Ray ray, in uint bvhRoot, in uint modelRoot)
+#endif
+HitInfo bvhTraverse(in Ray ray, in uint bvhRoot, in uint modelRoot, in uint vertexRoot)
 {
-    float didHitVolume = hitBox(ray, Boxes[bvhRoot]);
+    float didHitVolume = hitBox(ray, decodeFrame(Nodes[bvhRoot]));
     if (!(didHitVolume < FLT_MAX))
     {
         HitInfo notHited;
@@ -338,144 +420,78 @@ HitInfo bvhTraverse(in Ray ray, in uint bvhRoot, in uint modelRoot)
     returnInfo.triangleId = -1;
     returnInfo.didHit = false;
 
-    const uint maxDepth = 32u;
+    const uint maxDepth = WIDE_STACK_DEPTH;
     uint stack[maxDepth];
     uint stackIdx = 0u;
 
-    //////////////// DEL
-    // returnInfo.triangleId = 0;
-    // uint depthStack[maxDepth];
-    // uint depthStackIdx = 0u;
-    // depthStack[depthStackIdx++] = 0u;
-    //////////////// DEL
-
-    stack[stackIdx] = bvhRoot;
+    stack[stackIdx] = 0u;
     stackIdx++;
 
     while (stackIdx > 0u)
     {
         stackIdx--;
-        uint boxIdx = stack[stackIdx];
-        Box box = Boxes[boxIdx];
-
-        //////////////// DEL
-        // uint depthNr = depthStack[--depthStackIdx];
-        // if (depthNr == Debug)
-        // {
-        //     float hitDist = hitBox(ray, box);
-        //     returnInfo.distance = hitDist;
-        //     returnInfo.didHit = hitDist < FLT_MAX;
-        //     uint boxIdxCopy = boxIdx;
-        //     boxColor = fastRandom3(boxIdxCopy);
-
-        //     returnInfo.triangleId = 0;
-        //     break;
-        // }
-        //////////////// DEL
+        WideNode node = Nodes[bvhRoot + stack[stackIdx]];
 
-        bool isLeaf = box.bufferRegion.y > 0u;
+        vec3 scale = nodeScale(node);
+        uint childCnt = node.scale >> 24u;
 
-        if (isLeaf)
+#ifdef DEBUG_BVH
+        boxDepth += 1.0;
+#endif
+
+        uint innerIdx[BVH_WIDTH];
+        float innerDist[BVH_WIDTH];
+        uint innerCnt = 0u;
+
+        for (uint child = 0u; child < childCnt; child++)
         {
-            //////////////// DEL
-            // if (boxIdx != Debug - 1)
-            // {
-            //     continue;
-            // }
-            //////////////// DEL
-
-            uvec2 modelBufferRegion = box.bufferRegion + modelRoot;
-            for (uint triangleId = modelBufferRegion.x; triangleId < modelBufferRegion.y; triangleId++)
+            float childDist = hitBox(ray, decodeChild(node, scale, child));
+            if (!isInRange(childDist, returnInfo.distance))
+            {
+                continue;
+            }
+
+            uint triangleCnt = (node.counts[child >> 1u] >> (16u * (child & 1u))) & 0xFFFFu;
+            if (triangleCnt == 0u)
             {
+                // Insertion sort, farthest first, so the nearest child is popped next
+                uint slot = innerCnt;
+                while (slot > 0u && innerDist[slot - 1u] < childDist)
+                {
+                    innerIdx[slot] = innerIdx[slot - 1u];
+                    innerDist[slot] = innerDist[slot - 1u];
+                    slot--;
+                }
+                innerIdx[slot] = node.children[child];
+                innerDist[slot] = childDist;
+                innerCnt++;
+                continue;
+            }
+
+            uint firstTriangle = modelRoot + node.children[child];
+            for (uint triangleId = firstTriangle; triangleId < firstTriangle + triangleCnt; triangleId++)
+            {
+#ifdef DEBUG_BVH
                 boxDepth += 1.0;
+#endif
 
-                float triDist = triangleHit(ray, Triangles[triangleId]);
-                if (triDist < returnInfo.distance)
+                uvec3 vertices = triangleVertices(triangleId, vertexRoot);
+                float triDist = triangleHit(ray, VertexPositions[vertices.x].xyz, VertexPositions[vertices.y].xyz, VertexPositions[vertices.z].xyz);
+                if (isCloser(triDist, int(triangleId), returnInfo.distance, returnInfo.triangleId))
                 {
                     returnInfo.distance = triDist;
                     returnInfo.triangleId = int(triangleId);
                     returnInfo.didHit = true;
-                    
-                    //////////////// DEL
-                    // uint boxIdxCopy = boxIdx;
-                    // boxColor = fastRandom3(boxIdxCopy);
-                    // boxColor = fastRandom3(boxIdxCopy);
-                    // boxColor = fastRandom3(boxIdxCopy);
-                    // boxColor = fastRandom3(boxIdxCopy);
-                    //////////////// DEL
                 }
             }
-
-            //////////////// DEL
-            // float hitDist = hitBox(ray, box);
-            // if (hitDist < returnInfo.distance)
-            // {
-            //     returnInfo.triangleId = 0;
-
-            //     returnInfo.distance = hitDist;
-            //     returnInfo.didHit = hitDist < FLT_MAX;
-            //     uint boxIdxCopy = boxIdx;
-            //     boxColor = fastRandom3(boxIdxCopy);
-            // }
-            //////////////// DEL
         }
-        else
-        {
-            //////////////// DEL
-            // if (boxIdx == Debug - 1)
-            // {
-            //     float hitDist = hitBox(ray, box);
-            //     returnInfo.distance = hitDist;
-            //     returnInfo.didHit = hitDist < FLT_MAX;
-            //     uint boxIdxCopy = boxIdx;
-            //     boxColor = fastRandom3(boxIdxCopy);
-
-            //     returnInfo.triangleId = 0;
-            //     break;
-            // }
-            //////////////// DEL
-
-            uint leftChildIdx = bvhRoot + box.bufferRegion.x + 0u;
-            uint rightChildIdx = bvhRoot + box.bufferRegion.x + 1u;
-            Box leftChild = Boxes[leftChildIdx];
-            Box rightChild = Boxes[rightChildIdx];
-
-            float leftDist = hitBox(ray, leftChild);
-            float rightDist = hitBox(ray, rightChild);
-
-            //////////////// DEL
-            boxDepth += 1.0;
-            // if (leftDist < returnInfo.distance)
-            // {
-            //     stack[stackIdx] = leftChildIdx;
-            //     stackIdx++;
-            // }
-            //////////////// DEL
-            
-            bool isLeftClosest = leftDist < rightDist;
 
-            uint nearIdx = isLeftClosest ? leftChildIdx : rightChildIdx;
-            uint farIdx = isLeftClosest ? rightChildIdx : leftChildIdx;
-            float nearDist = isLeftClosest ? leftDist : rightDist;
-            float farDist = isLeftClosest ? rightDist : leftDist;
-
-            if (farDist < returnInfo.distance)
-            {
-                stack[stackIdx] = farIdx;
-                stackIdx++;
-                
-                //////////////// DEL
-                // depthStack[depthStackIdx++] = depthNr + 1u;
-                //////////////// DEL
-            }
-            if (nearDist < returnInfo.distance)
+        for (uint inner = 0u; inner < innerCnt; inner++)
+        {
+            if (isInRange(innerDist[inner], returnInfo.distance))
             {
-                stack[stackIdx] = nearIdx;
+                stack[stackIdx] = innerIdx[inner];
                 stackIdx++;
-
-                //////////////// DEL
-                // depthStack[depthStackIdx++] = depthNr + 1u;
-                //////////////// DEL
             }
         }
     }
@@ -513,31 +529,85 @@ Payload bounceRay(in Ray ray)
     int closestInstance = -1;
     int closestObject = -1;
     
-    for (int sphereId = 0; sphereId < SpheresCount; sphereId++)
+    // Top level hierarchy over instances and spheres, instance leafs descend into the mesh BVH in its local space
+    const uint maxDepth = BINARY_STACK_DEPTH;
+    uint stack[maxDepth];
+    uint stackIdx = 0u;
+
+    if ((ObjectsCount > 0 || SpheresCount > 0) && isInRange(hitBox(ray, InstanceBoxes[0]), closestDistance))
     {
-        float sphereDist = sphereHit(ray, Spheres[sphereId]);
-        if (sphereDist < closestDistance)
-        {
-            closestDistance = sphereDist;
-            closestObject = sphereId;
-        }
+        stack[stackIdx] = 0u;
+        stackIdx++;
     }
-    
-    for (int objectId = 0; objectId < ObjectsCount; objectId++)
+
+    while (stackIdx > 0u)
     {
-        MeshInstance object = MeshInstances[objectId];
+        stackIdx--;
+        Box box = InstanceBoxes[stack[stackIdx]];
 
-        Ray modelRay;
-        modelRay.Origin = (object.worldToLocalMatrix * vec4(ray.Origin, 1.0)).xyz;
-        modelRay.Direction = (object.worldToLocalMatrix * vec4(ray.Direction, 0.0)).xyz;
+        bool isLeaf = box.bufferRegion.y > 0u;
+
+        if (isLeaf)
+        {
+            for (uint instanceIdx = box.bufferRegion.x; instanceIdx < box.bufferRegion.y; instanceIdx++)
+            {
+                uint entry = InstanceIndices[instanceIdx];
+                if ((entry & SPHERE_FLAG) != 0u)
+                {
+                    int sphereId = int(entry & ~SPHERE_FLAG);
+                    float sphereDist = sphereHit(ray, Spheres[sphereId]);
+                    if (isCloserHit(sphereDist, -1, sphereId, closestDistance, closestInstance, closestObject))
+                    {
+                        closestDistance = sphereDist;
+                        closestInstance = -1;
+                        closestObject = sphereId;
+                    }
+                    continue;
+                }
 
-        HitInfo meshHit = bvhTraverse(modelRay, Meshes[object.MeshId].BVHRoot, Meshes[object.MeshId].ModelRoot);
+                int objectId = int(entry);
+                MeshInstance object = MeshInstances[objectId];
 
-        if (meshHit.didHit && meshHit.distance < closestDistance)
+                Ray modelRay;
+                modelRay.Origin = (object.worldToLocalMatrix * vec4(ray.Origin, 1.0)).xyz;
+                modelRay.Direction = (object.worldToLocalMatrix * vec4(ray.Direction, 0.0)).xyz;
+
+                Mesh mesh = Meshes[object.MeshId];
+                HitInfo meshHit = bvhTraverse(modelRay, mesh.BVHRoot, mesh.ModelRoot, mesh.VertexRoot);
+
+                if (meshHit.didHit && isCloserHit(meshHit.distance, objectId, meshHit.triangleId, closestDistance, closestInstance, closestObject))
+                {
+                    closestDistance = meshHit.distance;
+                    closestInstance = objectId;
+                    closestObject = meshHit.triangleId;
+                }
+            }
+        }
+        else
         {
-            closestDistance = meshHit.distance;
-            closestInstance = objectId;
-            closestObject = meshHit.triangleId;
+            uint leftChildIdx = box.bufferRegion.x + 0u;
+            uint rightChildIdx = box.bufferRegion.x + 1u;
+
+            float leftDist = hitBox(ray, InstanceBoxes[leftChildIdx]);
+            float rightDist = hitBox(ray, InstanceBoxes[rightChildIdx]);
+
+            bool isLeftClosest = leftDist < rightDist;
+
+            uint nearIdx = isLeftClosest ? leftChildIdx : rightChildIdx;
+            uint farIdx = isLeftClosest ? rightChildIdx : leftChildIdx;
+            float nearDist = isLeftClosest ? leftDist : rightDist;
+            float farDist = isLeftClosest ? rightDist : leftDist;
+
+            if (isInRange(farDist, closestDistance))
+            {
+                stack[stackIdx] = farIdx;
+                stackIdx++;
+            }
+            if (isInRange(nearDist, closestDistance))
+            {
+                stack[stackIdx] = nearIdx;
+                stackIdx++;
+            }
         }
     }
     
@@ -549,21 +619,13 @@ Payload bounceRay(in Ray ray)
 
 void accumulateColor(inout Pixel pixel, in Payload payload)
 {
-    //////////////// DEL
-    // if (Debug > 0)
-    // {
-    //     if (boxDepth > float(Debug) pixel.Color = vec3(1.0, 0.0, 0.0);
-    //     else pixel.Color = vec3(boxDepth / float(Debug);
-
-    //     // pixel.Color = Materials[payload.HitMaterial].Albedo;
-    //     // pixel.Color = boxColor * (clamp(dot(payload.HitNormal, vec3(1.0)), 0.0, 1.0) / 2.0 + 0.5); // Base debug
-    //     // pixel.Color = boxColor;
-    //     // pixel.Color = vec3(1.0) * payload.HitDistance * payload.HitDistance; // Depth test
-    //     return;
-    // }
-    //////////////// DEL
-
-    if (MaxBounces == 1)
+#ifdef DEBUG_BVH
+    // Heat map of visited nodes and tested triangles, red past the Debug threshold
+    pixel.Color = boxDepth > float(Debug) ? vec3(1.0, 0.0, 0.0) : vec3(boxDepth / float(max(Debug, 1u)));
+    return;
+#endif
+
+    if (BOUNCE_LIMIT == 1u)
     {
         const vec3 LightDir = normalize(vec3(-1, -1, -1));
         pixel.Color = Materials[payload.HitMaterial].Albedo
@@ -654,7 +716,7 @@ vec3 traceRay(in Ray ray)
     pixel.Color = vec3(0);
     pixel.Contribution = vec3(1);
 
-    for (uint i = 0u; i < MaxBounces; i++)
+    for (uint i = 0u; i < BOUNCE_LIMIT; i++)
     {
         Global.seed += i;
     
@@ -662,7 +724,10 @@ vec3 traceRay(in Ray ray)
     
         if (payload.HitObject == -1)
         {
-            pixel.Color += getSkyColor(ray) * pixel.Contribution * DrawEnvironment;
+            if (DRAW_ENVIRONMENT)
+            {
+                pixel.Color += getSkyColor(ray) * pixel.Contribution;
+            }
             break;
         }
         
@@ -692,7 +757,7 @@ void main()
 
     vec3 incomingLight = vec3(0.0);
 
-    for (uint frame = 1; frame <= MaxFrames; frame++)
+    for (uint frame = 1; frame <= FRAME_LIMIT; frame++)
     {
         Global.seed = uint(index.y * Resolution.x + index.x) + frame * FrameIndex * 735529;
         
@@ -708,7 +773,7 @@ void main()
         incomingLight += traceRay(cameraRay);
     }
     
-    incomingLight = incomingLight / float(MaxFrames);
+    incomingLight = incomingLight / float(FRAME_LIMIT);
     if (FrameIndex != 1)
     {
         incomingLight += imageLoad(AccumulationTexture, index).rgb;
@@ -1,9 +1,18 @@
 #include "BVH.h"
 
 #include <array>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#include <immintrin.h>
 
 #include "Engine/Core/Time.h"
 #include "Engine/Core/Log.h"
+#include "Engine/Core/Assert.h"
+#include "Engine/Core/ThreadPool.h"
 
 namespace
 {
@@ -44,27 +53,323 @@ namespace
 		return halfArea; // *2.0f;
 	}
 
+	BoundingBox toBox(const __m128 vMin, const __m128 vMax)
+	{
+		alignas(16) float minLanes[4];
+		alignas(16) float maxLanes[4];
+		_mm_store_ps(minLanes, vMin);
+		_mm_store_ps(maxLanes, vMax);
+
+		auto box = BoundingBox{};
+		box.vMin = glm::vec3{ minLanes[0], minLanes[1], minLanes[2] };
+		box.vMax = glm::vec3{ maxLanes[0], maxLanes[1], maxLanes[2] };
+		return box;
+	}
+
+	BoundingBox unite(BoundingBox box, const Node& node)
+	{
+		extendBox(box, node);
+		return box;
+	}
+
+	BoundingBox overlap(const BoundingBox& left, const BoundingBox& right)
+	{
+		auto box = left;
+		box.vMin = glm::max(left.vMin, right.vMin);
+		box.vMax = glm::min(left.vMax, right.vMax);
+		return box;
+	}
+
+	// Sweeps the planes between buckets, left counts come from the first span and right counts from the second
+	std::pair<float, uint32_t> findBestPlane(const std::span<const Bucket> leftBuckets, const std::span<const Bucket> rightBuckets)
+	{
+		const uint32_t planeCnt = leftBuckets.size() - 1u;
+		auto leftStat = std::array<BucketStat, BVH::maxBinCount - 1u>{};
+		auto rightStat = std::array<BucketStat, BVH::maxBinCount - 1u>{};
+		auto leftBox = Bucket{ leftBuckets.front().bounds, 0u };
+		auto rightBox = Bucket{ rightBuckets.back().bounds, 0u };
+		for (uint32_t li = 0u; li < planeCnt; li++)
+		{
+			leftBox.cnt += leftBuckets[li].cnt;
+			leftStat[li].sumCnt = leftBox.cnt;
+			growBox(leftBox.bounds, leftBuckets[li].bounds);
+			leftStat[li].area = area(leftBox.bounds);
+
+			auto ri = planeCnt - li;
+			rightBox.cnt += rightBuckets[ri].cnt;
+			rightStat[ri - 1u].sumCnt = rightBox.cnt;
+			growBox(rightBox.bounds, rightBuckets[ri].bounds);
+			rightStat[ri - 1u].area = area(rightBox.bounds);
+		}
+
+		auto bestPlane = std::pair{ std::numeric_limits<float>::max(), 0u };
+		for (uint32_t i = 0u; i < planeCnt; i++)
+		{
+			if (0u == leftStat[i].sumCnt or 0u == rightStat[i].sumCnt)
+			{
+				continue;
+			}
+
+			float planeCost = leftStat[i].sumCnt * leftStat[i].area + rightStat[i].sumCnt * rightStat[i].area;
+			if (planeCost < bestPlane.first)
+			{
+				bestPlane = { planeCost, i };
+			}
+		}
+		return bestPlane;
+	}
+
+	uint32_t quantizeExponent(const float extent)
+	{
+		// Smallest power of two step that spans the extent in 255 steps, biased like a float exponent
+		int32_t exponent = -126;
+		if (extent > 0.0f)
+		{
+			std::frexp(extent / 255.0f, &exponent);
+		}
+		return glm::clamp(exponent, -126, 127) + 127;
+	}
+
+	float exponentScale(const uint32_t biasedExponent)
+	{
+		return std::bit_cast<float>(biasedExponent << 23u);
+	}
+
+	uint8_t quantizeMin(const float value, const float origin, const float scale)
+	{
+		auto q = (int32_t)glm::clamp(std::floor((value - origin) / scale), 0.0f, 255.0f);
+		while (q > 0 and origin + q * scale > value)
+		{
+			q--;
+		}
+		return q;
+	}
+
+	uint8_t quantizeMax(const float value, const float origin, const float scale)
+	{
+		auto q = (int32_t)glm::clamp(std::ceil((value - origin) / scale), 0.0f, 255.0f);
+		while (q < 255 and origin + q * scale < value)
+		{
+			q++;
+		}
+		return q;
+	}
+
+	uint32_t expandBits10(uint32_t v)
+	{
+		v = (v * 0x00010001u) & 0xFF0000FFu;
+		v = (v * 0x00000101u) & 0x0F00F00Fu;
+		v = (v * 0x00000011u) & 0xC30C30C3u;
+		v = (v * 0x00000005u) & 0x49249249u;
+		return v;
+	}
+
+	uint64_t expandBits21(uint64_t v)
+	{
+		v &= 0x1FFFFFull;
+		v = (v | v << 32u) & 0x1F00000000FFFFull;
+		v = (v | v << 16u) & 0x1F0000FF0000FFull;
+		v = (v | v << 8u) & 0x100F00F00F00F00Full;
+		v = (v | v << 4u) & 0x10C30C30C30C30C3ull;
+		v = (v | v << 2u) & 0x1249249249249249ull;
+		return v;
+	}
+
+	uint32_t chunkCount(const glm::uvec2 bufferRegion, const uint32_t chunkSize)
+	{
+		return (bufferRegion.y - bufferRegion.x + chunkSize - 1u) / chunkSize;
+	}
+
+	template <typename ChunkFunc>
+	void forEachChunk(const glm::uvec2 bufferRegion, const uint32_t chunkSize, ChunkFunc&& chunkFunc, float& workTime)
+	{
+		const uint32_t chunkCnt = chunkCount(bufferRegion, chunkSize);
+		auto chunkTimes = std::vector<float>(chunkCnt, 0.0f);
+
+		RT::ThreadPool::get().parallelFor(0u, chunkCnt, 1u, [&](const uint32_t chunk)
+		{
+			auto chunkTimer = RT::Timer{};
+
+			const uint32_t first = bufferRegion.x + chunk * chunkSize;
+			const uint32_t last = glm::min(bufferRegion.y, first + chunkSize);
+			chunkFunc(chunk, glm::uvec2{ first, last });
+
+			chunkTimes[chunk] = chunkTimer.Ellapsed();
+		});
+
+		for (const auto chunkTime : chunkTimes)
+		{
+			workTime += chunkTime;
+		}
+	}
+
+	// Partial results are merged in chunk order, so the outcome does not depend on scheduling
+	template <typename ChunkFunc, typename MergeFunc>
+	decltype(auto) reduceChunks(const glm::uvec2 bufferRegion, const uint32_t chunkSize, ChunkFunc&& chunkFunc, MergeFunc&& mergeFunc, float* workTime)
+	{
+		if (nullptr == workTime or bufferRegion.y - bufferRegion.x <= chunkSize)
+		{
+			auto chunkTimer = RT::Timer{};
+			auto result = chunkFunc(bufferRegion);
+			if (nullptr != workTime)
+			{
+				*workTime += chunkTimer.Ellapsed();
+			}
+			return result;
+		}
+
+		auto partials = std::vector<decltype(chunkFunc(bufferRegion))>(chunkCount(bufferRegion, chunkSize));
+		forEachChunk(bufferRegion, chunkSize, [&](const uint32_t chunk, const glm::uvec2 chunkRegion)
+		{
+			partials[chunk] = chunkFunc(chunkRegion);
+		}, *workTime);
+
+		auto result = partials.front();
+		for (uint32_t chunk = 1u; chunk < partials.size(); chunk++)
+		{
+			mergeFunc(result, partials[chunk]);
+		}
+		return result;
+	}
+
 }
 
-BVH::BVH(const RT::Mesh& mesh)
-	: mesh{mesh}
+// Per axis buckets kept in SIMD registers, so extending one costs a single min and max
+struct BVH::AxisBins
 {
-	auto buildTimer = RT::Timer{};
+	struct alignas(16) SimdBucket
+	{
+		__m128 vMin;
+		__m128 vMax;
+		uint32_t cnt;
+	};
 
-	buildNodes();
-	construct();
+	std::array<std::array<SimdBucket, maxBinCount>, 3u> buckets;
+	uint32_t binCount = 0u;
 
-	stats.buildTime = buildTimer.Ellapsed();
+	AxisBins() = default;
+	AxisBins(const uint32_t binCount)
+		: binCount{binCount}
+	{
+		const auto empty = SimdBucket{ _mm_set1_ps(std::numeric_limits<float>::max()), _mm_set1_ps(std::numeric_limits<float>::lowest()), 0u };
+		for (auto& axisBuckets : buckets)
+		{
+			std::fill_n(axisBuckets.begin(), binCount, empty);
+		}
+	}
 
-	LOG_DEBUG("Mesh BVH build:");
-	stats.print();
+	void extend(const uint8_t axis, const uint32_t bin, const __m128 vMin, const __m128 vMax)
+	{
+		auto& bucket = buckets[axis][bin];
+		bucket.vMin = _mm_min_ps(bucket.vMin, vMin);
+		bucket.vMax = _mm_max_ps(bucket.vMax, vMax);
+		bucket.cnt++;
+	}
+
+	void merge(const AxisBins& other)
+	{
+		for (uint8_t axis = 0u; axis < 3u; axis++)
+		{
+			for (uint32_t bin = 0u; bin < binCount; bin++)
+			{
+				auto& bucket = buckets[axis][bin];
+				const auto& partial = other.buckets[axis][bin];
+				bucket.vMin = _mm_min_ps(bucket.vMin, partial.vMin);
+				bucket.vMax = _mm_max_ps(bucket.vMax, partial.vMax);
+				bucket.cnt += partial.cnt;
+			}
+		}
+	}
+
+	Bucket getBucket(const uint8_t axis, const uint32_t bin) const
+	{
+		const auto& bucket = buckets[axis][bin];
+		return Bucket{ toBox(bucket.vMin, bucket.vMax), bucket.cnt };
+	}
+};
+
+BVH::BVH(const RT::Mesh& mesh, const BuildMode mode, const uint32_t binCount)
+	: mesh{&mesh}
+	, isMeshBvh{true}
+	, mode{mode}
+	, binCount{binCount}
+{
+	ASSERT(binCount >= 2u and binCount <= maxBinCount, "SAH bin count has to be in [2, {}]!", maxBinCount);
+	build();
+	this->mesh = nullptr;
+}
+
+BVH::BVH(std::vector<Node> primitives, const BuildMode mode, const uint32_t binCount)
+	: isMeshBvh{false}
+	, mode{mode}
+	, binCount{binCount}
+	, nodes{std::move(primitives)}
+{
+	ASSERT(binCount >= 2u and binCount <= maxBinCount, "SAH bin count has to be in [2, {}]!", maxBinCount);
+	build();
+}
+
+BVH::BVH(const RT::Mesh& mesh, const BuildMode mode, const uint32_t binCount, std::vector<BoundingBox> hierarchy, std::vector<uint32_t> indices, std::vector<WideNode> wideNodes)
+	: mesh{&mesh}
+	, isMeshBvh{true}
+	, mode{mode}
+	, binCount{binCount}
+	, indices{std::move(indices)}
+	, nodes(mesh.getTriangleCount())
+	, hierarchy{std::move(hierarchy)}
+	, wideNodes{std::move(wideNodes)}
+{
+	ASSERT(binCount >= 2u and binCount <= maxBinCount, "SAH bin count has to be in [2, {}]!", maxBinCount);
+
+	// Only the triangle bounds are missing to refit, the restored tree is the built one it degrades from
+	updateNodes();
+	stats.triCnt = nodes.size();
+	stats.refCnt = this->indices.size();
+	stats.nodeCnt = this->hierarchy.size();
+	stats.mode = mode;
+	stats.measureTree(this->hierarchy);
+	builtTreeCost = stats.treeCost;
+	this->mesh = nullptr;
+}
+
+std::optional<glm::uvec2> BVH::refit(const RT::Mesh& mesh)
+{
+	ASSERT(mesh.getTriangleCount() == nodes.size(), "Refit has to keep the number of triangles!");
+
+	this->mesh = &mesh;
+	updateNodes();
+	const auto dirtyRegion = refitHierarchy();
+	this->mesh = nullptr;
+	return dirtyRegion;
 }
 
-std::vector<RT::Triangle> BVH::buildTriangles() const
+std::optional<glm::uvec2> BVH::refit(std::vector<Node> primitives)
 {
-	const auto& triangles = mesh.getModel();
-	auto alignedTriangles = std::vector<RT::Triangle>();
-	alignedTriangles.reserve(nodes.size());
+	ASSERT(primitives.size() == nodes.size(), "Refit has to keep the number of primitives!");
+
+	nodes = std::move(primitives);
+	return refitHierarchy();
+}
+
+BoundingBox BVH::decodeChild(const WideNode& node, const uint8_t child)
+{
+	auto box = emptyBox;
+	for (uint8_t axis = 0u; axis < 3u; axis++)
+	{
+		const float scale = exponentScale((node.scale >> (8u * axis)) & 0xFFu);
+		box.vMin[axis] = node.origin[axis] + ((node.bounds[axis] >> (8u * child)) & 0xFFu) * scale;
+		box.vMax[axis] = node.origin[axis] + ((node.bounds[3u + axis] >> (8u * child)) & 0xFFu) * scale;
+	}
+	return box;
+}
+
+std::vector<glm::uvec3> BVH::buildTriangleIndices(const RT::Mesh& mesh) const
+{
+	ASSERT(isMeshBvh and mesh.getTriangleCount() == nodes.size(), "Only mesh BVH is able to build triangles of its mesh!");
+
+	const auto& triangles = mesh.getModel().indices;
+	auto alignedTriangles = std::vector<glm::uvec3>();
+	alignedTriangles.reserve(indices.size());
 
 	for (const auto& index : indices)
 	{
@@ -74,54 +379,406 @@ std::vector<RT::Triangle> BVH::buildTriangles() const
 	return alignedTriangles;
 }
 
+void BVH::build()
+{
+	auto buildTimer = RT::Timer{};
+
+	buildNodes();
+	if (BuildMode::Linear == mode)
+	{
+		sortByMortonCode();
+	}
+	construct();
+
+	stats.buildTime = buildTimer.Ellapsed();
+	stats.threadCnt = RT::ThreadPool::get().getThreadCount();
+	stats.refCnt = indices.size();
+	stats.mode = mode;
+	stats.measureTree(hierarchy);
+	builtTreeCost = stats.treeCost;
+
+	if (isMeshBvh)
+	{
+		collapse();
+	}
+
+	LOG_DEBUG("{} BVH build:", isMeshBvh ? "Mesh" : "Primitive");
+	stats.print();
+}
+
 void BVH::buildNodes()
 {
-	const auto& triangles = mesh.getModel();
-	indices.reserve(triangles.size());
-	nodes.reserve(triangles.size());
-	uint32_t index = 0u;
-	for (const auto& triangle : triangles)
+	if (isMeshBvh)
 	{
-		indices.push_back(index++);
-	
-		auto& node = nodes.emplace_back();
-		node.vMin = glm::min(glm::min(triangle.A, triangle.B), triangle.C);
-		node.vMax = glm::max(glm::max(triangle.A, triangle.B), triangle.C);
-		node.center = (triangle.A + triangle.B + triangle.C) / 3.0f;
+		nodes.resize(mesh->getTriangleCount());
+		updateNodes();
 	}
 
-	stats.triCnt = triangles.size();
+	indices.resize(nodes.size());
+	std::iota(indices.begin(), indices.end(), 0u);
+	stats.triCnt = nodes.size();
+
+	if (BuildMode::SAH == mode)
+	{
+		lanes.vMin.resize(nodes.size());
+		lanes.vMax.resize(nodes.size());
+		lanes.center.resize(nodes.size());
+		forEachChunk({ 0u, nodes.size() }, parallelChunkSize, [&](const uint32_t /*chunk*/, const glm::uvec2 chunkRegion)
+		{
+			for (uint32_t index = chunkRegion.x; index < chunkRegion.y; index++)
+			{
+				lanes.vMin[index] = glm::vec4{ nodes[index].vMin, 0.0f };
+				lanes.vMax[index] = glm::vec4{ nodes[index].vMax, 0.0f };
+				lanes.center[index] = glm::vec4{ nodes[index].center, 0.0f };
+			}
+		}, stats.workTime);
+	}
 }
 
-void BVH::construct()
+void BVH::updateNodes()
 {
-	const auto& meshVolume = mesh.getVolume();
+	const auto& vertices = mesh->getModel().vertices;
+	const auto& triangles = mesh->getModel().indices;
 
-	auto& rootBoundingBox = hierarchy.emplace_back();
-	rootBoundingBox.vMin = meshVolume.leftBottomFront;
-	rootBoundingBox.vMax = meshVolume.rightTopBack;
-	rootBoundingBox.bufferRegion = glm::uvec3{ 0u };
+	forEachChunk({ 0u, triangles.size() }, parallelChunkSize, [&](const uint32_t /*chunk*/, const glm::uvec2 chunkRegion)
+	{
+		for (uint32_t index = chunkRegion.x; index < chunkRegion.y; index++)
+		{
+			const auto& triangle = triangles[index];
+			const auto& A = vertices[triangle.x].position;
+			const auto& B = vertices[triangle.y].position;
+			const auto& C = vertices[triangle.z].position;
 
-	split(0, { 0, nodes.size() });
+			auto& node = nodes[index];
+			node.vMin = glm::min(glm::min(A, B), C);
+			node.vMax = glm::max(glm::max(A, B), C);
+			node.center = (A + B + C) / 3.0f;
+		}
+	}, stats.workTime);
+}
 
+void BVH::construct()
+{
+	auto rootBoundingBox = emptyBox;
+	if (isMeshBvh)
+	{
+		rootBoundingBox.vMin = mesh->getVolume().leftBottomFront;
+		rootBoundingBox.vMax = mesh->getVolume().rightTopBack;
+	}
+	else
+	{
+		for (const auto& node : nodes)
+		{
+			extendBox(rootBoundingBox, node);
+		}
+	}
+	rootBoundingBox.bufferRegion = glm::uvec2{ 0u };
+
+	auto tree = Subtree{ { rootBoundingBox } };
+	if (BuildMode::Spatial == mode)
+	{
+		buildSpatial(tree);
+	}
+	else
+	{
+		splitSubtree(tree, { 0, nodes.size() }, 0u);
+	}
+
+	hierarchy = std::move(tree.hierarchy);
+	stats.merge(tree.stats);
 	stats.nodeCnt = hierarchy.size();
+
+	mortonCodes = {};
+	lanes = {};
+}
+
+std::optional<glm::uvec2> BVH::refitHierarchy()
+{
+	auto dirtyRegion = glm::uvec2{ hierarchy.size(), 0u };
+
+	// Children are always stored after their parent, so a reversed sweep visits them first
+	for (uint32_t i = hierarchy.size(); i-- > 0u;)
+	{
+		auto& box = hierarchy[i];
+		const auto bufferRegion = box.bufferRegion;
+
+		auto refitted = emptyBox;
+		if (bufferRegion.y > 0u)
+		{
+			for (uint32_t j = bufferRegion.x; j < bufferRegion.y; j++)
+			{
+				extendBox(refitted, nodes[indices[j]]);
+			}
+		}
+		else
+		{
+			growBox(refitted, hierarchy[bufferRegion.x]);
+			growBox(refitted, hierarchy[bufferRegion.x + 1u]);
+		}
+
+		if (box.vMin != refitted.vMin or box.vMax != refitted.vMax)
+		{
+			box.vMin = refitted.vMin;
+			box.vMax = refitted.vMax;
+			dirtyRegion.x = i;
+			dirtyRegion.y = std::max(dirtyRegion.y, i + 1u);
+		}
+	}
+
+	// Refit keeps the topology, once the bounds grow too loose a full rebuild pays off
+	stats.measureTree(hierarchy);
+	if (stats.treeCost > builtTreeCost * rebuildCostRatio)
+	{
+		LOG_DEBUG("BVH refit cost {} exceeds built cost {}, rebuilding", stats.treeCost, builtTreeCost);
+		stats = {};
+		build();
+		return std::nullopt;
+	}
+
+	if (isMeshBvh)
+	{
+		collapse();
+	}
+
+	return dirtyRegion.x < dirtyRegion.y ? dirtyRegion : glm::uvec2{ 0u };
+}
+
+void BVH::collapse()
+{
+	stats.wideNodeCnt = 0u;
+	stats.wideChildCnt = 0u;
+	stats.wideSteps = 0.0f;
+
+	const auto& root = hierarchy.front();
+	const bool isRootLeaf = 1u == hierarchy.size();
+	wideNodes.clear();
+	emitWideNode(root, isRootLeaf ? std::vector<BoundingBox>{ root } : gatherWideSlots(root));
+
+	const float rootArea = area(root);
+	stats.wideSteps = rootArea > 0.0f ? stats.wideSteps / rootArea : 0.0f;
+	stats.wideNodeCnt = wideNodes.size();
+}
+
+bool BVH::verifyWideNodes() const
+{
+	if (not isMeshBvh or wideNodes.empty())
+	{
+		return false;
+	}
+
+	const auto& root = hierarchy.front();
+	return verifyWideNode(0u, 1u == hierarchy.size() ? std::vector<BoundingBox>{ root } : gatherWideSlots(root));
 }
 
-void BVH::split(const uint32_t parentIdx, const glm::uvec2 bufferRegion, const uint8_t depth)
+bool BVH::verifyWideNode(const uint32_t wideIdx, std::vector<BoundingBox> slots) const
+{
+	const auto& node = wideNodes[wideIdx];
+	slots = sortWideSlots(std::move(slots));
+	if (slots.size() != node.scale >> 24u)
+	{
+		return false;
+	}
+
+	for (uint8_t child = 0u; child < slots.size(); child++)
+	{
+		// Bounds are rounded outwards, so they have to enclose the source box and stay within a grid step of it
+		const auto& slot = slots[child];
+		const auto decoded = decodeChild(node, child);
+		for (uint8_t axis = 0u; axis < 3u; axis++)
+		{
+			const float scale = exponentScale((node.scale >> (8u * axis)) & 0xFFu);
+			if (decoded.vMin[axis] > slot.vMin[axis] or decoded.vMax[axis] < slot.vMax[axis]
+				or decoded.vMin[axis] + scale < slot.vMin[axis] or decoded.vMax[axis] - scale > slot.vMax[axis])
+			{
+				return false;
+			}
+		}
+
+		const uint32_t triangleCount = slot.bufferRegion.y - slot.bufferRegion.x;
+		const uint32_t count = (node.counts[child / 2u] >> (16u * (child % 2u))) & 0xFFFFu;
+		if (0u == slot.bufferRegion.y or triangleCount > WideNode::maxLeafSize)
+		{
+			const bool isVerified = 0u == count and node.children[child] > wideIdx and node.children[child] < wideNodes.size()
+				and verifyWideNode(node.children[child], 0u == slot.bufferRegion.y ? gatherWideSlots(slot) : splitWideLeaf(slot));
+			if (not isVerified)
+			{
+				return false;
+			}
+		}
+		else if (node.children[child] != slot.bufferRegion.x or count != triangleCount)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+uint32_t BVH::emitWideNode(const BoundingBox& box, std::vector<BoundingBox> slots)
+{
+	const uint32_t wideIdx = wideNodes.size();
+	wideNodes.emplace_back();
+
+	slots = sortWideSlots(std::move(slots));
+	for (auto& slot : slots)
+	{
+		const uint32_t triangleCount = slot.bufferRegion.y - slot.bufferRegion.x;
+		if (0u == slot.bufferRegion.y)
+		{
+			slot.bufferRegion = glm::uvec2{ emitWideNode(slot, gatherWideSlots(slot)), 0u };
+		}
+		else if (triangleCount > WideNode::maxLeafSize)
+		{
+			slot.bufferRegion = glm::uvec2{ emitWideNode(slot, splitWideLeaf(slot)), 0u };
+		}
+	}
+
+	auto node = WideNode{};
+	node.origin = box.vMin;
+
+	auto scale = glm::vec3{};
+	for (uint8_t axis = 0u; axis < 3u; axis++)
+	{
+		const uint32_t biasedExponent = quantizeExponent(box.vMax[axis] - box.vMin[axis]);
+		node.scale |= biasedExponent << (8u * axis);
+		scale[axis] = exponentScale(biasedExponent);
+	}
+	node.scale |= (uint32_t)slots.size() << 24u;
+
+	for (uint8_t child = 0u; child < slots.size(); child++)
+	{
+		const auto& slot = slots[child];
+		for (uint8_t axis = 0u; axis < 3u; axis++)
+		{
+			node.bounds[axis] |= (uint32_t)quantizeMin(slot.vMin[axis], node.origin[axis], scale[axis]) << (8u * child);
+			node.bounds[3u + axis] |= (uint32_t)quantizeMax(slot.vMax[axis], node.origin[axis], scale[axis]) << (8u * child);
+		}
+
+		node.children[child] = slot.bufferRegion.x;
+		if (slot.bufferRegion.y > 0u)
+		{
+			node.counts[child / 2u] |= (slot.bufferRegion.y - slot.bufferRegion.x) << (16u * (child % 2u));
+		}
+	}
+
+	stats.wideChildCnt += slots.size();
+	stats.wideSteps += area(box);
+
+	wideNodes[wideIdx] = node;
+	return wideIdx;
+}
+
+std::vector<BoundingBox> BVH::sortWideSlots(std::vector<BoundingBox> slots)
+{
+	// A zero count marks inner children, so empty leaves are dropped
+	std::erase_if(slots, [](const BoundingBox& slot) { return slot.bufferRegion.x == slot.bufferRegion.y; });
+
+	// Larger children are more likely to be hit, so they take the first slots
+	std::stable_sort(slots.begin(), slots.end(), [](const BoundingBox& lhs, const BoundingBox& rhs)
+	{
+		return area(lhs) > area(rhs);
+	});
+	return slots;
+}
+
+std::vector<BoundingBox> BVH::splitWideLeaf(const BoundingBox& slot)
+{
+	// Counts are 16 bit, so oversized leaves get split over a node of their own
+	auto leafSlots = std::vector<BoundingBox>{};
+	const uint32_t triangleCount = slot.bufferRegion.y - slot.bufferRegion.x;
+	const uint32_t pieceSize = (triangleCount + WideNode::width - 1u) / WideNode::width;
+	for (uint32_t first = slot.bufferRegion.x; first < slot.bufferRegion.y; first += pieceSize)
+	{
+		auto& leafSlot = leafSlots.emplace_back(slot);
+		leafSlot.bufferRegion = glm::uvec2{ first, glm::min(first + pieceSize, slot.bufferRegion.y) };
+	}
+	return leafSlots;
+}
+
+std::vector<BoundingBox> BVH::gatherWideSlots(const BoundingBox& box) const
+{
+	// Pulling in the grandchildren halves the depth and keeps the topology independent of bounds
+	auto slots = std::vector<BoundingBox>{};
+	for (uint32_t childIdx = box.bufferRegion.x; childIdx < box.bufferRegion.x + 2u; childIdx++)
+	{
+		const auto& child = hierarchy[childIdx];
+		if (0u == child.bufferRegion.y)
+		{
+			slots.push_back(hierarchy[child.bufferRegion.x]);
+			slots.push_back(hierarchy[child.bufferRegion.x + 1u]);
+		}
+		else
+		{
+			slots.push_back(child);
+		}
+	}
+	return slots;
+}
+
+void BVH::splitSubtree(Subtree& tree, const glm::uvec2 bufferRegion, const uint8_t depth)
+{
+	if (bufferRegion.y - bufferRegion.x >= parallelSplitThreshold)
+	{
+		splitNode(tree, 0u, bufferRegion, depth);
+		return;
+	}
+
+	auto subtreeTimer = RT::Timer{};
+	splitNode(tree, 0u, bufferRegion, depth);
+	tree.stats.workTime += subtreeTimer.Ellapsed();
+}
+
+void BVH::splitNode(Subtree& tree, const uint32_t parentIdx, const glm::uvec2 bufferRegion, const uint8_t depth)
+{
+	switch (mode)
+	{
+		case BuildMode::SAH:	split(tree, parentIdx, bufferRegion, depth);		break;
+		case BuildMode::Linear: splitLinear(tree, parentIdx, bufferRegion, depth);	break;
+		case BuildMode::Spatial: break; // References are split by buildSpatial
+	}
+}
+
+void BVH::splitChildren(Subtree& tree, const uint32_t leftIdx, const glm::uvec2 leftRegion, const glm::uvec2 rightRegion, const uint8_t depth)
+{
+	if (rightRegion.y - leftRegion.x < parallelSplitThreshold)
+	{
+		splitNode(tree, leftIdx,	  leftRegion,  depth);
+		splitNode(tree, leftIdx + 1u, rightRegion, depth);
+		return;
+	}
+
+	// Both halves are built into private buffers and spliced back in the serial order
+	auto leftTree = Subtree{ { tree.hierarchy[leftIdx] } };
+	auto rightTree = Subtree{ { tree.hierarchy[leftIdx + 1u] } };
+
+	auto& pool = RT::ThreadPool::get();
+	auto group = RT::TaskGroup{};
+	pool.run(group, [&] { splitSubtree(leftTree, leftRegion, depth); });
+	splitSubtree(rightTree, rightRegion, depth);
+	pool.wait(group);
+
+	attachSubtree(tree, leftIdx,	  leftTree);
+	attachSubtree(tree, leftIdx + 1u, rightTree);
+}
+
+void BVH::split(Subtree& tree, const uint32_t parentIdx, const glm::uvec2 bufferRegion, const uint8_t depth)
 {
 	const uint32_t triangleCount = bufferRegion.y - bufferRegion.x;
+	const bool isParallel = triangleCount >= parallelSplitThreshold;
+	float* workTime = isParallel ? &tree.stats.workTime : nullptr;
 
-	auto splitInfo = splitBox(hierarchy[parentIdx], bufferRegion);
-	auto parentCost = area(hierarchy[parentIdx]) * triangleCount;
+	auto splitInfo = splitBox(tree.hierarchy[parentIdx], bufferRegion, workTime);
+	auto parentCost = area(tree.hierarchy[parentIdx]) * triangleCount;
 
 	if (maxDepth == depth or splitInfo.cost >= parentCost)
 	{
-		stats.measure(depth, triangleCount, parentCost);
+		tree.stats.measure(depth, triangleCount, parentCost);
 
-		hierarchy[parentIdx].bufferRegion = bufferRegion;
+		tree.hierarchy[parentIdx].bufferRegion = bufferRegion;
 		return;
 	}
 
+	auto partitionTimer = RT::Timer{};
+
 	auto leftChild = emptyBox;
 	auto rightChild = emptyBox;
 
@@ -142,16 +799,42 @@ void BVH::split(const uint32_t parentIdx, const glm::uvec2 bufferRegion, const u
 		}
 	}
 
-	hierarchy[parentIdx].bufferRegion.x = hierarchy.size();
-	hierarchy[parentIdx].bufferRegion.y = 0u;
-	hierarchy.push_back(leftChild);
-	hierarchy.push_back(rightChild);
-	
-	split(hierarchy[parentIdx].bufferRegion.x,		{ bufferRegion.x, bufferCenter   }, depth + 1u);
-	split(hierarchy[parentIdx].bufferRegion.x + 1u, { bufferCenter,   bufferRegion.y }, depth + 1u);
+	const uint32_t leftIdx = tree.hierarchy.size();
+	tree.hierarchy[parentIdx].bufferRegion.x = leftIdx;
+	tree.hierarchy[parentIdx].bufferRegion.y = 0u;
+	tree.hierarchy.push_back(leftChild);
+	tree.hierarchy.push_back(rightChild);
+
+	if (isParallel)
+	{
+		tree.stats.workTime += partitionTimer.Ellapsed();
+	}
+
+	splitChildren(tree, leftIdx, { bufferRegion.x, bufferCenter }, { bufferCenter, bufferRegion.y }, depth + 1u);
+}
+
+void BVH::attachSubtree(Subtree& tree, const uint32_t nodeIdx, const Subtree& subtree) const
+{
+	const uint32_t shift = tree.hierarchy.size() - 1u;
+	const auto rebase = [shift](BoundingBox box)
+	{
+		if (0u == box.bufferRegion.y)
+		{
+			box.bufferRegion.x += shift;
+		}
+		return box;
+	};
+
+	tree.hierarchy[nodeIdx] = rebase(subtree.hierarchy.front());
+	for (uint32_t i = 1u; i < subtree.hierarchy.size(); i++)
+	{
+		tree.hierarchy.push_back(rebase(subtree.hierarchy[i]));
+	}
+
+	tree.stats.merge(subtree.stats);
 }
 
-BVH::Split BVH::splitBox(const BoundingBox& box, const glm::uvec2 bufferRegion) const
+BVH::Split BVH::splitBox(const BoundingBox& box, const glm::uvec2 bufferRegion, float* workTime) const
 {
 	auto bestSplit = Split{ std::numeric_limits<float>::max(), 0.0f, 0 };
 
@@ -160,81 +843,557 @@ BVH::Split BVH::splitBox(const BoundingBox& box, const glm::uvec2 bufferRegion)
 		return bestSplit;
 	}
 
+	const auto centerBounds = findCenterBounds(bufferRegion, workTime);
+	if (centerBounds.vMin == centerBounds.vMax)
+	{
+		return bestSplit;
+	}
+
+	// Small nodes can not fill more bins than they have triangles, fewer bins keep their sweep cheap
+	const uint32_t nodeBinCount = glm::clamp(bufferRegion.y - bufferRegion.x, 2u, binCount);
+	const auto bins = binCenters(bufferRegion, centerBounds, nodeBinCount, workTime);
+
 	for (uint8_t axis = 0u; axis < 3u; axis++)
 	{
-		const auto centerBounds = findCenterBounds(axis, bufferRegion);
-		if (centerBounds.x == centerBounds.y)
+		const glm::vec2 bounds = { centerBounds.vMin[axis], centerBounds.vMax[axis] };
+		if (bounds.x == bounds.y)
 		{
 			continue;
 		}
 
-		auto split = splitAxis(axis, bufferRegion, centerBounds);
+		auto buckets = std::array<Bucket, maxBinCount>{};
+		for (uint32_t bin = 0u; bin < nodeBinCount; bin++)
+		{
+			buckets[bin] = bins.getBucket(axis, bin);
+		}
 
-		if (split.cost < bestSplit.cost)
+		const auto activeBuckets = std::span<const Bucket>(buckets.data(), nodeBinCount);
+		const auto [planeCost, plane] = findBestPlane(activeBuckets, activeBuckets);
+		if (planeCost < bestSplit.cost)
 		{
-			bestSplit = split;
+			const float binSize = (bounds.y - bounds.x) / (float)nodeBinCount;
+			bestSplit = Split{ planeCost, bounds.x + binSize * (plane + 1.0f), axis };
 		}
 	}
 	return bestSplit;
 }
 
-BVH::Split BVH::splitAxis(const uint8_t axis, const glm::uvec2 bufferRegion, const glm::vec2 bounds) const
+BVH::AxisBins BVH::binCenters(const glm::uvec2 bufferRegion, const BoundingBox& centerBounds, const uint32_t nodeBinCount, float* workTime) const
 {
-	const float subplaneInterval = (float)nrOfSubplanes / (bounds.y - bounds.x);
-	auto buckets = std::array<Bucket, nrOfSubplanes>{};
-	buckets.fill({ emptyBox, 0u });
+	// Flat axes get a zero interval, which drops all their centers into the first bin
+	const auto extent = centerBounds.vMax - centerBounds.vMin;
+	auto interval = glm::vec4{ 0.0f };
+	for (uint8_t axis = 0u; axis < 3u; axis++)
+	{
+		interval[axis] = extent[axis] > 0.0f ? nodeBinCount / extent[axis] : 0.0f;
+	}
 
-	for (uint32_t i = bufferRegion.x; i < bufferRegion.y; i++)
+	const auto binChunk = [&](const glm::uvec2 chunkRegion)
 	{
-		const auto& node = nodes[indices[i]];
-		const uint32_t idx = glm::min(nrOfSubplanes - 1, (uint32_t)((node.center[axis] - bounds.x) * subplaneInterval));
-		extendBox(buckets[idx].bounds, node);
-		buckets[idx].cnt++;
+		const __m128 origin = _mm_setr_ps(centerBounds.vMin.x, centerBounds.vMin.y, centerBounds.vMin.z, 0.0f);
+		const __m128 scale = _mm_loadu_ps(&interval.x);
+		const __m128 lastBin = _mm_set1_ps(nodeBinCount - 1.0f);
+
+		auto bins = AxisBins(nodeBinCount);
+		alignas(16) int32_t binIdx[4];
+		for (uint32_t i = chunkRegion.x; i < chunkRegion.y; i++)
+		{
+			const uint32_t index = indices[i];
+			const __m128 center = _mm_loadu_ps(&lanes.center[index].x);
+			const __m128 vMin = _mm_loadu_ps(&lanes.vMin[index].x);
+			const __m128 vMax = _mm_loadu_ps(&lanes.vMax[index].x);
+
+			// Bin of all three axes at once, the max with zero comes first so NaN lands in bin zero
+			const __m128 position = _mm_mul_ps(_mm_sub_ps(center, origin), scale);
+			_mm_store_si128(reinterpret_cast<__m128i*>(binIdx), _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(position, _mm_setzero_ps()), lastBin)));
+
+			for (uint8_t axis = 0u; axis < 3u; axis++)
+			{
+				bins.extend(axis, binIdx[axis], vMin, vMax);
+			}
+		}
+		return bins;
+	};
+	const auto mergeBins = [](AxisBins& bins, const AxisBins& partial)
+	{
+		bins.merge(partial);
+	};
+
+	return reduceChunks(bufferRegion, parallelChunkSize, binChunk, mergeBins, workTime);
+}
+
+BoundingBox BVH::findCenterBounds(const glm::uvec2 bufferRegion, float* workTime) const
+{
+	const auto boundChunk = [&](const glm::uvec2 chunkRegion)
+	{
+		__m128 vMin = _mm_set1_ps(std::numeric_limits<float>::max());
+		__m128 vMax = _mm_set1_ps(std::numeric_limits<float>::lowest());
+		for (uint32_t i = chunkRegion.x; i < chunkRegion.y; i++)
+		{
+			const __m128 center = _mm_loadu_ps(&lanes.center[indices[i]].x);
+			vMin = _mm_min_ps(vMin, center);
+			vMax = _mm_max_ps(vMax, center);
+		}
+		return toBox(vMin, vMax);
+	};
+
+	return reduceChunks(bufferRegion, parallelChunkSize, boundChunk, growBox, workTime);
+}
+
+void BVH::sortByMortonCode()
+{
+	const auto nodesRegion = glm::uvec2{ 0u, nodes.size() };
+
+	const auto boundChunk = [&](const glm::uvec2 chunkRegion)
+	{
+		auto bounds = emptyBox;
+		for (uint32_t i = chunkRegion.x; i < chunkRegion.y; i++)
+		{
+			bounds.vMin = glm::min(bounds.vMin, nodes[i].center);
+			bounds.vMax = glm::max(bounds.vMax, nodes[i].center);
+		}
+		return bounds;
+	};
+	const auto centerBounds = reduceChunks(nodesRegion, parallelChunkSize, boundChunk, growBox, &stats.workTime);
+
+	const bool isShortCode = nodes.size() <= shortMortonLimit;
+	const uint32_t axisBits = isShortCode ? 10u : 21u;
+	const float axisCells = (float)((1u << axisBits) - 1u);
+	const auto extent = glm::max(centerBounds.vMax - centerBounds.vMin, glm::vec3{ std::numeric_limits<float>::min() });
+
+	mortonCodes.resize(nodes.size());
+	forEachChunk(nodesRegion, parallelChunkSize, [&](const uint32_t /*chunk*/, const glm::uvec2 chunkRegion)
+	{
+		for (uint32_t i = chunkRegion.x; i < chunkRegion.y; i++)
+		{
+			const auto cell = glm::uvec3(glm::clamp((nodes[i].center - centerBounds.vMin) / extent, 0.0f, 1.0f) * axisCells);
+			mortonCodes[i] = isShortCode
+				? (expandBits10(cell.x) << 2u) | (expandBits10(cell.y) << 1u) | expandBits10(cell.z)
+				: (expandBits21(cell.x) << 2u) | (expandBits21(cell.y) << 1u) | expandBits21(cell.z);
+		}
+	}, stats.workTime);
+
+	// LSD radix sort over 8 bit digits. Chunk histograms are scanned in chunk order, which keeps it stable
+	constexpr uint32_t radixBits = 8u;
+	constexpr uint32_t radixSize = 1u << radixBits;
+	using Histogram = std::array<uint32_t, radixSize>;
+
+	const uint32_t passCnt = (3u * axisBits + radixBits - 1u) / radixBits;
+	auto histograms = std::vector<Histogram>(chunkCount(nodesRegion, parallelChunkSize));
+	auto sortedCodes = std::vector<uint64_t>(mortonCodes.size());
+	auto sortedIndices = std::vector<uint32_t>(indices.size());
+
+	for (uint32_t pass = 0u; pass < passCnt; pass++)
+	{
+		const uint32_t shift = pass * radixBits;
+
+		forEachChunk(nodesRegion, parallelChunkSize, [&](const uint32_t chunk, const glm::uvec2 chunkRegion)
+		{
+			auto& histogram = histograms[chunk];
+			histogram.fill(0u);
+			for (uint32_t i = chunkRegion.x; i < chunkRegion.y; i++)
+			{
+				histogram[(mortonCodes[i] >> shift) & (radixSize - 1u)]++;
+			}
+		}, stats.workTime);
+
+		uint32_t offset = 0u;
+		for (uint32_t digit = 0u; digit < radixSize; digit++)
+		{
+			for (auto& histogram : histograms)
+			{
+				const uint32_t digitCnt = histogram[digit];
+				histogram[digit] = offset;
+				offset += digitCnt;
+			}
+		}
+
+		forEachChunk(nodesRegion, parallelChunkSize, [&](const uint32_t chunk, const glm::uvec2 chunkRegion)
+		{
+			auto& histogram = histograms[chunk];
+			for (uint32_t i = chunkRegion.x; i < chunkRegion.y; i++)
+			{
+				const uint32_t dst = histogram[(mortonCodes[i] >> shift) & (radixSize - 1u)]++;
+				sortedCodes[dst] = mortonCodes[i];
+				sortedIndices[dst] = indices[i];
+			}
+		}, stats.workTime);
+
+		std::swap(mortonCodes, sortedCodes);
+		std::swap(indices, sortedIndices);
+	}
+}
+
+void BVH::splitLinear(Subtree& tree, const uint32_t parentIdx, const glm::uvec2 bufferRegion, const uint8_t depth)
+{
+	const uint32_t triangleCount = bufferRegion.y - bufferRegion.x;
+
+	if (maxDepth == depth or triangleCount <= linearLeafSize)
+	{
+		auto leaf = emptyBox;
+		for (uint32_t i = bufferRegion.x; i < bufferRegion.y; i++)
+		{
+			extendBox(leaf, nodes[indices[i]]);
+		}
+		leaf.bufferRegion = bufferRegion;
+
+		tree.hierarchy[parentIdx] = leaf;
+		tree.stats.measure(depth, triangleCount, area(leaf) * triangleCount);
+		return;
+	}
+
+	const uint32_t bufferCenter = findMortonSplit(bufferRegion);
+
+	const uint32_t leftIdx = tree.hierarchy.size();
+	tree.hierarchy.push_back(emptyBox);
+	tree.hierarchy.push_back(emptyBox);
+
+	splitChildren(tree, leftIdx, { bufferRegion.x, bufferCenter }, { bufferCenter, bufferRegion.y }, depth + 1u);
+
+	// Bounds are only known once both children are built
+	auto parent = emptyBox;
+	growBox(parent, tree.hierarchy[leftIdx]);
+	growBox(parent, tree.hierarchy[leftIdx + 1u]);
+	parent.bufferRegion = { leftIdx, 0u };
+	tree.hierarchy[parentIdx] = parent;
+}
+
+uint32_t BVH::findMortonSplit(const glm::uvec2 bufferRegion) const
+{
+	const uint64_t firstCode = mortonCodes[bufferRegion.x];
+	const uint64_t lastCode = mortonCodes[bufferRegion.y - 1u];
+	if (firstCode == lastCode)
+	{
+		return (bufferRegion.x + bufferRegion.y) / 2u;
+	}
+
+	// Codes share the prefix above the highest differing bit, the ones with that bit set form the upper part
+	const uint64_t splitBit = 1ull << (63u - std::countl_zero(firstCode ^ lastCode));
+	const auto first = mortonCodes.begin() + bufferRegion.x;
+	const auto last = mortonCodes.begin() + bufferRegion.y;
+	const auto center = std::partition_point(first, last, [splitBit](const uint64_t code) { return 0u == (code & splitBit); });
+
+	return (uint32_t)(center - mortonCodes.begin());
+}
+
+void BVH::buildSpatial(Subtree& tree)
+{
+	auto spatialTimer = RT::Timer{};
+
+	auto references = std::vector<Reference>();
+	references.reserve(nodes.size());
+	for (uint32_t index = 0u; index < nodes.size(); index++)
+	{
+		references.push_back(Reference{ nodes[index], index });
+	}
+
+	// Leafs append their references, so triangles split by a plane end up listed once per leaf
+	indices.clear();
+	indices.reserve(nodes.size() + (uint32_t)(nodes.size() * maxDuplicationRatio));
+	duplicationBudget = (uint32_t)(nodes.size() * maxDuplicationRatio);
+	spatialRootArea = area(tree.hierarchy.front());
+
+	splitSpatial(tree, 0u, std::move(references), 0u);
+	tree.stats.workTime += spatialTimer.Ellapsed();
+}
+
+void BVH::splitSpatial(Subtree& tree, const uint32_t parentIdx, std::vector<Reference> references, const uint8_t depth)
+{
+	const uint32_t referenceCount = references.size();
+	const auto parentCost = area(tree.hierarchy[parentIdx]) * referenceCount;
+
+	const auto objectSplit = splitReferences(references);
+	auto bestSplit = objectSplit;
+	auto left = std::vector<Reference>();
+	auto right = std::vector<Reference>();
+	auto leftChild = emptyBox;
+	auto rightChild = emptyBox;
+
+	if (objectSplit.cost < parentCost)
+	{
+		for (const auto& reference : references)
+		{
+			const bool isLeft = reference.node.center[objectSplit.axis] <= objectSplit.position;
+			extendBox(isLeft ? leftChild : rightChild, reference.node);
+			(isLeft ? left : right).push_back(reference);
+		}
+	}
+
+	// Spatial splits are only worth probing where the object split children overlap noticeably
+	bool isSpatial = false;
+	if (duplicationBudget > 0u and maxDepth != depth
+		and (left.empty() or right.empty() or area(overlap(leftChild, rightChild)) > spatialOverlapRatio * spatialRootArea))
+	{
+		for (uint8_t axis = 0u; axis < 3u; axis++)
+		{
+			const auto split = splitSpatialAxis(axis, tree.hierarchy[parentIdx], references);
+			if (split.cost < bestSplit.cost)
+			{
+				bestSplit = split;
+				isSpatial = true;
+			}
+		}
 	}
 
-	auto leftStat = std::array<BucketStat, nrOfSubplanes - 1u>{};
-	auto rightStat = std::array<BucketStat, nrOfSubplanes - 1u>{};
-	auto leftBox = Bucket{ emptyBox, 0u };
-	auto rightBox = Bucket{ emptyBox, 0u };
-	for (uint32_t li = 0u; li < nrOfSubplanes - 1u; li++)
+	if (isSpatial and bestSplit.cost < parentCost)
 	{
-		leftBox.cnt += buckets[li].cnt;
-		leftStat[li].sumCnt = leftBox.cnt;
-		growBox(leftBox.bounds, buckets[li].bounds);
-		leftStat[li].area = area(leftBox.bounds);
+		isSpatial = partitionSpatial(bestSplit, references, left, right);
 
-		auto ri = nrOfSubplanes - 1u - li;
-		rightBox.cnt += buckets[ri].cnt;
-		rightStat[ri - 1u].sumCnt = rightBox.cnt;
-		growBox(rightBox.bounds, buckets[ri].bounds);
-		rightStat[ri - 1u].area = area(rightBox.bounds);
+		// A rejected spatial partition leaves the object split in left and right, so its cost has to decide
+		bestSplit = isSpatial ? bestSplit : objectSplit;
 	}
 
-	const float subplaneSize = (bounds.y - bounds.x) / (float)nrOfSubplanes;
+	if (maxDepth == depth or bestSplit.cost >= parentCost or left.empty() or right.empty())
+	{
+		tree.stats.measure(depth, referenceCount, parentCost);
+
+		tree.hierarchy[parentIdx].bufferRegion = glm::uvec2{ indices.size(), indices.size() + referenceCount };
+		for (const auto& reference : references)
+		{
+			indices.push_back(reference.index);
+		}
+		return;
+	}
+	references = {};
+
+	if (isSpatial)
+	{
+		leftChild = emptyBox;
+		rightChild = emptyBox;
+		for (const auto& reference : left)
+		{
+			extendBox(leftChild, reference.node);
+		}
+		for (const auto& reference : right)
+		{
+			extendBox(rightChild, reference.node);
+		}
+	}
+
+	const uint32_t leftIdx = tree.hierarchy.size();
+	tree.hierarchy[parentIdx].bufferRegion.x = leftIdx;
+	tree.hierarchy[parentIdx].bufferRegion.y = 0u;
+	tree.hierarchy.push_back(leftChild);
+	tree.hierarchy.push_back(rightChild);
+
+	splitSpatial(tree, leftIdx, std::move(left), depth + 1u);
+	splitSpatial(tree, leftIdx + 1u, std::move(right), depth + 1u);
+}
+
+BVH::Split BVH::splitReferences(const std::vector<Reference>& references) const
+{
 	auto bestSplit = Split{ std::numeric_limits<float>::max(), 0.0f, 0 };
-	for (uint32_t i = 0u; i < nrOfSubplanes - 1u; i++)
+	for (uint8_t axis = 0u; axis < 3u; axis++)
 	{
-		float planeCost = leftStat[i].sumCnt * leftStat[i].area + rightStat[i].sumCnt * rightStat[i].area;
+		auto bounds = glm::vec2{ std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+		for (const auto& reference : references)
+		{
+			bounds.x = glm::min(bounds.x, reference.node.center[axis]);
+			bounds.y = glm::max(bounds.y, reference.node.center[axis]);
+		}
+		if (bounds.x >= bounds.y)
+		{
+			continue;
+		}
+
+		auto buckets = std::array<Bucket, maxBinCount>{};
+		buckets.fill({ emptyBox, 0u });
+
+		const float binInterval = (float)binCount / (bounds.y - bounds.x);
+		for (const auto& reference : references)
+		{
+			const uint32_t idx = glm::min(binCount - 1u, (uint32_t)((reference.node.center[axis] - bounds.x) * binInterval));
+			extendBox(buckets[idx].bounds, reference.node);
+			buckets[idx].cnt++;
+		}
+
+		const auto activeBuckets = std::span<const Bucket>(buckets.data(), binCount);
+		const auto [planeCost, plane] = findBestPlane(activeBuckets, activeBuckets);
 		if (planeCost < bestSplit.cost)
 		{
-			bestSplit = Split{ planeCost, bounds.x + subplaneSize * (i + 1.0f), axis};
+			const float binSize = (bounds.y - bounds.x) / (float)binCount;
+			bestSplit = Split{ planeCost, bounds.x + binSize * (plane + 1.0f), axis };
 		}
 	}
-
 	return bestSplit;
 }
 
-glm::vec2 BVH::findCenterBounds(const uint8_t axis, const glm::uvec2 bufferRegion) const
+BVH::Split BVH::splitSpatialAxis(const uint8_t axis, const BoundingBox& box, const std::vector<Reference>& references) const
 {
-	float leftCenter = std::numeric_limits<float>::max();
-	float rightCenter = std::numeric_limits<float>::lowest();
-	for (uint32_t i = bufferRegion.x; i < bufferRegion.y; i++)
+	using Buckets = std::array<Bucket, spatialBins>;
+
+	const float origin = box.vMin[axis];
+	const float binSize = (box.vMax[axis] - origin) / (float)spatialBins;
+	if (binSize <= 0.0f)
 	{
-		const auto& node = nodes[indices[i]];
-		leftCenter = glm::min(leftCenter, node.center[axis]);
-		rightCenter = glm::max(rightCenter, node.center[axis]);
+		return Split{ std::numeric_limits<float>::max(), 0.0f, axis };
+	}
+
+	// Every reference enters the bin of its minimum and exits the one of its maximum,
+	// the bins in between get bounded by the clipped pieces of the triangle
+	auto entries = Buckets{};
+	auto exits = Buckets{};
+	entries.fill({ emptyBox, 0u });
+	exits.fill({ emptyBox, 0u });
+
+	const auto binOf = [&](const float position)
+	{
+		return (uint32_t)glm::clamp((position - origin) / binSize, 0.0f, spatialBins - 1.0f);
+	};
+
+	for (const auto& reference : references)
+	{
+		const uint32_t firstBin = binOf(reference.node.vMin[axis]);
+		const uint32_t lastBin = binOf(reference.node.vMax[axis]);
+		entries[firstBin].cnt++;
+		exits[lastBin].cnt++;
+
+		auto remainder = reference;
+		for (uint32_t bin = firstBin; bin < lastBin; bin++)
+		{
+			const auto [piece, rest] = clipReference(remainder, axis, origin + binSize * (bin + 1.0f));
+			extendBox(entries[bin].bounds, piece.node);
+			remainder = rest;
+		}
+		extendBox(entries[lastBin].bounds, remainder.node);
+	}
+
+	for (uint32_t bin = 0u; bin < spatialBins; bin++)
+	{
+		exits[bin].bounds = entries[bin].bounds;
+	}
+
+	const auto [planeCost, plane] = findBestPlane(entries, exits);
+	return Split{ planeCost, origin + binSize * (plane + 1.0f), axis };
+}
+
+bool BVH::partitionSpatial(const Split& split, const std::vector<Reference>& references, std::vector<Reference>& left, std::vector<Reference>& right)
+{
+	auto straddling = std::vector<Reference>();
+	auto leftSplit = std::vector<Reference>();
+	auto rightSplit = std::vector<Reference>();
+	auto leftBox = emptyBox;
+	auto rightBox = emptyBox;
+
+	for (const auto& reference : references)
+	{
+		if (reference.node.vMax[split.axis] <= split.position)
+		{
+			extendBox(leftBox, reference.node);
+			leftSplit.push_back(reference);
+		}
+		else if (reference.node.vMin[split.axis] >= split.position)
+		{
+			extendBox(rightBox, reference.node);
+			rightSplit.push_back(reference);
+		}
+		else
+		{
+			straddling.push_back(reference);
+		}
+	}
+
+	// Reference unsplitting: a straddling triangle is kept whole on one side when that is cheaper than duplicating it
+	for (const auto& reference : straddling)
+	{
+		const auto [leftPiece, rightPiece] = clipReference(reference, split.axis, split.position);
+		const float leftCnt = leftSplit.size();
+		const float rightCnt = rightSplit.size();
+
+		const float leftCost = area(unite(leftBox, reference.node)) * (leftCnt + 1.0f) + area(rightBox) * rightCnt;
+		const float rightCost = area(leftBox) * leftCnt + area(unite(rightBox, reference.node)) * (rightCnt + 1.0f);
+		const float duplicateCost = area(unite(leftBox, leftPiece.node)) * (leftCnt + 1.0f) + area(unite(rightBox, rightPiece.node)) * (rightCnt + 1.0f);
+
+		const bool isClipped = leftPiece.node.vMin.x <= leftPiece.node.vMax.x and rightPiece.node.vMin.x <= rightPiece.node.vMax.x;
+		if (isClipped and duplicationBudget > 0u and duplicateCost < leftCost and duplicateCost < rightCost)
+		{
+			extendBox(leftBox, leftPiece.node);
+			extendBox(rightBox, rightPiece.node);
+			leftSplit.push_back(leftPiece);
+			rightSplit.push_back(rightPiece);
+			duplicationBudget--;
+		}
+		else if (leftCost <= rightCost)
+		{
+			extendBox(leftBox, reference.node);
+			leftSplit.push_back(reference);
+		}
+		else
+		{
+			extendBox(rightBox, reference.node);
+			rightSplit.push_back(reference);
+		}
+	}
+
+	if (leftSplit.empty() or rightSplit.empty())
+	{
+		return false;
+	}
+
+	left = std::move(leftSplit);
+	right = std::move(rightSplit);
+	return true;
+}
+
+std::pair<BVH::Reference, BVH::Reference> BVH::clipReference(const Reference& reference, const uint8_t axis, const float position) const
+{
+	auto left = Reference{ Node{ emptyBox.vMin, emptyBox.vMax, glm::vec3{ 0.0f } }, reference.index };
+	auto right = left;
+
+	const auto extend = [](Reference& piece, const glm::vec3& point)
+	{
+		piece.node.vMin = glm::min(piece.node.vMin, point);
+		piece.node.vMax = glm::max(piece.node.vMax, point);
+	};
+
+	if (isMeshBvh)
+	{
+		const auto& model = mesh->getModel();
+		const auto& triangle = model.indices[reference.index];
+		const auto vertices = std::array<glm::vec3, 3>{ model.vertices[triangle.x].position, model.vertices[triangle.y].position, model.vertices[triangle.z].position };
+		for (uint32_t i = 0u; i < 3u; i++)
+		{
+			const auto& v0 = vertices[i];
+			const auto& v1 = vertices[(i + 1u) % 3u];
+			if (v0[axis] <= position)
+			{
+				extend(left, v0);
+			}
+			if (v0[axis] >= position)
+			{
+				extend(right, v0);
+			}
+			if ((v0[axis] < position and v1[axis] > position) or (v0[axis] > position and v1[axis] < position))
+			{
+				auto crossing = glm::mix(v0, v1, (position - v0[axis]) / (v1[axis] - v0[axis]));
+				crossing[axis] = position;
+				extend(left, crossing);
+				extend(right, crossing);
+			}
+		}
+	}
+	else
+	{
+		left.node = reference.node;
+		right.node = reference.node;
 	}
-	return { leftCenter, rightCenter };
+
+	// Pieces never outgrow the reference they were cut from
+	left.node.vMax[axis] = glm::min(left.node.vMax[axis], position);
+	right.node.vMin[axis] = glm::max(right.node.vMin[axis], position);
+	for (auto* piece : { &left, &right })
+	{
+		piece->node.vMin = glm::max(piece->node.vMin, reference.node.vMin);
+		piece->node.vMax = glm::min(piece->node.vMax, reference.node.vMax);
+		if (glm::any(glm::greaterThan(piece->node.vMin, piece->node.vMax)))
+		{
+			piece->node.vMin = emptyBox.vMin;
+			piece->node.vMax = emptyBox.vMax;
+		}
+		piece->node.center = (piece->node.vMin + piece->node.vMax) * 0.5f;
+	}
+
+	return { left, right };
 }
 
 void BVH::Stats::measure(const uint8_t depth, const uint32_t triangleCount, const float cost)
@@ -249,10 +1408,58 @@ void BVH::Stats::measure(const uint8_t depth, const uint32_t triangleCount, cons
 	SAH += cost;
 }
 
+void BVH::Stats::merge(const Stats& other)
+{
+	workTime += other.workTime;
+	leafCnt += other.leafCnt;
+	leafDepth.x = glm::min(leafDepth.x, other.leafDepth.x);
+	leafDepth.y = glm::max(leafDepth.y, other.leafDepth.y);
+	leafDepthSum += other.leafDepthSum;
+	leafTris.x = glm::min(leafTris.x, other.leafTris.x);
+	leafTris.y = glm::max(leafTris.y, other.leafTris.y);
+	leafTrisSum += other.leafTrisSum;
+	SAH += other.SAH;
+}
+
+void BVH::Stats::measureTree(const std::vector<BoundingBox>& hierarchy)
+{
+	constexpr float traversalCost = 1.0f;
+	constexpr float intersectionCost = 1.0f;
+
+	const float rootArea = area(hierarchy.front());
+	if (0.0f == rootArea)
+	{
+		return;
+	}
+
+	float cost = 0.0f;
+	float innerArea = 0.0f;
+	for (const auto& box : hierarchy)
+	{
+		const uint32_t triangleCount = box.bufferRegion.y - box.bufferRegion.x;
+		cost += area(box) * (0u == box.bufferRegion.y ? traversalCost : triangleCount * intersectionCost);
+		innerArea += 0u == box.bufferRegion.y ? area(box) : 0.0f;
+	}
+	treeCost = cost / rootArea;
+	binarySteps = innerArea / rootArea;
+}
+
 void BVH::Stats::print() const
 {
+	LOG_DEBUG("BVH builder: {}", buildMode2Str(mode));
 	LOG_DEBUG("BVH buildTime: {} ms", buildTime);
+	LOG_DEBUG("BVH threads = {} work = {} ms speedup = {}x", threadCnt, workTime, speedup());
 	LOG_DEBUG("BVH triangles = {} nodes = {} leafs = {}", triCnt, nodeCnt, leafCnt);
+	if (refCnt > triCnt)
+	{
+		LOG_DEBUG("BVH references = {} duplication = {}%", refCnt, duplication() * 100.0f);
+	}
 	LOG_DEBUG("BVH leaf Depth: Min = {} Max = {} Mean = {}", leafDepth.x, leafDepth.y, meanDepth());
 	LOG_DEBUG("BVH leaf Tris:  Min = {} Max = {} Mean = {} SAH on leafs = {}", leafTris.x, leafTris.y, meanTris(), SAH);
+	LOG_DEBUG("BVH SAH tree cost = {}", treeCost);
+	if (wideNodeCnt > 0u)
+	{
+		LOG_DEBUG("BVH{} nodes = {} children per node = {}", WideNode::width, wideNodeCnt, meanWideChildren());
+		LOG_DEBUG("BVH traversal steps per ray: binary = {} BVH{} = {}", binarySteps, WideNode::width, wideSteps);
+	}
 }
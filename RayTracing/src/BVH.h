@@ -1,4 +1,7 @@
 #pragma once
+#include <optional>
+#include <span>
+
 #include <glm/glm.hpp>
 
 #include "Engine/Render/Mesh.h"
@@ -19,8 +22,31 @@ struct BoundingBox
 };
 #pragma pack(pop)
 
+/*
+* 64 byte node of the 4-wide hierarchy. Children are quantized to 8 bits on a power
+* of two grid anchored at the node's minimum corner, one word per bound and axis.
+* Leaf children are stored inline as a triangle range, inner ones as a node index.
+*/
+#pragma pack(push, 1)
+struct WideNode
+{
+	glm::vec3 origin;
+	uint32_t scale;			// biased exponents x | y << 8 | z << 16 | childCnt << 24
+	uint32_t bounds[6];		// min x, y, z then max x, y, z, one byte per child
+	uint32_t children[4];	// node index or first triangle
+	uint32_t counts[2];		// 16 bit triangle count per child, zero for inner children
+
+	static constexpr uint32_t width = 4u;
+	static constexpr uint32_t maxLeafSize = 0xFFFFu;
+};
+#pragma pack(pop)
+
 class BVH
 {
+	friend class BVHCache;
+public:
+	enum class BuildMode : uint8_t { SAH, Linear, Spatial };
+
 private:
 	struct Split
 	{
@@ -29,47 +55,158 @@ private:
 		uint8_t axis;
 	};
 
+	struct AxisBins;
+
+	// Node bounds split into 16 byte lanes, so binning loads them straight into SIMD registers
+	struct NodeLanes
+	{
+		std::vector<glm::vec4> vMin;
+		std::vector<glm::vec4> vMax;
+		std::vector<glm::vec4> center;
+	};
+
+	// Triangle reference of the spatial split builder, bounded by the part of the triangle inside its node
+	struct Reference
+	{
+		Node node;
+		uint32_t index;
+	};
+
 public:
 	struct Stats
 	{
-		float buildTime;
-		uint32_t triCnt;
-		uint32_t nodeCnt;
-		uint32_t leafCnt;
-		glm::uvec2 leafDepth;
-		float leafDepthSum;
-		glm::uvec2 leafTris;
-		float leafTrisSum;
-		float SAH;
+		float buildTime = 0.0f;
+		float workTime = 0.0f;
+		uint32_t threadCnt = 1u;
+		uint32_t triCnt = 0u;
+		uint32_t refCnt = 0u;
+		uint32_t nodeCnt = 0u;
+		uint32_t leafCnt = 0u;
+		glm::uvec2 leafDepth = { 100u, 0u };
+		float leafDepthSum = 0.0f;
+		glm::uvec2 leafTris = { 1000000u, 0u };
+		float leafTrisSum = 0.0f;
+		float SAH = 0.0f;
+		float treeCost = 0.0f;
+		float binarySteps = 0.0f;
+		uint32_t wideNodeCnt = 0u;
+		uint32_t wideChildCnt = 0u;
+		float wideSteps = 0.0f;
+		BuildMode mode = BuildMode::SAH;
 
 		float meanDepth() const { return leafDepthSum / leafCnt; }
 		float meanTris() const { return leafTrisSum / leafCnt; }
+		float duplication() const { return (float)(refCnt - triCnt) / triCnt; }
+		float meanWideChildren() const { return (float)wideChildCnt / wideNodeCnt; }
+		float speedup() const { return workTime / buildTime; }
+		void measureTree(const std::vector<BoundingBox>& hierarchy);
 		void measure(const uint8_t depth, const uint32_t triangleCount, const float cost);
+		void merge(const Stats& other);
 		void print() const;
-	} stats = { 0, 0, 0, 0, { 100, 0 }, 0, { 1000000, 0 }, 0, 0 };
+	} stats = {};
+
+private:
+	struct Subtree
+	{
+		std::vector<BoundingBox> hierarchy;
+		Stats stats;
+	};
 
 public:
-	BVH(const RT::Mesh& mesh);
+	static constexpr uint32_t defaultBinCount = 16u;
+	static constexpr uint32_t maxBinCount = 32u;
+	static constexpr uint8_t maxDepth = 32u;
+	// Traversal stacks. A binary node at maxDepth pushes both children. A wide level spans two binary ones and
+	// leaves up to three children pending, splitting an oversized leaf adds one more level at the bottom
+	static constexpr uint32_t binaryStackDepth = maxDepth + 2u;
+	static constexpr uint32_t wideStackDepth = 3u * (maxDepth / 2u) + 4u;
 
-	std::vector<RT::Triangle> buildTriangles() const;
+	BVH(const RT::Mesh& mesh, const BuildMode mode = BuildMode::SAH, const uint32_t binCount = defaultBinCount);
+	BVH(std::vector<Node> primitives, const BuildMode mode = BuildMode::SAH, const uint32_t binCount = defaultBinCount);
+	// Hierarchy restored from the cache, indices name the triangle of every leaf reference
+	BVH(const RT::Mesh& mesh, const BuildMode mode, const uint32_t binCount, std::vector<BoundingBox> hierarchy, std::vector<uint32_t> indices, std::vector<WideNode> wideNodes);
+
+	static constexpr const char* buildMode2Str(const BuildMode mode)
+	{
+		switch (mode)
+		{
+			case BuildMode::SAH: return "SAH";
+			case BuildMode::Linear: return "LBVH";
+			case BuildMode::Spatial: return "SBVH";
+		}
+		return "Unknown";
+	}
+
+	// Dirty range of the hierarchy, none when the bounds degraded into a rebuild with a new topology
+	std::optional<glm::uvec2> refit(const RT::Mesh& mesh);
+	std::optional<glm::uvec2> refit(std::vector<Node> primitives);
+
+	static BoundingBox decodeChild(const WideNode& node, const uint8_t child);
+	// Decodes every wide child against the binary boxes it was collapsed from, the encoding has to round trip
+	bool verifyWideNodes() const;
+
+	// Index triplets of the mesh in leaf order, leaf regions of the hierarchy point into them
+	std::vector<glm::uvec3> buildTriangleIndices(const RT::Mesh& mesh) const;
 	const std::vector<BoundingBox>& getHierarchy() const { return hierarchy; }
+	const std::vector<WideNode>& getWideNodes() const { return wideNodes; }
+	const std::vector<uint32_t>& getIndices() const { return indices; }
 	
 private:
+	void build();
 	void buildNodes();
+	void updateNodes();
 	void construct();
-	void split(const uint32_t parentIdx, const glm::uvec2 bufferRegion, const uint8_t depth = 0u);
-	Split splitBox(const BoundingBox& box, const glm::uvec2 bufferRegion) const;
-	Split splitAxis(const uint8_t axis, const glm::uvec2 bufferRegion, const glm::vec2 bounds) const;
-	glm::vec2 findCenterBounds(const uint8_t axis, const glm::uvec2 bufferRegion) const;
+	std::optional<glm::uvec2> refitHierarchy();
+	void collapse();
+	uint32_t emitWideNode(const BoundingBox& box, std::vector<BoundingBox> slots);
+	bool verifyWideNode(const uint32_t wideIdx, std::vector<BoundingBox> slots) const;
+	static std::vector<BoundingBox> sortWideSlots(std::vector<BoundingBox> slots);
+	static std::vector<BoundingBox> splitWideLeaf(const BoundingBox& slot);
+	std::vector<BoundingBox> gatherWideSlots(const BoundingBox& box) const;
+	void splitSubtree(Subtree& tree, const glm::uvec2 bufferRegion, const uint8_t depth);
+	void splitNode(Subtree& tree, const uint32_t parentIdx, const glm::uvec2 bufferRegion, const uint8_t depth);
+	void splitChildren(Subtree& tree, const uint32_t leftIdx, const glm::uvec2 leftRegion, const glm::uvec2 rightRegion, const uint8_t depth);
+	void attachSubtree(Subtree& tree, const uint32_t nodeIdx, const Subtree& subtree) const;
+
+	void split(Subtree& tree, const uint32_t parentIdx, const glm::uvec2 bufferRegion, const uint8_t depth);
+	Split splitBox(const BoundingBox& box, const glm::uvec2 bufferRegion, float* workTime) const;
+	AxisBins binCenters(const glm::uvec2 bufferRegion, const BoundingBox& centerBounds, const uint32_t nodeBinCount, float* workTime) const;
+	BoundingBox findCenterBounds(const glm::uvec2 bufferRegion, float* workTime) const;
+
+	void sortByMortonCode();
+	void splitLinear(Subtree& tree, const uint32_t parentIdx, const glm::uvec2 bufferRegion, const uint8_t depth);
+	uint32_t findMortonSplit(const glm::uvec2 bufferRegion) const;
+
+	void buildSpatial(Subtree& tree);
+	void splitSpatial(Subtree& tree, const uint32_t parentIdx, std::vector<Reference> references, const uint8_t depth);
+	Split splitReferences(const std::vector<Reference>& references) const;
+	Split splitSpatialAxis(const uint8_t axis, const BoundingBox& box, const std::vector<Reference>& references) const;
+	bool partitionSpatial(const Split& split, const std::vector<Reference>& references, std::vector<Reference>& left, std::vector<Reference>& right);
+	std::pair<Reference, Reference> clipReference(const Reference& reference, const uint8_t axis, const float position) const;
 
 private:
-	const RT::Mesh& mesh;
+	const RT::Mesh* mesh = nullptr;	// borrowed only while building or refitting, meshes move as the scene grows
+	const bool isMeshBvh;
+	const BuildMode mode;
+	const uint32_t binCount;
 	std::vector<uint32_t> indices = {};
+	std::vector<uint64_t> mortonCodes = {};
 	std::vector<Node> nodes = {};
+	NodeLanes lanes = {};
 	std::vector<BoundingBox> hierarchy = {};
+	std::vector<WideNode> wideNodes = {};
+	float builtTreeCost = 0.0f;
+	float spatialRootArea = 0.0f;
+	uint32_t duplicationBudget = 0u;
 
-	static constexpr uint8_t maxDepth = 32u;
-	static constexpr uint32_t nrOfSubplanes = 6u;
+	static constexpr uint32_t parallelSplitThreshold = 4096u;
+	static constexpr uint32_t parallelChunkSize = 16384u;
+	static constexpr uint32_t linearLeafSize = 4u;
+	static constexpr float rebuildCostRatio = 1.5f;
+	static constexpr uint32_t shortMortonLimit = 1u << 20u;
+	static constexpr uint32_t spatialBins = 16u;
+	static constexpr float maxDuplicationRatio = 0.3f;
+	static constexpr float spatialOverlapRatio = 1e-5f;
 	static constexpr BoundingBox emptyBox = {
 		glm::vec3{std::numeric_limits<float>::max()}, 0.0f,
 		glm::vec3{std::numeric_limits<float>::lowest()}, 0.0f,
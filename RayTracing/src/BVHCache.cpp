@@ -0,0 +1,253 @@
+#include "BVHCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "Engine/Core/Log.h"
+#include "Engine/Core/MappedFile.h"
+#include "Engine/Render/MeshFile.h"
+
+namespace
+{
+
+	constexpr uint64_t fnvOffsetBasis = 0xcbf29ce484222325ull;
+	constexpr uint64_t fnvPrime = 0x100000001b3ull;
+
+	uint64_t fnv1a(const uint8_t* data, const size_t size, uint64_t hash = fnvOffsetBasis)
+	{
+		for (size_t i = 0u; i < size; i++)
+		{
+			hash ^= data[i];
+			hash *= fnvPrime;
+		}
+		return hash;
+	}
+
+	template <typename T>
+	uint64_t fnv1a(const T& value, const uint64_t hash)
+	{
+		return fnv1a(reinterpret_cast<const uint8_t*>(&value), sizeof(T), hash);
+	}
+
+	uint64_t mixWord(uint64_t hash, const uint64_t word)
+	{
+		hash = (hash ^ word) * fnvPrime;
+		return hash ^ (hash >> 32u);
+	}
+
+	// Word wide variant for large streams, four independent lanes keep the multiplies from serializing
+	uint64_t hashStream(const uint8_t* data, const size_t size, const uint64_t hash)
+	{
+		constexpr size_t laneCnt = 4u;
+		constexpr size_t blockSize = laneCnt * sizeof(uint64_t);
+
+		uint64_t lanes[laneCnt] = { hash, hash ^ 1u, hash ^ 2u, hash ^ 3u };
+		const size_t blockEnd = size / blockSize * blockSize;
+		for (size_t offset = 0u; offset < blockEnd; offset += blockSize)
+		{
+			uint64_t words[laneCnt];
+			std::memcpy(words, data + offset, blockSize);
+			for (size_t lane = 0u; lane < laneCnt; lane++)
+			{
+				lanes[lane] = mixWord(lanes[lane], words[lane]);
+			}
+		}
+
+		uint64_t combined = fnv1a(size, hash);
+		for (const uint64_t lane : lanes)
+		{
+			combined = mixWord(combined, lane);
+		}
+		return fnv1a(data + blockEnd, size - blockEnd, combined);
+	}
+
+}
+
+BVHCache::BVHCache(const std::filesystem::path& cacheDir)
+	: cacheDir{cacheDir}
+{
+}
+
+bool BVHCache::load(const RT::Mesh& mesh, const BVH::BuildMode mode, const uint32_t binCount, std::vector<BoundingBox>& hierarchy, std::vector<glm::uvec3>& triangles, std::vector<uint32_t>& order, std::vector<WideNode>& wideNodes) const
+{
+	if (loadEmbedded(mesh, mode, binCount, hierarchy, triangles, order, wideNodes))
+	{
+		return true;
+	}
+
+	const auto key = buildKey(mesh, mode, binCount);
+	if (not key)
+	{
+		return false;
+	}
+
+	const auto entryPath = getEntryPath(*key);
+	const auto entry = RT::MappedFile(entryPath);
+	if (not entry.isValid())
+	{
+		return false;
+	}
+
+	if (not readEntry({ entry.getData(), entry.getSize() }, *key, mesh.getModel(), hierarchy, triangles, order, wideNodes))
+	{
+		LOG_WARN("Ignoring stale BVH cache entry: {}", entryPath);
+		return false;
+	}
+
+	LOG_DEBUG("BVH loaded from cache: {}", entryPath);
+	return true;
+}
+
+void BVHCache::store(const RT::Mesh& mesh, const BVH::BuildMode mode, const uint32_t binCount, const std::vector<BoundingBox>& hierarchy, const std::vector<glm::uvec3>& triangles, const std::vector<uint32_t>& order, const std::vector<WideNode>& wideNodes) const
+{
+	const auto key = buildKey(mesh, mode, binCount);
+	if (not key)
+	{
+		return;
+	}
+
+	auto error = std::error_code{};
+	std::filesystem::create_directories(cacheDir, error);
+	if (error)
+	{
+		LOG_WARN("Failed to create BVH cache directory {}: {}", cacheDir, error.message());
+		return;
+	}
+
+	// Write aside and rename, so an interrupted write never leaves a truncated entry behind
+	const auto entryPath = getEntryPath(*key);
+	auto tmpPath = entryPath;
+	tmpPath += ".tmp";
+	{
+		auto file = std::ofstream(tmpPath, std::ios::binary | std::ios::trunc);
+		writeEntry(file, *key, hierarchy, triangles, order, wideNodes);
+		if (not file)
+		{
+			LOG_WARN("Failed to write BVH cache entry: {}", tmpPath);
+			return;
+		}
+	}
+
+	std::filesystem::rename(tmpPath, entryPath, error);
+	if (error)
+	{
+		LOG_WARN("Failed to store BVH cache entry {}: {}", entryPath, error.message());
+		std::filesystem::remove(tmpPath, error);
+	}
+}
+
+uint64_t BVHCache::hashBuildParams(const BVH::BuildMode mode, const uint32_t binCount, uint64_t hash)
+{
+	hash = fnv1a(BVH::maxDepth, hash);
+	hash = fnv1a(BVH::linearLeafSize, hash);
+	hash = fnv1a(BVH::spatialBins, hash);
+	hash = fnv1a(BVH::maxDuplicationRatio, hash);
+	hash = fnv1a(mode, hash);
+	hash = fnv1a(binCount, hash);
+	return hash;
+}
+
+std::vector<uint8_t> BVHCache::serialize(const BVH::BuildMode mode, const uint32_t binCount, const std::vector<BoundingBox>& hierarchy, const std::vector<glm::uvec3>& triangles, const std::vector<uint32_t>& order, const std::vector<WideNode>& wideNodes)
+{
+	auto stream = std::ostringstream{ std::ios::binary };
+	writeEntry(stream, hashBuildParams(mode, binCount, fnvOffsetBasis), hierarchy, triangles, order, wideNodes);
+	const auto entry = stream.str();
+	return std::vector<uint8_t>(entry.begin(), entry.end());
+}
+
+bool BVHCache::readEntry(std::span<const uint8_t> entry, const uint64_t key, const RT::Model& model, std::vector<BoundingBox>& hierarchy, std::vector<glm::uvec3>& triangles, std::vector<uint32_t>& order, std::vector<WideNode>& wideNodes)
+{
+	if (entry.size() < sizeof(Header))
+	{
+		return false;
+	}
+
+	const auto& header = *reinterpret_cast<const Header*>(entry.data());
+	const size_t boxesSize = sizeof(BoundingBox) * header.boxCnt;
+	const size_t trianglesSize = sizeof(glm::uvec3) * header.triangleCnt;
+	const size_t orderSize = sizeof(uint32_t) * header.triangleCnt;
+	const size_t wideNodesSize = sizeof(WideNode) * header.wideNodeCnt;
+	if (magic != header.magic or version != header.version or key != header.key
+		or entry.size() != sizeof(Header) + boxesSize + trianglesSize + orderSize + wideNodesSize)
+	{
+		return false;
+	}
+
+	const auto* boxes = reinterpret_cast<const BoundingBox*>(entry.data() + sizeof(Header));
+	const auto* tris = reinterpret_cast<const glm::uvec3*>(entry.data() + sizeof(Header) + boxesSize);
+	const auto* ids = reinterpret_cast<const uint32_t*>(entry.data() + sizeof(Header) + boxesSize + trianglesSize);
+	const auto* nodes = reinterpret_cast<const WideNode*>(entry.data() + sizeof(Header) + boxesSize + trianglesSize + orderSize);
+
+	// Spatial splits only ever add references, and every triplet has to be the mesh triangle its id names
+	const auto& meshTriangles = model.indices;
+	bool isInOrder = header.triangleCnt >= meshTriangles.size();
+	for (uint32_t i = 0u; i < header.triangleCnt and isInOrder; i++)
+	{
+		isInOrder = ids[i] < meshTriangles.size() and meshTriangles[ids[i]] == tris[i];
+	}
+	if (not isInOrder)
+	{
+		return false;
+	}
+
+	hierarchy.insert(hierarchy.end(), boxes, boxes + header.boxCnt);
+	triangles.insert(triangles.end(), tris, tris + header.triangleCnt);
+	order.insert(order.end(), ids, ids + header.triangleCnt);
+	wideNodes.insert(wideNodes.end(), nodes, nodes + header.wideNodeCnt);
+	return true;
+}
+
+void BVHCache::writeEntry(std::ostream& out, const uint64_t key, const std::vector<BoundingBox>& hierarchy, const std::vector<glm::uvec3>& triangles, const std::vector<uint32_t>& order, const std::vector<WideNode>& wideNodes)
+{
+	const auto header = Header{
+		.magic = magic,
+		.version = version,
+		.key = key,
+		.boxCnt = (uint32_t)hierarchy.size(),
+		.triangleCnt = (uint32_t)triangles.size(),
+		.wideNodeCnt = (uint32_t)wideNodes.size() };
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	out.write(reinterpret_cast<const char*>(hierarchy.data()), sizeof(BoundingBox) * hierarchy.size());
+	out.write(reinterpret_cast<const char*>(triangles.data()), sizeof(glm::uvec3) * triangles.size());
+	out.write(reinterpret_cast<const char*>(order.data()), sizeof(uint32_t) * order.size());
+	out.write(reinterpret_cast<const char*>(wideNodes.data()), sizeof(WideNode) * wideNodes.size());
+}
+
+bool BVHCache::loadEmbedded(const RT::Mesh& mesh, const BVH::BuildMode mode, const uint32_t binCount, std::vector<BoundingBox>& hierarchy, std::vector<glm::uvec3>& triangles, std::vector<uint32_t>& order, std::vector<WideNode>& wideNodes) const
+{
+	if (RT::MeshFile::fileExtension != mesh.getSourcePath().extension())
+	{
+		return false;
+	}
+
+	// A file converted with other build parameters falls through to the cache
+	const auto meshFile = RT::MeshFile(mesh.getSourcePath());
+	if (not meshFile.isValid() or not readEntry(meshFile.getExtension(), hashBuildParams(mode, binCount, fnvOffsetBasis), mesh.getModel(), hierarchy, triangles, order, wideNodes))
+	{
+		return false;
+	}
+
+	LOG_DEBUG("BVH loaded from mesh file: {}", mesh.getSourcePath());
+	return true;
+}
+
+std::optional<uint64_t> BVHCache::buildKey(const RT::Mesh& mesh, const BVH::BuildMode mode, const uint32_t binCount) const
+{
+	// Procedural meshes have no source to key on and are cheap to build anyway
+	if (mesh.getSourcePath().empty())
+	{
+		return std::nullopt;
+	}
+
+	const auto& model = mesh.getModel();
+	auto hash = hashStream(reinterpret_cast<const uint8_t*>(model.vertices.data()), sizeof(RT::Vertex) * model.vertices.size(), fnvOffsetBasis);
+	hash = hashStream(reinterpret_cast<const uint8_t*>(model.indices.data()), sizeof(glm::uvec3) * model.indices.size(), hash);
+	return hashBuildParams(mode, binCount, hash);
+}
+
+std::filesystem::path BVHCache::getEntryPath(const uint64_t key) const
+{
+	return cacheDir / fmt::format("{:016x}.bvh", key);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <filesystem>
+#include <optional>
+#include <span>
+
+#include "BVH.h"
+
+/*
+* Binary cache of built hierarchies, reordered triangle indices with the triangle each one came from
+* and wide nodes. The triangle order lets a restored hierarchy refit like a built one. Entries are keyed by a
+* hash of the loaded vertex and index streams and the BVH build parameters, so neither a changed
+* companion file nor a loader producing another vertex order can hit a stale entry. Entries are read
+* through a file mapping so they are appended to the scene buffers with a single copy.
+* A .rtmesh may carry an entry in its extension, it is preferred over the cache when its
+* build parameters match.
+*/
+class BVHCache
+{
+private:
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t boxCnt;
+		uint32_t triangleCnt;
+		uint32_t wideNodeCnt;
+		uint32_t pad;
+	};
+
+public:
+	BVHCache(const std::filesystem::path& cacheDir);
+
+	bool load(const RT::Mesh& mesh, const BVH::BuildMode mode, const uint32_t binCount, std::vector<BoundingBox>& hierarchy, std::vector<glm::uvec3>& triangles, std::vector<uint32_t>& order, std::vector<WideNode>& wideNodes) const;
+	void store(const RT::Mesh& mesh, const BVH::BuildMode mode, const uint32_t binCount, const std::vector<BoundingBox>& hierarchy, const std::vector<glm::uvec3>& triangles, const std::vector<uint32_t>& order, const std::vector<WideNode>& wideNodes) const;
+
+	// Entry for a .rtmesh extension, keyed on the build parameters only as it travels with its geometry
+	static std::vector<uint8_t> serialize(const BVH::BuildMode mode, const uint32_t binCount, const std::vector<BoundingBox>& hierarchy, const std::vector<glm::uvec3>& triangles, const std::vector<uint32_t>& order, const std::vector<WideNode>& wideNodes);
+
+private:
+	static uint64_t hashBuildParams(const BVH::BuildMode mode, const uint32_t binCount, uint64_t hash);
+	static bool readEntry(std::span<const uint8_t> entry, const uint64_t key, const RT::Model& model, std::vector<BoundingBox>& hierarchy, std::vector<glm::uvec3>& triangles, std::vector<uint32_t>& order, std::vector<WideNode>& wideNodes);
+	static void writeEntry(std::ostream& out, const uint64_t key, const std::vector<BoundingBox>& hierarchy, const std::vector<glm::uvec3>& triangles, const std::vector<uint32_t>& order, const std::vector<WideNode>& wideNodes);
+	bool loadEmbedded(const RT::Mesh& mesh, const BVH::BuildMode mode, const uint32_t binCount, std::vector<BoundingBox>& hierarchy, std::vector<glm::uvec3>& triangles, std::vector<uint32_t>& order, std::vector<WideNode>& wideNodes) const;
+	std::optional<uint64_t> buildKey(const RT::Mesh& mesh, const BVH::BuildMode mode, const uint32_t binCount) const;
+	std::filesystem::path getEntryPath(const uint64_t key) const;
+
+private:
+	const std::filesystem::path cacheDir;
+
+	static constexpr uint32_t magic = 0x48564252u; // "RBVH"
+	static constexpr uint32_t version = 5u;
+};
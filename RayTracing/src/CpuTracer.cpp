@@ -0,0 +1,865 @@
+#include "CpuTracer.h"
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <span>
+
+#include "Engine/Core/Time.h"
+#include "Engine/Core/Log.h"
+#include "Engine/Core/Assert.h"
+#include "Engine/Core/ThreadPool.h"
+
+namespace
+{
+
+	constexpr float fltMax = std::numeric_limits<float>::max();
+	constexpr double dblEps = std::numeric_limits<double>::epsilon();
+	constexpr double uintMax = 4294967295.0;
+	constexpr float pi = 3.141592653589793f;
+
+	uint32_t pcgHash(const uint32_t random)
+	{
+		const uint32_t state = random * 747796405u + 2891336453u;
+		const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		return (word >> 22u) ^ word;
+	}
+
+	float fastRandom(uint32_t& seed)
+	{
+		seed = pcgHash(seed);
+		return (float)(seed / uintMax);
+	}
+
+	glm::vec3 fastRandom3(uint32_t& seed)
+	{
+		// Separate statements keep the draw order of the shader's constructor
+		const float x = fastRandom(seed);
+		const float y = fastRandom(seed);
+		const float z = fastRandom(seed);
+		return glm::vec3{ x, y, z };
+	}
+
+	glm::vec2 randomCirclePoint(uint32_t& seed)
+	{
+		const float angle = fastRandom(seed) * 2.0f * pi;
+		const auto pointOnCircle = glm::vec2{ std::cos(angle), std::sin(angle) };
+		return pointOnCircle * std::sqrt(fastRandom(seed));
+	}
+
+	glm::vec3 randomUnitSpehere(uint32_t& seed)
+	{
+		return 2.0f * fastRandom3(seed) - 1.0f;
+	}
+
+	glm::vec2 sphericalUV(const glm::vec3 direction)
+	{
+		return glm::vec2{ std::atan2(direction.z, direction.x) / (2.0f * pi), std::asin(direction.y) / pi } + 0.5f;
+	}
+
+	bool isFaceFront(const glm::vec3 direction, const glm::vec3 surfaceNormal)
+	{
+		return glm::dot(direction, surfaceNormal) < 0.0f;
+	}
+
+	// Boxes reaching the closest hit may still hold a primitive tying it
+	bool isInRange(const float boxDistance, const float closestDistance)
+	{
+		return boxDistance < closestDistance or (boxDistance == closestDistance and boxDistance < fltMax);
+	}
+
+	// Ties go to the lower id, so the order a traversal visits primitives in never picks the hit. No hit (-1) loses every tie
+	bool isCloser(const float distance, const int32_t id, const float closestDistance, const int32_t closestId)
+	{
+		return distance < closestDistance or (distance == closestDistance and distance < fltMax and (uint32_t)id < (uint32_t)closestId);
+	}
+
+	// Instances tie on their id first, spheres carry instance -1
+	bool isCloserHit(const float distance, const int32_t instance, const int32_t object, const float closestDistance, const int32_t closestInstance, const int32_t closestObject)
+	{
+		return instance == closestInstance ? isCloser(distance, object, closestDistance, closestObject) : isCloser(distance, instance, closestDistance, closestInstance);
+	}
+
+}
+
+CpuTracer::CpuTracer(const RT::Scene& scene, const SceneWrapper& sceneWrapper)
+	: scene{scene}
+	, sceneWrapper{sceneWrapper}
+{
+}
+
+void CpuTracer::loadTextures(const std::vector<std::filesystem::path>& texturePaths, const std::filesystem::path& skyMapPath)
+{
+	textures.clear();
+	textures.reserve(texturePaths.size());
+	for (const auto& path : texturePaths)
+	{
+		textures.emplace_back(path);
+	}
+	skyMap = RT::Image{ skyMapPath, RT::Texture::Filter::Linear, RT::Texture::Mode::ClampToEdge };
+}
+
+void CpuTracer::resize(const glm::uvec2 resolution)
+{
+	accumulation = RT::Image{ resolution };
+	frameIndex = 0u;
+}
+
+CpuTracer::Stats CpuTracer::render(const RT::Camera::Spec& camera, const Settings& settings)
+{
+	auto timer = RT::Timer{};
+	frameIndex++;
+
+	const auto resolution = accumulation.getSize();
+	const auto tileCnt = (resolution + tileSize - 1u) / tileSize;
+	auto rayCnt = std::atomic<uint64_t>{ 0u };
+
+	RT::ThreadPool::get().parallelFor(0u, tileCnt.x * tileCnt.y, 1u, [&](const uint32_t tile)
+	{
+		const auto tileMin = glm::uvec2{ tile % tileCnt.x, tile / tileCnt.x } * tileSize;
+		const auto tileMax = glm::min(tileMin + tileSize, resolution);
+
+		uint64_t tileRayCnt = 0u;
+		for (uint32_t y = tileMin.y; y < tileMax.y; y++)
+		{
+			for (uint32_t x = tileMin.x; x < tileMax.x; x++)
+			{
+				auto incomingLight = renderPixel(glm::uvec2{ x, y }, camera, settings, tileRayCnt);
+				if (1u != frameIndex)
+				{
+					incomingLight += glm::vec3{ accumulation.at(x, y) };
+				}
+				accumulation.at(x, y) = glm::vec4{ incomingLight, 1.0f };
+			}
+		}
+		rayCnt.fetch_add(tileRayCnt, std::memory_order_relaxed);
+	});
+
+	const auto stats = Stats{ rayCnt.load(), timer.Ellapsed() };
+	return stats;
+}
+
+CpuTracer::Stats CpuTracer::renderWavefront(const RT::Camera::Spec& camera, const Settings& settings, const Traversal traversal)
+{
+	auto timer = RT::Timer{};
+	frameIndex++;
+
+	const auto resolution = accumulation.getSize();
+	const uint32_t pixelCnt = resolution.x * resolution.y;
+	auto& threadPool = RT::ThreadPool::get();
+
+	auto stats = Stats{};
+	stats.bounces.resize(settings.maxBounces);
+
+	auto paths = std::vector<Path>(pixelCnt);
+	auto incomingLight = std::vector<glm::vec3>(pixelCnt, glm::vec3{ 0.0f });
+	auto activePaths = std::vector<uint32_t>{};
+	auto isAlive = std::vector<uint8_t>{};
+	auto stream = RayStream{};
+
+	for (uint32_t frame = 1u; frame <= settings.maxFrames; frame++)
+	{
+		threadPool.parallelFor(0u, pixelCnt, streamChunkSize, [&](const uint32_t pixelIdx)
+		{
+			const auto index = glm::uvec2{ pixelIdx % resolution.x, pixelIdx / resolution.x };
+			auto& path = paths[pixelIdx];
+			path.seed = pixelSeed(index, frame);
+			path.ray = cameraRay(index, camera, path.seed);
+			path.pixel = Pixel{ glm::vec3{ 0.0f }, glm::vec3{ 1.0f } };
+		});
+
+		activePaths.resize(pixelCnt);
+		std::iota(activePaths.begin(), activePaths.end(), 0u);
+
+		for (uint32_t bounce = 0u; bounce < settings.maxBounces and not activePaths.empty(); bounce++)
+		{
+			auto& bounceStats = stats.bounces[bounce];
+			const uint32_t rayCnt = activePaths.size();
+
+			stream.resize(rayCnt);
+			threadPool.parallelFor(0u, rayCnt, streamChunkSize, [&](const uint32_t rayIdx)
+			{
+				auto& path = paths[activePaths[rayIdx]];
+				path.seed += bounce;
+				stream.setRay(rayIdx, path.ray.origin, path.ray.direction, activePaths[rayIdx]);
+			});
+
+			auto sortTimer = RT::Timer{};
+			if (Traversal::Stream == traversal)
+			{
+				stream.sort();
+				bounceStats.sortTime += sortTimer.Ellapsed();
+			}
+			else
+			{
+				stream.resetHits();
+			}
+
+			auto traceTimer = RT::Timer{};
+			if (Traversal::Stream == traversal)
+			{
+				const uint32_t chunkCnt = (rayCnt + streamChunkSize - 1u) / streamChunkSize;
+				threadPool.parallelFor(0u, chunkCnt, 1u, [&](const uint32_t chunk)
+				{
+					const uint32_t first = chunk * streamChunkSize;
+					traceStream(stream, glm::uvec2{ first, std::min(first + streamChunkSize, rayCnt) });
+				});
+			}
+			else
+			{
+				threadPool.parallelFor(0u, rayCnt, streamChunkSize, [&](const uint32_t rayIdx)
+				{
+					const auto hit = closestIntersection(Ray{ stream.getOrigin(rayIdx), stream.getDirection(rayIdx) });
+					stream.hitDistance[rayIdx] = hit.distance;
+					stream.hitInstance[rayIdx] = hit.instance;
+					stream.hitObject[rayIdx] = hit.object;
+				});
+			}
+			bounceStats.traceTime += traceTimer.Ellapsed();
+			bounceStats.rayCnt += rayCnt;
+
+			isAlive.resize(rayCnt);
+			threadPool.parallelFor(0u, rayCnt, streamChunkSize, [&](const uint32_t rayIdx)
+			{
+				auto& path = paths[stream.pathIds[rayIdx]];
+				if (-1 == stream.hitObject[rayIdx])
+				{
+					path.pixel.color += getSkyColor(path.ray) * path.pixel.contribution * settings.drawEnvironment;
+					isAlive[rayIdx] = 0u;
+					return;
+				}
+
+				const auto payload = closestHit(path.ray, stream.hitDistance[rayIdx], stream.hitObject[rayIdx], stream.hitInstance[rayIdx]);
+				scatter(path.ray, payload, path.pixel, settings, path.seed);
+				isAlive[rayIdx] = 1u;
+			});
+
+			// Surviving paths keep the stream order, so the next bounce starts out nearly sorted
+			activePaths.clear();
+			for (uint32_t rayIdx = 0u; rayIdx < rayCnt; rayIdx++)
+			{
+				if (isAlive[rayIdx])
+				{
+					activePaths.push_back(stream.pathIds[rayIdx]);
+				}
+			}
+		}
+
+		for (uint32_t pixelIdx = 0u; pixelIdx < pixelCnt; pixelIdx++)
+		{
+			incomingLight[pixelIdx] += paths[pixelIdx].pixel.color;
+		}
+	}
+
+	for (uint32_t pixelIdx = 0u; pixelIdx < pixelCnt; pixelIdx++)
+	{
+		const uint32_t x = pixelIdx % resolution.x;
+		const uint32_t y = pixelIdx / resolution.x;
+
+		auto pixelLight = incomingLight[pixelIdx] / (float)settings.maxFrames;
+		if (1u != frameIndex)
+		{
+			pixelLight += glm::vec3{ accumulation.at(x, y) };
+		}
+		accumulation.at(x, y) = glm::vec4{ pixelLight, 1.0f };
+	}
+
+	for (const auto& bounceStats : stats.bounces)
+	{
+		stats.rayCnt += bounceStats.rayCnt;
+	}
+	stats.renderTime = timer.Ellapsed();
+	return stats;
+}
+
+RT::Image CpuTracer::resolve() const
+{
+	auto image = RT::Image{ accumulation.getSize() };
+	const float frameCnt = (float)std::max(frameIndex, 1u);
+	for (uint32_t y = 0u; y < image.getSize().y; y++)
+	{
+		for (uint32_t x = 0u; x < image.getSize().x; x++)
+		{
+			image.at(x, y) = glm::vec4{ glm::vec3{ accumulation.at(x, y) } / frameCnt, 1.0f };
+		}
+	}
+	return image;
+}
+
+glm::vec3 CpuTracer::renderPixel(const glm::uvec2 index, const RT::Camera::Spec& camera, const Settings& settings, uint64_t& rayCnt) const
+{
+	auto incomingLight = glm::vec3{ 0.0f };
+	for (uint32_t frame = 1u; frame <= settings.maxFrames; frame++)
+	{
+		uint32_t seed = pixelSeed(index, frame);
+		const auto ray = cameraRay(index, camera, seed);
+		incomingLight += traceRay(ray, settings, seed, rayCnt);
+	}
+
+	return incomingLight / (float)settings.maxFrames;
+}
+
+uint32_t CpuTracer::pixelSeed(const glm::uvec2 index, const uint32_t frame) const
+{
+	const auto resolution = glm::vec2{ accumulation.getSize() };
+	return (uint32_t)(index.y * resolution.x + index.x) + frame * frameIndex * 735529u;
+}
+
+CpuTracer::Ray CpuTracer::cameraRay(const glm::uvec2 index, const RT::Camera::Spec& camera, uint32_t& seed) const
+{
+	const auto resolution = glm::vec2{ accumulation.getSize() };
+	const auto rightVec = glm::vec3{ camera.invView[0] };
+	const auto upVec = glm::vec3{ camera.invView[1] };
+
+	const auto pixelCoord = glm::vec2{ index } / resolution;
+	const auto coord = camera.invProjection * (2.0f * glm::vec4{ pixelCoord, 1.0f, 1.0f } - 1.0f);
+
+	const auto direction = glm::vec3{ camera.invView * glm::vec4{ glm::vec3{ coord } / coord.w, 0.0f } } * camera.focusDistance;
+	const auto focusPoint = camera.position + direction;
+
+	const auto focusJitter = randomCirclePoint(seed) / resolution * camera.defocusStrength;
+	const auto deviationJitter = randomCirclePoint(seed) / resolution * camera.blurStrength;
+
+	const auto deviationJitterFocusPoint = focusPoint + deviationJitter.x * rightVec + deviationJitter.y * upVec;
+
+	auto ray = Ray{};
+	ray.origin = camera.position + focusJitter.x * rightVec + focusJitter.y * upVec;
+	ray.direction = glm::normalize(deviationJitterFocusPoint - ray.origin);
+	return ray;
+}
+
+glm::vec3 CpuTracer::traceRay(Ray ray, const Settings& settings, uint32_t& seed, uint64_t& rayCnt) const
+{
+	auto pixel = Pixel{ glm::vec3{ 0.0f }, glm::vec3{ 1.0f } };
+
+	for (uint32_t i = 0u; i < settings.maxBounces; i++)
+	{
+		seed += i;
+
+		const auto payload = bounceRay(ray);
+		rayCnt++;
+
+		if (-1 == payload.hitObject)
+		{
+			pixel.color += getSkyColor(ray) * pixel.contribution * settings.drawEnvironment;
+			break;
+		}
+
+		scatter(ray, payload, pixel, settings, seed);
+	}
+
+	return pixel.color;
+}
+
+CpuTracer::Payload CpuTracer::bounceRay(const Ray& ray) const
+{
+	const auto hit = closestIntersection(ray);
+	if (-1 == hit.object)
+	{
+		return Payload{ glm::vec3{ 0.0f }, glm::vec3{ 0.0f }, glm::vec2{ 0.0f }, fltMax, -1, -1 };
+	}
+
+	return closestHit(ray, hit.distance, hit.object, hit.instance);
+}
+
+CpuTracer::SceneHit CpuTracer::closestIntersection(const Ray& ray) const
+{
+	float closestDistance = fltMax;
+	int32_t closestInstance = -1;
+	int32_t closestObject = -1;
+
+	const auto& instanceBoxes = sceneWrapper.instanceBoxes;
+	const auto& instanceIndices = sceneWrapper.instanceIndices;
+
+	static_assert(instanceStackDepth >= BVH::maxDepth + 2u, "instance stack overflows on a maximally deep TLAS");
+	auto stack = std::array<uint32_t, instanceStackDepth>{};
+	uint32_t stackIdx = 0u;
+
+	const bool hasPrimitives = not sceneWrapper.meshInstanceWrappers.empty() or not sceneWrapper.spheres.empty();
+	if (hasPrimitives and not instanceBoxes.empty() and isInRange(hitBox(ray, instanceBoxes[0]), closestDistance))
+	{
+		stack[stackIdx++] = 0u;
+	}
+
+	while (stackIdx > 0u)
+	{
+		const auto& box = instanceBoxes[stack[--stackIdx]];
+
+		const bool isLeaf = box.bufferRegion.y > 0u;
+		if (isLeaf)
+		{
+			for (uint32_t instanceIdx = box.bufferRegion.x; instanceIdx < box.bufferRegion.y; instanceIdx++)
+			{
+				const uint32_t entry = instanceIndices[instanceIdx];
+				if (0u != (entry & SceneWrapper::sphereFlag))
+				{
+					const int32_t sphereId = entry & ~SceneWrapper::sphereFlag;
+					const float sphereDist = sphereHit(ray, sceneWrapper.spheres[sphereId]);
+					if (isCloserHit(sphereDist, -1, sphereId, closestDistance, closestInstance, closestObject))
+					{
+						closestDistance = sphereDist;
+						closestInstance = -1;
+						closestObject = sphereId;
+					}
+					continue;
+				}
+
+				const int32_t objectId = entry;
+				const auto& object = sceneWrapper.meshInstanceWrappers[objectId];
+				const auto& mesh = sceneWrapper.meshWrappers[object.meshId];
+
+				auto modelRay = Ray{};
+				modelRay.origin = glm::vec3{ object.worldToLocalMatrix * glm::vec4{ ray.origin, 1.0f } };
+				modelRay.direction = glm::vec3{ object.worldToLocalMatrix * glm::vec4{ ray.direction, 0.0f } };
+
+				const auto meshHit = bvhTraverse(modelRay, mesh.bvhRoot, mesh.modelRoot, mesh.vertexRoot);
+				if (-1 != meshHit.triangleId and isCloserHit(meshHit.distance, objectId, meshHit.triangleId, closestDistance, closestInstance, closestObject))
+				{
+					closestDistance = meshHit.distance;
+					closestInstance = objectId;
+					closestObject = meshHit.triangleId;
+				}
+			}
+		}
+		else
+		{
+			const uint32_t leftChildIdx = box.bufferRegion.x + 0u;
+			const uint32_t rightChildIdx = box.bufferRegion.x + 1u;
+
+			const float leftDist = hitBox(ray, instanceBoxes[leftChildIdx]);
+			const float rightDist = hitBox(ray, instanceBoxes[rightChildIdx]);
+
+			const bool isLeftClosest = leftDist < rightDist;
+
+			const uint32_t nearIdx = isLeftClosest ? leftChildIdx : rightChildIdx;
+			const uint32_t farIdx = isLeftClosest ? rightChildIdx : leftChildIdx;
+			const float nearDist = isLeftClosest ? leftDist : rightDist;
+			const float farDist = isLeftClosest ? rightDist : leftDist;
+
+			if (isInRange(farDist, closestDistance))
+			{
+				stack[stackIdx++] = farIdx;
+			}
+			if (isInRange(nearDist, closestDistance))
+			{
+				stack[stackIdx++] = nearIdx;
+			}
+		}
+	}
+
+	return SceneHit{ closestDistance, closestInstance, closestObject };
+}
+
+CpuTracer::HitInfo CpuTracer::bvhTraverse(const Ray& ray, const uint32_t bvhRoot, const uint32_t modelRoot, const uint32_t vertexRoot) const
+{
+	auto hitInfo = HitInfo{ fltMax, -1 };
+
+	const auto& nodes = sceneWrapper.wideNodes;
+	const auto* vertices = sceneWrapper.vertexPositions.data() + vertexRoot;
+	if (not (hitBox(ray, decodeFrame(nodes[bvhRoot])) < fltMax))
+	{
+		return hitInfo;
+	}
+
+	auto stack = std::array<uint32_t, meshStackDepth>{};
+	uint32_t stackIdx = 0u;
+	stack[stackIdx++] = 0u;
+
+	while (stackIdx > 0u)
+	{
+		const auto& node = nodes[bvhRoot + stack[--stackIdx]];
+		const uint8_t childCnt = node.scale >> 24u;
+
+		auto innerIdx = std::array<uint32_t, WideNode::width>{};
+		auto innerDist = std::array<float, WideNode::width>{};
+		uint32_t innerCnt = 0u;
+
+		for (uint8_t child = 0u; child < childCnt; child++)
+		{
+			const float childDist = hitBox(ray, BVH::decodeChild(node, child));
+			if (not isInRange(childDist, hitInfo.distance))
+			{
+				continue;
+			}
+
+			const uint32_t triangleCnt = (node.counts[child >> 1u] >> (16u * (child & 1u))) & 0xFFFFu;
+			if (0u == triangleCnt)
+			{
+				// Insertion sort, farthest first, so the nearest child is popped next
+				uint32_t slot = innerCnt;
+				while (slot > 0u and innerDist[slot - 1u] < childDist)
+				{
+					innerIdx[slot] = innerIdx[slot - 1u];
+					innerDist[slot] = innerDist[slot - 1u];
+					slot--;
+				}
+				innerIdx[slot] = node.children[child];
+				innerDist[slot] = childDist;
+				innerCnt++;
+				continue;
+			}
+
+			const uint32_t firstTriangle = modelRoot + node.children[child];
+			for (uint32_t triangleId = firstTriangle; triangleId < firstTriangle + triangleCnt; triangleId++)
+			{
+				const auto& triangle = sceneWrapper.triangleIndices[triangleId];
+				const float triDist = triangleHit(ray, vertices[triangle.x].position, vertices[triangle.y].position, vertices[triangle.z].position);
+				if (isCloser(triDist, triangleId, hitInfo.distance, hitInfo.triangleId))
+				{
+					hitInfo.distance = triDist;
+					hitInfo.triangleId = triangleId;
+				}
+			}
+		}
+
+		ASSERT(stackIdx + innerCnt <= meshStackDepth, "Mesh BVH {} is deeper than its traversal stack!", bvhRoot);
+		for (uint32_t inner = 0u; inner < innerCnt; inner++)
+		{
+			if (isInRange(innerDist[inner], hitInfo.distance))
+			{
+				stack[stackIdx++] = innerIdx[inner];
+			}
+		}
+	}
+
+	return hitInfo;
+}
+
+CpuTracer::Payload CpuTracer::closestHit(const Ray& ray, const float closestDistance, const int32_t closestObject, const int32_t closestInstance) const
+{
+	auto payload = Payload{};
+	payload.hitPosition = ray.origin + closestDistance * ray.direction;
+	payload.hitDistance = closestDistance;
+	payload.hitObject = closestObject;
+
+	if (-1 == closestInstance)
+	{
+		const auto& sphere = sceneWrapper.spheres[closestObject];
+		payload.hitNormal = glm::normalize(payload.hitPosition - sphere.position);
+		payload.hitUV = sphericalUV(payload.hitNormal);
+		payload.hitMaterial = sphere.materialId;
+		return payload;
+	}
+
+	const auto& object = sceneWrapper.meshInstanceWrappers[closestInstance];
+	const auto& mesh = sceneWrapper.meshWrappers[object.meshId];
+	const auto& triangle = sceneWrapper.triangleIndices[closestObject];
+	const auto* vertices = sceneWrapper.vertexPositions.data() + mesh.vertexRoot;
+	const auto* uvs = sceneWrapper.vertexUVs.data() + mesh.vertexRoot;
+
+	const auto& A = vertices[triangle.x].position;
+	const auto edgeAB = vertices[triangle.y].position - A;
+	const auto edgeAC = vertices[triangle.z].position - A;
+	const auto normalVec = glm::cross(edgeAB, edgeAC);
+	payload.hitNormal = glm::normalize(glm::vec3{ glm::inverse(object.worldToLocalMatrix) * glm::vec4{ normalVec, 0.0f } });
+
+	const auto ao = ray.origin - A;
+	const auto dao = glm::cross(ao, ray.direction);
+	const float determinant = -glm::dot(ray.direction, normalVec);
+	const float invDet = 1.0f / determinant;
+	const float u = glm::dot(edgeAC, dao) * invDet;
+	const float v = -glm::dot(edgeAB, dao) * invDet;
+	const float w = 1.0f - u - v;
+
+	payload.hitUV = uvs[triangle.x] * w + uvs[triangle.y] * u + uvs[triangle.z] * v;
+	payload.hitMaterial = object.materialId;
+	return payload;
+}
+
+void CpuTracer::traceStream(RayStream& stream, const glm::uvec2 streamRegion) const
+{
+	const bool hasPrimitives = not sceneWrapper.meshInstanceWrappers.empty() or not sceneWrapper.spheres.empty();
+	if (not hasPrimitives or sceneWrapper.instanceBoxes.empty())
+	{
+		return;
+	}
+
+	auto active = std::vector<uint32_t>(streamRegion.y - streamRegion.x);
+	std::iota(active.begin(), active.end(), streamRegion.x);
+
+	auto modelRays = RayStream{};
+	auto modelActive = std::vector<uint32_t>{};
+
+	traverseStream(stream, sceneWrapper.instanceBoxes.data(), active, [&](const glm::uvec2 leafRegion, const std::span<const uint32_t> rays)
+	{
+		for (uint32_t instanceIdx = leafRegion.x; instanceIdx < leafRegion.y; instanceIdx++)
+		{
+			const uint32_t entry = sceneWrapper.instanceIndices[instanceIdx];
+			if (0u != (entry & SceneWrapper::sphereFlag))
+			{
+				const int32_t sphereId = entry & ~SceneWrapper::sphereFlag;
+				for (const uint32_t rayIdx : rays)
+				{
+					const float sphereDist = sphereHit(Ray{ stream.getOrigin(rayIdx), stream.getDirection(rayIdx) }, sceneWrapper.spheres[sphereId]);
+					if (isCloserHit(sphereDist, -1, sphereId, stream.hitDistance[rayIdx], stream.hitInstance[rayIdx], stream.hitObject[rayIdx]))
+					{
+						stream.hitDistance[rayIdx] = sphereDist;
+						stream.hitInstance[rayIdx] = -1;
+						stream.hitObject[rayIdx] = sphereId;
+					}
+				}
+				continue;
+			}
+
+			const int32_t objectId = entry;
+			const auto& object = sceneWrapper.meshInstanceWrappers[objectId];
+			const auto& mesh = sceneWrapper.meshWrappers[object.meshId];
+
+			// Model space copies remember their stream slot in the path id. They start out without a hit at the closest
+			// distance so far, so triangles tying another instance are kept and settled when merging back below
+			modelRays.resize(rays.size());
+			for (uint32_t modelIdx = 0u; modelIdx < rays.size(); modelIdx++)
+			{
+				const uint32_t rayIdx = rays[modelIdx];
+				const auto origin = glm::vec3{ object.worldToLocalMatrix * glm::vec4{ stream.getOrigin(rayIdx), 1.0f } };
+				const auto direction = glm::vec3{ object.worldToLocalMatrix * glm::vec4{ stream.getDirection(rayIdx), 0.0f } };
+				modelRays.setRay(modelIdx, origin, direction, rayIdx);
+				modelRays.hitDistance[modelIdx] = stream.hitDistance[rayIdx];
+				modelRays.hitObject[modelIdx] = -1;
+			}
+
+			modelActive.resize(rays.size());
+			std::iota(modelActive.begin(), modelActive.end(), 0u);
+			const auto* vertices = sceneWrapper.vertexPositions.data() + mesh.vertexRoot;
+			traverseStream(modelRays, sceneWrapper.boundingBoxes.data() + mesh.boxesRoot, modelActive, [&](const glm::uvec2 triangleRegion, const std::span<const uint32_t> modelRayIds)
+			{
+				for (uint32_t triangleId = mesh.modelRoot + triangleRegion.x; triangleId < mesh.modelRoot + triangleRegion.y; triangleId++)
+				{
+					const auto& triangle = sceneWrapper.triangleIndices[triangleId];
+					const auto& A = vertices[triangle.x].position;
+					const auto& B = vertices[triangle.y].position;
+					const auto& C = vertices[triangle.z].position;
+					for (const uint32_t modelIdx : modelRayIds)
+					{
+						const float triDist = triangleHit(Ray{ modelRays.getOrigin(modelIdx), modelRays.getDirection(modelIdx) }, A, B, C);
+						if (isCloser(triDist, triangleId, modelRays.hitDistance[modelIdx], modelRays.hitObject[modelIdx]))
+						{
+							modelRays.hitDistance[modelIdx] = triDist;
+							modelRays.hitObject[modelIdx] = triangleId;
+						}
+					}
+				}
+			});
+
+			for (uint32_t modelIdx = 0u; modelIdx < rays.size(); modelIdx++)
+			{
+				const uint32_t rayIdx = modelRays.pathIds[modelIdx];
+				if (-1 != modelRays.hitObject[modelIdx]
+					and isCloserHit(modelRays.hitDistance[modelIdx], objectId, modelRays.hitObject[modelIdx], stream.hitDistance[rayIdx], stream.hitInstance[rayIdx], stream.hitObject[rayIdx]))
+				{
+					stream.hitDistance[rayIdx] = modelRays.hitDistance[modelIdx];
+					stream.hitInstance[rayIdx] = objectId;
+					stream.hitObject[rayIdx] = modelRays.hitObject[modelIdx];
+				}
+			}
+		}
+	});
+}
+
+template <typename LeafFunc>
+void CpuTracer::traverseStream(const RayStream& rays, const BoundingBox* hierarchy, std::vector<uint32_t>& active, LeafFunc&& testLeaf) const
+{
+	auto stack = std::array<StreamTask, meshStackDepth>{};
+	uint32_t stackIdx = 0u;
+	stack[stackIdx++] = StreamTask{ 0u, glm::uvec2{ 0u, active.size() } };
+
+	while (stackIdx > 0u)
+	{
+		const auto task = stack[--stackIdx];
+		const auto& box = hierarchy[task.node];
+
+		// Every node filters the rays of its parent into a new segment. Segments above the
+		// parent's belong to subtrees that are already finished and are dropped first
+		active.resize(task.rays.y);
+		for (uint32_t i = task.rays.x; i < task.rays.y; i++)
+		{
+			const uint32_t rayIdx = active[i];
+			if (isInRange(hitBox(Ray{ rays.getOrigin(rayIdx), rays.getDirection(rayIdx) }, box), rays.hitDistance[rayIdx]))
+			{
+				active.push_back(rayIdx);
+			}
+		}
+
+		const auto hitRays = glm::uvec2{ task.rays.y, active.size() };
+		if (hitRays.x == hitRays.y)
+		{
+			continue;
+		}
+
+		const bool isLeaf = box.bufferRegion.y > 0u;
+		if (isLeaf)
+		{
+			testLeaf(box.bufferRegion, std::span<const uint32_t>(active).subspan(hitRays.x, hitRays.y - hitRays.x));
+			continue;
+		}
+
+		// The whole segment descends in one order, picked by its first ray against the child centers
+		const uint32_t leftChildIdx = box.bufferRegion.x + 0u;
+		const uint32_t rightChildIdx = box.bufferRegion.x + 1u;
+		const auto& left = hierarchy[leftChildIdx];
+		const auto& right = hierarchy[rightChildIdx];
+		const auto centerOffset = (right.vMin + right.vMax) - (left.vMin + left.vMax);
+
+		const bool isLeftClosest = glm::dot(rays.getDirection(active[hitRays.x]), centerOffset) > 0.0f;
+		stack[stackIdx++] = StreamTask{ isLeftClosest ? rightChildIdx : leftChildIdx, hitRays };
+		stack[stackIdx++] = StreamTask{ isLeftClosest ? leftChildIdx : rightChildIdx, hitRays };
+	}
+}
+
+void CpuTracer::scatter(Ray& ray, const Payload& payload, Pixel& pixel, const Settings& settings, uint32_t& seed) const
+{
+	if (scene.materials[payload.hitMaterial].refractionRatio > 1.0f)
+	{
+		refractRay(ray, payload, seed);
+	}
+	else
+	{
+		reflectRay(ray, payload, seed);
+	}
+
+	accumulateColor(pixel, payload, settings);
+}
+
+void CpuTracer::refractRay(Ray& ray, const Payload& payload, uint32_t& seed) const
+{
+	const float refractionRatio = scene.materials[payload.hitMaterial].refractionRatio;
+	const bool isFront = isFaceFront(ray.direction, payload.hitNormal);
+
+	const float rt = isFront ? 1.0f / refractionRatio : refractionRatio;
+	const auto hitNormal = isFront ? payload.hitNormal : -payload.hitNormal;
+
+	// Schlick's approximation decides between reflection and refraction
+	const float cosTheta = std::min(glm::dot(-ray.direction, hitNormal), 1.0f);
+	const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+
+	const bool cannotRefract = rt * sinTheta > 1.0f;
+
+	float r0 = (1.0f - rt) / (1.0f + rt);
+	r0 = r0 * r0;
+	const float r0p = r0 + (1.0f - r0) * std::pow(1.0f - cosTheta, 5.0f);
+
+	const bool refractChance = r0p > fastRandom(seed);
+
+	if (cannotRefract or refractChance)
+	{
+		ray.origin = payload.hitPosition + hitNormal * hitOffset;
+		ray.direction = glm::reflect(ray.direction, hitNormal);
+	}
+	else
+	{
+		ray.origin = payload.hitPosition - hitNormal * hitOffset;
+		ray.direction = glm::refract(ray.direction, hitNormal, rt);
+	}
+}
+
+void CpuTracer::reflectRay(Ray& ray, const Payload& payload, uint32_t& seed) const
+{
+	const auto& material = scene.materials[payload.hitMaterial];
+	ray.origin = payload.hitPosition + payload.hitNormal * hitOffset;
+
+	const auto diffuseDir = glm::normalize(payload.hitNormal + randomUnitSpehere(seed));
+	const auto specularDir = glm::normalize(glm::reflect(ray.direction, payload.hitNormal) + randomUnitSpehere(seed) * (1.0f - material.metalic));
+
+	ray.direction = glm::normalize(glm::mix(diffuseDir, specularDir, material.roughness));
+}
+
+void CpuTracer::accumulateColor(Pixel& pixel, const Payload& payload, const Settings& settings) const
+{
+	const auto& material = scene.materials[payload.hitMaterial];
+
+	if (1u == settings.maxBounces)
+	{
+		// Argument order follows the shader, which makes the fake light cap at 0.5
+		const auto lightDir = glm::normalize(glm::vec3{ -1.0f, -1.0f, -1.0f });
+		pixel.color = material.albedo * (glm::clamp(0.0f, 0.5f, glm::dot(-payload.hitNormal, lightDir)) + 0.5f);
+		return;
+	}
+
+	auto albedo = glm::vec3{ 0.0f };
+	if (-1 != material.textureId)
+	{
+		if (material.textureId < (int32_t)textures.size())
+		{
+			albedo = glm::vec3{ textures[material.textureId].sample(payload.hitUV) };
+		}
+		pixel.color += albedo * material.emissionPower * pixel.contribution;
+	}
+	else
+	{
+		pixel.color += material.emissionColor * material.emissionPower * pixel.contribution;
+		albedo = material.albedo;
+	}
+	pixel.contribution *= albedo;
+}
+
+glm::vec3 CpuTracer::getSkyColor(const Ray& ray) const
+{
+	return glm::vec3{ skyMap.sample(sphericalUV(ray.direction)) };
+}
+
+float CpuTracer::triangleHit(const Ray& ray, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C)
+{
+	const auto direction = glm::dvec3{ ray.direction };
+	const auto edgeAB = glm::dvec3{ B } - glm::dvec3{ A };
+	const auto edgeAC = glm::dvec3{ C } - glm::dvec3{ A };
+	const auto ao = glm::dvec3{ ray.origin } - glm::dvec3{ A };
+	const auto normalVec = glm::cross(edgeAB, edgeAC);
+	const auto dao = glm::cross(ao, direction);
+
+	const double determinant = -glm::dot(direction, normalVec);
+	const double invDet = 1.0 / determinant;
+
+	const double t = glm::dot(ao, normalVec) * invDet;
+	const double u = glm::dot(edgeAC, dao) * invDet;
+	const double v = -glm::dot(edgeAB, dao) * invDet;
+	const double w = 1.0 - u - v;
+
+	const bool didHit = determinant > dblEps and t >= 0.0 and u >= 0.0 and v >= 0.0 and w >= 0.0;
+	return didHit ? (float)t : fltMax;
+}
+
+float CpuTracer::sphereHit(const Ray& ray, const Sphere& sphere)
+{
+	const auto origin = ray.origin - sphere.position;
+
+	const float a = glm::dot(ray.direction, ray.direction);
+	const float b = 2.0f * glm::dot(origin, ray.direction);
+	const float c = glm::dot(origin, origin) - sphere.radius * sphere.radius;
+	const float delta = b * b - 4.0f * a * c;
+
+	if (delta < 0.0f)
+	{
+		return fltMax;
+	}
+
+	const float closestT = (-b - std::sqrt(delta)) / (2.0f * a);
+	return closestT < 0.0f ? fltMax : closestT;
+}
+
+float CpuTracer::hitBox(const Ray& ray, const BoundingBox& box)
+{
+	const auto lbf = (box.vMin - ray.origin) / ray.direction;
+	const auto rtb = (box.vMax - ray.origin) / ray.direction;
+
+	const auto tMin = glm::min(lbf, rtb);
+	const auto tMax = glm::max(lbf, rtb);
+
+	const float tNear = std::max(std::max(tMin.x, tMin.y), tMin.z);
+	const float tFar = std::min(std::min(tMax.x, tMax.y), tMax.z);
+
+	const bool didHit = 0.0f <= tFar and tNear <= tFar;
+	return didHit ? tNear : fltMax;
+}
+
+BoundingBox CpuTracer::decodeFrame(const WideNode& node)
+{
+	auto box = BoundingBox{};
+	box.vMin = node.origin;
+	for (uint8_t axis = 0u; axis < 3u; axis++)
+	{
+		const float scale = glm::uintBitsToFloat(((node.scale >> (8u * axis)) & 0xFFu) << 23u);
+		box.vMax[axis] = node.origin[axis] + 255.0f * scale;
+	}
+	return box;
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+
+#include "RayStream.h"
+#include "SceneWrapper.h"
+
+#include "Engine/Render/Camera.h"
+#include "Engine/Render/Image.h"
+
+/*
+* Reference path tracer running on the host. Follows RayTracing.shader step for step
+* over the same SceneWrapper buffers and seeds, so GPU frames can be checked against it
+* and scenes can be rendered without a device. Tiles are spread over the ThreadPool.
+*/
+class CpuTracer
+{
+public:
+	enum class Traversal : uint8_t { SingleRay, Stream };
+
+	struct Settings
+	{
+		float drawEnvironment = 0.0f;
+		uint32_t maxBounces = 1u;
+		uint32_t maxFrames = 1u;
+	};
+
+	struct BounceStats
+	{
+		uint64_t rayCnt = 0u;
+		float sortTime = 0.0f;
+		float traceTime = 0.0f;
+
+		float mraysPerSecond() const { return sortTime + traceTime > 0.0f ? rayCnt / ((sortTime + traceTime) * 1e3f) : 0.0f; }
+	};
+
+	struct Stats
+	{
+		uint64_t rayCnt = 0u;
+		float renderTime = 0.0f;
+		std::vector<BounceStats> bounces = {};	// only filled by wavefront renders
+
+		float mraysPerSecond() const { return renderTime > 0.0f ? rayCnt / (renderTime * 1e3f) : 0.0f; }
+	};
+
+private:
+	struct Ray
+	{
+		glm::vec3 origin;
+		glm::vec3 direction;
+	};
+
+	struct Payload
+	{
+		glm::vec3 hitPosition;
+		glm::vec3 hitNormal;
+		glm::vec2 hitUV;
+		float hitDistance;
+		int32_t hitObject;
+		int32_t hitMaterial;
+	};
+
+	struct HitInfo
+	{
+		float distance;
+		int32_t triangleId;
+	};
+
+	struct SceneHit
+	{
+		float distance;
+		int32_t instance;
+		int32_t object;
+	};
+
+	struct StreamTask
+	{
+		uint32_t node;
+		glm::uvec2 rays;	// region of the active ray list
+	};
+
+	struct Pixel
+	{
+		glm::vec3 color;
+		glm::vec3 contribution;
+	};
+
+	struct Path
+	{
+		Ray ray;
+		Pixel pixel;
+		uint32_t seed;
+	};
+
+public:
+	CpuTracer(const RT::Scene& scene, const SceneWrapper& sceneWrapper);
+	~CpuTracer() = default;
+
+	void loadTextures(const std::vector<std::filesystem::path>& texturePaths, const std::filesystem::path& skyMapPath);
+	void resize(const glm::uvec2 resolution);
+	void reset() { frameIndex = 0u; }
+
+	// Adds one progressive frame to the accumulation, like a single GPU dispatch
+	Stats render(const RT::Camera::Spec& camera, const Settings& settings);
+
+	// Same frame traced bounce by bounce over all paths at once. Stream traversal sorts every bounce and
+	// filters it through the binary hierarchies, SingleRay traces the same batches one ray at a time
+	Stats renderWavefront(const RT::Camera::Spec& camera, const Settings& settings, const Traversal traversal);
+	RT::Image resolve() const;
+
+	uint32_t getFrameIndex() const { return frameIndex; }
+
+private:
+	glm::vec3 renderPixel(const glm::uvec2 index, const RT::Camera::Spec& camera, const Settings& settings, uint64_t& rayCnt) const;
+	uint32_t pixelSeed(const glm::uvec2 index, const uint32_t frame) const;
+	Ray cameraRay(const glm::uvec2 index, const RT::Camera::Spec& camera, uint32_t& seed) const;
+	glm::vec3 traceRay(Ray ray, const Settings& settings, uint32_t& seed, uint64_t& rayCnt) const;
+	Payload bounceRay(const Ray& ray) const;
+	SceneHit closestIntersection(const Ray& ray) const;
+	HitInfo bvhTraverse(const Ray& ray, const uint32_t bvhRoot, const uint32_t modelRoot, const uint32_t vertexRoot) const;
+	Payload closestHit(const Ray& ray, const float closestDistance, const int32_t closestObject, const int32_t closestInstance) const;
+
+	void traceStream(RayStream& stream, const glm::uvec2 streamRegion) const;
+	template <typename LeafFunc>
+	void traverseStream(const RayStream& rays, const BoundingBox* hierarchy, std::vector<uint32_t>& active, LeafFunc&& testLeaf) const;
+
+	void scatter(Ray& ray, const Payload& payload, Pixel& pixel, const Settings& settings, uint32_t& seed) const;
+	void refractRay(Ray& ray, const Payload& payload, uint32_t& seed) const;
+	void reflectRay(Ray& ray, const Payload& payload, uint32_t& seed) const;
+	void accumulateColor(Pixel& pixel, const Payload& payload, const Settings& settings) const;
+	glm::vec3 getSkyColor(const Ray& ray) const;
+
+	static float triangleHit(const Ray& ray, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C);
+	static float sphereHit(const Ray& ray, const Sphere& sphere);
+	static float hitBox(const Ray& ray, const BoundingBox& box);
+	static BoundingBox decodeFrame(const WideNode& node);
+
+private:
+	const RT::Scene& scene;
+	const SceneWrapper& sceneWrapper;
+
+	std::vector<RT::Image> textures = {};
+	RT::Image skyMap = {};
+
+	RT::Image accumulation = {};
+	uint32_t frameIndex = 0u;
+
+	static constexpr uint32_t tileSize = 16u;
+	static constexpr uint32_t streamChunkSize = 4096u;
+	static constexpr uint32_t instanceStackDepth = BVH::binaryStackDepth;
+	static constexpr uint32_t meshStackDepth = BVH::wideStackDepth;
+	static constexpr float hitOffset = 0.0001f;
+};
@@ -0,0 +1,287 @@
+#include "Headless.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+
+#include "Engine/Core/Time.h"
+#include "Engine/Core/Log.h"
+#include "Engine/Render/Camera.h"
+#include "Engine/Render/MeshFile.h"
+
+#include "CpuTracer.h"
+#include "PacketTracer.h"
+#include "Scenes.h"
+
+namespace
+{
+
+	glm::vec3 getVec3(const RT::CommandLineArgs& args, const std::string_view flag, const glm::vec3 fallback)
+	{
+		const auto value = args.getValue(flag);
+		if (not value.has_value())
+		{
+			return fallback;
+		}
+
+		auto vector = glm::vec3{};
+		const char* first = value->data();
+		const char* last = value->data() + value->size();
+		for (uint8_t axis = 0u; axis < 3u; axis++)
+		{
+			const auto [end, error] = std::from_chars(first, last, vector[axis]);
+			const bool isLastAxis = 2u == axis;
+			const bool isSeparated = isLastAxis ? last == end : end < last and ',' == *end;
+			if (std::errc{} != error or not isSeparated)
+			{
+				LOG_WARN("Ignoring invalid value {} of {}, expected x,y,z", *value, flag);
+				return fallback;
+			}
+			first = end + 1;
+		}
+		return vector;
+	}
+
+	// Primary rays against the first instance's mesh in its local space, once per instruction set
+	int32_t runPacketBenchmark(const RT::Scene& scene, const SceneWrapper& sceneWrapper, const RT::Camera::Spec& camera, const glm::uvec2 resolution, const uint32_t repetitionCnt)
+	{
+		if (scene.objects.empty())
+		{
+			LOG_ERROR("Packet benchmark needs a scene with a mesh instance");
+			return EXIT_FAILURE;
+		}
+
+		auto origins = std::vector<glm::vec3>{};
+		auto directions = std::vector<glm::vec3>{};
+		PacketTracer::generateCameraRays(camera, resolution, origins, directions);
+
+		const auto& instance = sceneWrapper.meshInstanceWrappers.front();
+		for (uint32_t rayIdx = 0u; rayIdx < origins.size(); rayIdx++)
+		{
+			origins[rayIdx] = glm::vec3{ instance.worldToLocalMatrix * glm::vec4{ origins[rayIdx], 1.0f } };
+			directions[rayIdx] = glm::vec3{ instance.worldToLocalMatrix * glm::vec4{ directions[rayIdx], 0.0f } };
+		}
+
+		const uint32_t meshId = instance.meshId;
+		auto tracer = PacketTracer{ sceneWrapper.getMeshHierarchy(meshId), sceneWrapper.getMeshTriangles(meshId), sceneWrapper.getMeshVertices(meshId) };
+		auto hits = std::vector<PacketHit>(origins.size());
+		const auto rays = PacketRays{ origins, directions };
+
+		fmt::print("packet benchmark, mesh {} with {} triangles at {}x{}\n", meshId, sceneWrapper.getMeshTriangles(meshId).size(), resolution.x, resolution.y);
+		for (uint8_t isa = 0u; isa <= (uint8_t)PacketTracer::detectIsa(); isa++)
+		{
+			tracer.setIsa((PacketTracer::Isa)isa);
+			tracer.intersect(rays, hits);
+
+			auto timer = RT::Timer{};
+			for (uint32_t repetition = 0u; repetition < repetitionCnt; repetition++)
+			{
+				tracer.intersect(rays, hits);
+			}
+			const float time = timer.Ellapsed();
+
+			const auto hitCnt = std::count_if(hits.begin(), hits.end(), [](const PacketHit& hit) { return PacketHit::noHit != hit.triangleId; });
+			const float mraysPerSecond = (float)origins.size() * repetitionCnt / (time * 1e3f);
+			fmt::print("{:>8} x{:<2} {:.3f} ms/pass, {:.3f} Mrays/s, {} hits\n", PacketTracer::isa2Str(tracer.getIsa()), PacketTracer::isaWidth(tracer.getIsa()), time / repetitionCnt, mraysPerSecond, hitCnt);
+		}
+		return EXIT_SUCCESS;
+	}
+
+	// Renders the same samples once per traversal, both have to resolve every hit alike down to the bit
+	int32_t runWavefrontCompare(const RT::Scene& scene, const SceneWrapper& sceneWrapper, const std::vector<std::filesystem::path>& texturePaths, const RT::Camera::Spec& camera, const glm::uvec2 resolution, const CpuTracer::Settings& settings, const uint32_t sampleCnt)
+	{
+		auto images = std::array<RT::Image, 2u>{};
+		for (const auto traversal : { CpuTracer::Traversal::SingleRay, CpuTracer::Traversal::Stream })
+		{
+			auto tracer = CpuTracer{ scene, sceneWrapper };
+			tracer.loadTextures(texturePaths, Scenes::skyMapPath);
+			tracer.resize(resolution);
+			for (uint32_t sample = 0u; sample < sampleCnt; sample++)
+			{
+				tracer.renderWavefront(camera, settings, traversal);
+			}
+			images[(uint8_t)traversal] = tracer.resolve();
+		}
+
+		uint32_t differentCnt = 0u;
+		float maxDifference = 0.0f;
+		for (uint32_t y = 0u; y < resolution.y; y++)
+		{
+			for (uint32_t x = 0u; x < resolution.x; x++)
+			{
+				const auto difference = glm::abs(images[0].at(x, y) - images[1].at(x, y));
+				const float pixelDifference = std::max({ difference.x, difference.y, difference.z });
+				differentCnt += pixelDifference > 0.0f ? 1u : 0u;
+				maxDifference = std::max(maxDifference, pixelDifference);
+			}
+		}
+
+		fmt::print("single ray and stream traversal differ in {} of {} pixels, max difference {}\n", differentCnt, resolution.x * resolution.y, maxDifference);
+		return 0u == differentCnt ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Builds every mesh of the scene with each builder and round trips the quantized wide nodes
+	int32_t runVerifyBvh(const RT::Scene& scene, const uint32_t binCount)
+	{
+		bool isValid = true;
+		for (uint32_t meshId = 0u; meshId < scene.meshes.size(); meshId++)
+		{
+			for (const auto mode : { BVH::BuildMode::SAH, BVH::BuildMode::Linear, BVH::BuildMode::Spatial })
+			{
+				const auto bvh = BVH{ scene.meshes[meshId], mode, binCount };
+				const bool isVerified = bvh.verifyWideNodes();
+				isValid = isValid and isVerified;
+				fmt::print("mesh {} {:>4}: {} wide nodes, {}\n", meshId, BVH::buildMode2Str(mode), bvh.getWideNodes().size(), isVerified ? "ok" : "FAILED");
+			}
+		}
+		return isValid ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Converts anything the mesh loaders read into a .rtmesh, embedding the BVH of the chosen builder
+	int32_t runConvert(const RT::CommandLineArgs& args, const std::filesystem::path& inputPath)
+	{
+		const auto buildModeName = args.getValue("--bvh").value_or(BVH::buildMode2Str(BVH::BuildMode::SAH));
+		const auto buildModes = { BVH::BuildMode::SAH, BVH::BuildMode::Linear, BVH::BuildMode::Spatial };
+		const auto buildMode = std::find_if(buildModes.begin(), buildModes.end(), [&](const BVH::BuildMode mode) { return buildModeName == BVH::buildMode2Str(mode); });
+		const uint32_t binCount = args.getNumber("--bins", BVH::defaultBinCount);
+		if (buildModes.end() == buildMode or binCount < 2u or binCount > BVH::maxBinCount)
+		{
+			LOG_ERROR("Expected --bvh SAH, LBVH or SBVH and --bins between 2 and {}", BVH::maxBinCount);
+			return EXIT_FAILURE;
+		}
+
+		auto timer = RT::Timer{};
+		auto mesh = RT::Mesh{};
+		mesh.load(inputPath);
+		if (0u == mesh.getTriangleCount())
+		{
+			LOG_ERROR("Failed to load mesh {}", inputPath);
+			return EXIT_FAILURE;
+		}
+		const float loadTime = timer.Ellapsed();
+
+		timer = RT::Timer{};
+		auto extension = std::vector<uint8_t>{};
+		if (not args.has("--no-bvh"))
+		{
+			const auto bvh = BVH{ mesh, *buildMode, binCount };
+			extension = BVHCache::serialize(*buildMode, binCount, bvh.getHierarchy(), bvh.buildTriangleIndices(mesh), bvh.getIndices(), bvh.getWideNodes());
+		}
+		const float buildTime = timer.Ellapsed();
+
+		auto outputPath = std::filesystem::path{ inputPath }.replace_extension(RT::MeshFile::fileExtension);
+		if (const auto output = args.getValue("--output"))
+		{
+			outputPath = *output;
+		}
+		if (not mesh.save(outputPath, extension))
+		{
+			return EXIT_FAILURE;
+		}
+
+		fmt::print("{} vertices, {} triangles, load {:.3f} ms, BVH {:.3f} ms\n", mesh.getModel().vertices.size(), mesh.getTriangleCount(), loadTime, buildTime);
+		fmt::print("written to {}\n", outputPath.string());
+		return EXIT_SUCCESS;
+	}
+
+}
+
+int32_t runHeadless(const RT::CommandLineArgs& args)
+{
+	if (const auto convertPath = args.getValue("--convert"))
+	{
+		return runConvert(args, *convertPath);
+	}
+
+	const int32_t sceneNr = args.getNumber("--scene", 3);
+	const auto resolution = glm::uvec2{ args.getNumber("--width", 1280u), args.getNumber("--height", 720u) };
+	const uint32_t sampleCnt = args.getNumber("--samples", 16u);
+	const auto outputPath = std::filesystem::path{ args.getValue("--output").value_or("render.png") };
+
+	auto settings = CpuTracer::Settings{};
+	settings.drawEnvironment = args.has("--environment") ? 1.0f : 0.0f;
+	settings.maxBounces = args.getNumber("--bounces", 5u);
+	settings.maxFrames = args.getNumber("--frames", 1u);
+
+	if (0u == resolution.x or 0u == resolution.y or 0u == sampleCnt or 0u == settings.maxBounces or 0u == settings.maxFrames)
+	{
+		LOG_ERROR("Resolution, samples, bounces and frames have to be positive");
+		return EXIT_FAILURE;
+	}
+
+	auto loadTimer = RT::Timer{};
+	auto scene = RT::Scene{};
+	auto sceneWrapper = SceneWrapper{ scene };
+	auto texturePaths = std::vector<std::filesystem::path>{};
+	if (not Scenes::load(sceneNr, scene, sceneWrapper, texturePaths))
+	{
+		return EXIT_FAILURE;
+	}
+	sceneWrapper.build();
+
+	if (args.has("--verify-bvh"))
+	{
+		return runVerifyBvh(scene, sceneWrapper.getBinCount());
+	}
+
+	auto camera = RT::Camera{ args.getNumber("--fov", 45.0f), 0.1f, 1.0f };
+	camera.getPosition() = getVec3(args, "--camera", camera.getPosition());
+	camera.getDirection() = glm::normalize(getVec3(args, "--direction", camera.getDirection()));
+	camera.resizeCamera(resolution.x, resolution.y);
+	camera.recalculateInvView();
+
+	if (args.has("--packet-benchmark"))
+	{
+		return runPacketBenchmark(scene, sceneWrapper, camera.getSpec(), resolution, sampleCnt);
+	}
+
+	const auto wavefront = args.getValue("--wavefront");
+	if ("compare" == wavefront.value_or(""))
+	{
+		return runWavefrontCompare(scene, sceneWrapper, texturePaths, camera.getSpec(), resolution, settings, sampleCnt);
+	}
+
+	auto tracer = CpuTracer{ scene, sceneWrapper };
+	tracer.loadTextures(texturePaths, Scenes::skyMapPath);
+	tracer.resize(resolution);
+	const float loadTime = loadTimer.Ellapsed();
+
+	const bool isWavefront = wavefront.has_value();
+	const auto traversal = "single" == wavefront.value_or("stream") ? CpuTracer::Traversal::SingleRay : CpuTracer::Traversal::Stream;
+
+	auto stats = CpuTracer::Stats{};
+	stats.bounces.resize(settings.maxBounces);
+	for (uint32_t sample = 0u; sample < sampleCnt; sample++)
+	{
+		const auto frameStats = isWavefront ? tracer.renderWavefront(camera.getSpec(), settings, traversal) : tracer.render(camera.getSpec(), settings);
+		stats.rayCnt += frameStats.rayCnt;
+		stats.renderTime += frameStats.renderTime;
+		for (uint32_t bounce = 0u; bounce < frameStats.bounces.size(); bounce++)
+		{
+			stats.bounces[bounce].rayCnt += frameStats.bounces[bounce].rayCnt;
+			stats.bounces[bounce].sortTime += frameStats.bounces[bounce].sortTime;
+			stats.bounces[bounce].traceTime += frameStats.bounces[bounce].traceTime;
+		}
+	}
+
+	if (not tracer.resolve().write(outputPath))
+	{
+		return EXIT_FAILURE;
+	}
+
+	// Printed directly, release builds only let errors through the logger
+	fmt::print("scene {} at {}x{}, {} samples, {} bounces\n", sceneNr, resolution.x, resolution.y, sampleCnt, settings.maxBounces);
+	fmt::print("load {:.3f} ms, render {:.3f} ms, {:.3f} ms/sample\n", loadTime, stats.renderTime, stats.renderTime / sampleCnt);
+	fmt::print("{} rays, {:.3f} Mrays/s, written to {}\n", stats.rayCnt, stats.mraysPerSecond(), outputPath.string());
+
+	if (isWavefront)
+	{
+		fmt::print("{} traversal per bounce:\n", CpuTracer::Traversal::Stream == traversal ? "stream" : "single ray");
+		for (uint32_t bounce = 0u; bounce < stats.bounces.size(); bounce++)
+		{
+			const auto& bounceStats = stats.bounces[bounce];
+			fmt::print("  bounce {}: {} rays, sort {:.3f} ms, trace {:.3f} ms, {:.3f} Mrays/s\n", bounce, bounceStats.rayCnt, bounceStats.sortTime, bounceStats.traceTime, bounceStats.mraysPerSecond());
+		}
+	}
+	return EXIT_SUCCESS;
+}
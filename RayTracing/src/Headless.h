@@ -0,0 +1,19 @@
+#pragma once
+#include "Engine/Startup/CommandLineArgs.h"
+
+/*
+* Batch render without a window, swapchain or UI. Loads a built-in scene, renders it
+* with the CPU tracer, writes the image and prints timing statistics to stdout.
+*
+* RayTracing --headless [--scene 3] [--width 1280] [--height 720] [--samples 16]
+*     [--bounces 5] [--frames 1] [--fov 45] [--camera x,y,z] [--direction x,y,z]
+*     [--environment] [--output render.png]
+*     [--wavefront stream|single]   renders through ray streams sorted per bounce and prints per bounce timings
+*     [--wavefront compare]         renders with both traversals and fails when the images differ in any pixel
+*     [--packet-benchmark]          times primary ray packets against the first mesh per instruction set, --samples passes each
+*     [--verify-bvh]                builds every mesh with each builder and checks that the wide nodes decode back to their boxes
+*
+* RayTracing --headless --convert mesh.obj [--output mesh.rtmesh] [--bvh SAH] [--bins 16] [--no-bvh]
+*     writes the native mesh format, see RT::MeshFile
+*/
+int32_t runHeadless(const RT::CommandLineArgs& args);
@@ -0,0 +1,123 @@
+#include "MeshImporter.h"
+
+#include <algorithm>
+
+#include "Engine/Core/Log.h"
+#include "Engine/Core/Time.h"
+
+void MeshImporter::submit(const std::filesystem::path& path, const BVH::BuildMode buildMode, const uint32_t binCount)
+{
+	auto& import = *imports.emplace_back(RT::makeLocal<Import>());
+	import.path = path;
+
+	// Import lives behind a pointer, so the thread keeps a stable reference while the list changes
+	import.task = std::async(std::launch::async, [&import, buildMode, binCount]
+	{
+		auto timer = RT::Timer{};
+		if (not parse(import))
+		{
+			return;
+		}
+
+		import.stage.store(Stage::BuildingBvh, std::memory_order_release);
+		import.update = SceneWrapper::MeshUpdate{ .buildMode = buildMode, .binCount = binCount };
+		import.update.build = SceneWrapper::buildMesh(import.mesh, buildMode, binCount);
+
+		LOG_INFO("Imported mesh {} in {:.1f} ms", import.path, timer.Ellapsed());
+		import.stage.store(Stage::Done, std::memory_order_release);
+	});
+}
+
+void MeshImporter::submitReload(const uint32_t meshId, const RT::Scene& scene, SceneWrapper& sceneWrapper)
+{
+	auto& import = *imports.emplace_back(RT::makeLocal<Import>());
+	import.path = scene.meshes[meshId].getSourcePath();
+	import.meshId = meshId;
+
+	const uint32_t prevVertexCnt = sceneWrapper.getMeshVertices(meshId).size();
+	const auto buildMode = sceneWrapper.buildModes[meshId];
+	const uint32_t binCount = sceneWrapper.getBinCount();
+	import.task = std::async(std::launch::async, [&import, bvh = sceneWrapper.takeMeshBvh(meshId), prevVertexCnt, buildMode, binCount]() mutable
+	{
+		auto timer = RT::Timer{};
+		if (not parse(import))
+		{
+			import.update.build.bvh = std::move(bvh);
+			return;
+		}
+
+		import.stage.store(Stage::BuildingBvh, std::memory_order_release);
+		import.update = SceneWrapper::updateMesh(std::move(bvh), import.mesh, prevVertexCnt, buildMode, binCount);
+
+		LOG_INFO("Reloaded mesh {} in {:.1f} ms", import.path, timer.Ellapsed());
+		import.stage.store(Stage::Done, std::memory_order_release);
+	});
+}
+
+MeshImporter::Changes MeshImporter::collect(RT::Scene& scene, SceneWrapper& sceneWrapper)
+{
+	auto changes = Changes{};
+	for (auto import = imports.begin(); import != imports.end();)
+	{
+		auto& finished = **import;
+		const auto stage = finished.stage.load(std::memory_order_acquire);
+		if (Stage::Done != stage and Stage::Failed != stage)
+		{
+			import++;
+			continue;
+		}
+
+		finished.task.get();
+		if (not finished.meshId)
+		{
+			if (Stage::Done == stage)
+			{
+				const auto& newMesh = scene.meshes.emplace_back(std::move(finished.mesh));
+				sceneWrapper.addMesh(newMesh, finished.update.buildMode, std::move(finished.update.build));
+				changes.areMeshesChanged = true;
+			}
+			import = imports.erase(import);
+			continue;
+		}
+
+		// A scene switched in the meantime no longer holds the mesh the reload was made for
+		const uint32_t meshId = *finished.meshId;
+		const bool isTargetValid = meshId < scene.meshes.size() and finished.path == scene.meshes[meshId].getSourcePath();
+		if (isTargetValid and Stage::Done == stage)
+		{
+			scene.meshes[meshId] = std::move(finished.mesh);
+			const auto dirtyRegion = sceneWrapper.applyMeshUpdate(meshId, std::move(finished.update));
+			if (dirtyRegion)
+			{
+				changes.dirtyRegions.push_back(*dirtyRegion);
+			}
+			else
+			{
+				changes.areMeshesChanged = true;
+			}
+		}
+		else if (isTargetValid)
+		{
+			sceneWrapper.returnMeshBvh(meshId, std::move(finished.update.build.bvh));
+		}
+		import = imports.erase(import);
+	}
+	return changes;
+}
+
+bool MeshImporter::isReloading(const uint32_t meshId) const
+{
+	return std::any_of(imports.begin(), imports.end(), [meshId](const RT::Local<Import>& import) { return import->meshId == meshId; });
+}
+
+bool MeshImporter::parse(Import& import)
+{
+	import.mesh.load(import.path);
+	if (0u == import.mesh.getTriangleCount())
+	{
+		LOG_ERROR("Failed to import mesh {}", import.path);
+		import.stage.store(Stage::Failed, std::memory_order_release);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <future>
+
+#include "SceneWrapper.h"
+
+/*
+* Loads meshes and builds their hierarchies without blocking the frame. Every import runs on
+* its own thread, so it progresses even when the UI thread never waits on the pool, while the
+* parse and the build still fan out over the thread pool. A reload of a scene mesh takes its
+* hierarchy along and refits it on the import thread. Finished imports are handed to the
+* scene by collect, which the client calls once per frame before the scene buffers are uploaded.
+*/
+class MeshImporter
+{
+public:
+	enum class Stage : uint8_t { Parsing, BuildingBvh, Done, Failed };
+
+	struct Import
+	{
+		std::filesystem::path path;
+		std::optional<uint32_t> meshId = {};	// set when reloading a mesh of the scene
+		std::atomic<Stage> stage = Stage::Parsing;
+
+		// Owned by the import thread until stage turns Done or Failed
+		RT::Mesh mesh = {};
+		SceneWrapper::MeshUpdate update = {};
+		std::future<void> task = {};
+	};
+
+	struct Changes
+	{
+		bool areMeshesChanged = false;	// meshes were added or moved, the mesh buffers are uploaded whole
+		std::vector<SceneWrapper::DirtyRegion> dirtyRegions = {};	// reloads refitted in place
+	};
+
+public:
+	MeshImporter() = default;
+	~MeshImporter() = default;
+
+	MeshImporter(const MeshImporter&) = delete;
+	MeshImporter& operator=(const MeshImporter&) = delete;
+
+	// Bin count is taken at submit time, a later change rebuilds the mesh once it is in the scene
+	void submit(const std::filesystem::path& path, const BVH::BuildMode buildMode, const uint32_t binCount);
+	void submitReload(const uint32_t meshId, const RT::Scene& scene, SceneWrapper& sceneWrapper);
+	// Appends every finished mesh to the scene and swaps in reloaded ones
+	Changes collect(RT::Scene& scene, SceneWrapper& sceneWrapper);
+
+	const std::vector<RT::Local<Import>>& getImports() const { return imports; }
+	bool isReloading(const uint32_t meshId) const;
+
+	static constexpr float stage2Progress(const Stage stage) { return (float)stage / (float)Stage::Done; }
+	static constexpr const char* stage2Str(const Stage stage)
+	{
+		switch (stage)
+		{
+			case Stage::Parsing: return "Parsing";
+			case Stage::BuildingBvh: return "Building BVH";
+			case Stage::Done: return "Done";
+			case Stage::Failed: return "Failed";
+		}
+		return "Unknown";
+	}
+
+private:
+	static bool parse(Import& import);
+
+private:
+	std::vector<RT::Local<Import>> imports = {};
+};
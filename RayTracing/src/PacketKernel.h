@@ -0,0 +1,215 @@
+#pragma once
+#include <cstring>
+
+#include "PacketTracer.h"
+
+/*
+* Packet traversal shared by all instruction sets. Every kernel translation unit wraps its
+* intrinsics in a Lane type and instantiates tracePackets once. Those units are compiled
+* for wider instruction sets, so the kernel sticks to raw pointers, member access and Lane
+* operations. Any inline glm, container or <algorithm> function compiled there, even
+* std::vector::data or std::span::size, could be picked by the linker for baseline code
+* as well. The caller unpacks everything into a PacketBatch. memcpy is an external C
+* function or a compiler builtin, so no inline copy of it is ever emitted here.
+*/
+namespace
+{
+
+	constexpr uint32_t packetStackDepth = 64u;
+	constexpr float packetNoHitDistance = 3.402823466e+38f;
+
+	float component(const glm::vec3& vector, const uint32_t axis)
+	{
+		return (&vector.x)[axis];
+	}
+
+	template <typename Lane>
+	struct RayPacket
+	{
+		typename Lane::Float origin[3];
+		typename Lane::Float direction[3];
+		typename Lane::Float invDirection[3];
+
+		typename Lane::Float distance;
+		typename Lane::Float u;
+		typename Lane::Float v;
+		typename Lane::Float triangleId;	// bit pattern of the index, only moved by selects
+	};
+
+	template <typename Lane>
+	typename Lane::Mask hitBox(const RayPacket<Lane>& packet, const BoundingBox& box)
+	{
+		auto tNear = Lane::set1(0.0f);
+		auto tFar = Lane::set1(0.0f);
+		for (uint32_t axis = 0u; axis < 3u; axis++)
+		{
+			const auto t0 = Lane::mul(Lane::sub(Lane::set1(component(box.vMin, axis)), packet.origin[axis]), packet.invDirection[axis]);
+			const auto t1 = Lane::mul(Lane::sub(Lane::set1(component(box.vMax, axis)), packet.origin[axis]), packet.invDirection[axis]);
+			const auto tMin = Lane::min(t0, t1);
+			const auto tMax = Lane::max(t0, t1);
+			tNear = 0u == axis ? tMin : Lane::max(tNear, tMin);
+			tFar = 0u == axis ? tMax : Lane::min(tFar, tMax);
+		}
+
+		const auto isOrdered = Lane::lessEqual(tNear, tFar);
+		const auto isAhead = Lane::lessEqual(Lane::set1(0.0f), tFar);
+		const auto isCloser = Lane::less(tNear, packet.distance);
+		return Lane::both(Lane::both(isOrdered, isAhead), isCloser);
+	}
+
+	// Möller–Trumbore, culling back faces like triangleHit in the shader
+	template <typename Lane>
+	void hitTriangle(RayPacket<Lane>& packet, const PacketTriangle& triangle, const typename Lane::Float triangleId)
+	{
+		const auto e1x = Lane::set1(triangle.edgeAB.x);
+		const auto e1y = Lane::set1(triangle.edgeAB.y);
+		const auto e1z = Lane::set1(triangle.edgeAB.z);
+		const auto e2x = Lane::set1(triangle.edgeAC.x);
+		const auto e2y = Lane::set1(triangle.edgeAC.y);
+		const auto e2z = Lane::set1(triangle.edgeAC.z);
+		const auto* d = packet.direction;
+
+		const auto px = Lane::sub(Lane::mul(d[1], e2z), Lane::mul(d[2], e2y));
+		const auto py = Lane::sub(Lane::mul(d[2], e2x), Lane::mul(d[0], e2z));
+		const auto pz = Lane::sub(Lane::mul(d[0], e2y), Lane::mul(d[1], e2x));
+		const auto determinant = Lane::add(Lane::add(Lane::mul(e1x, px), Lane::mul(e1y, py)), Lane::mul(e1z, pz));
+		const auto invDet = Lane::div(Lane::set1(1.0f), determinant);
+
+		const auto tx = Lane::sub(packet.origin[0], Lane::set1(triangle.A.x));
+		const auto ty = Lane::sub(packet.origin[1], Lane::set1(triangle.A.y));
+		const auto tz = Lane::sub(packet.origin[2], Lane::set1(triangle.A.z));
+		const auto u = Lane::mul(Lane::add(Lane::add(Lane::mul(tx, px), Lane::mul(ty, py)), Lane::mul(tz, pz)), invDet);
+
+		const auto qx = Lane::sub(Lane::mul(ty, e1z), Lane::mul(tz, e1y));
+		const auto qy = Lane::sub(Lane::mul(tz, e1x), Lane::mul(tx, e1z));
+		const auto qz = Lane::sub(Lane::mul(tx, e1y), Lane::mul(ty, e1x));
+		const auto v = Lane::mul(Lane::add(Lane::add(Lane::mul(d[0], qx), Lane::mul(d[1], qy)), Lane::mul(d[2], qz)), invDet);
+		const auto t = Lane::mul(Lane::add(Lane::add(Lane::mul(e2x, qx), Lane::mul(e2y, qy)), Lane::mul(e2z, qz)), invDet);
+
+		const auto zero = Lane::set1(0.0f);
+		auto isHit = Lane::less(zero, determinant);
+		isHit = Lane::both(isHit, Lane::lessEqual(zero, u));
+		isHit = Lane::both(isHit, Lane::lessEqual(zero, v));
+		isHit = Lane::both(isHit, Lane::lessEqual(Lane::add(u, v), Lane::set1(1.0f)));
+		isHit = Lane::both(isHit, Lane::lessEqual(zero, t));
+		isHit = Lane::both(isHit, Lane::less(t, packet.distance));
+		if (0u == Lane::bits(isHit))
+		{
+			return;
+		}
+
+		packet.distance = Lane::select(isHit, t, packet.distance);
+		packet.u = Lane::select(isHit, u, packet.u);
+		packet.v = Lane::select(isHit, v, packet.v);
+		packet.triangleId = Lane::select(isHit, triangleId, packet.triangleId);
+	}
+
+	template <typename Lane>
+	typename Lane::Float indexBits(const uint32_t index)
+	{
+		float bits = 0.0f;
+		std::memcpy(&bits, &index, sizeof(float));
+		return Lane::set1(bits);
+	}
+
+	template <typename Lane>
+	void tracePacket(RayPacket<Lane>& packet, const float leadDirection[3], const BoundingBox* nodes, const PacketTriangle* triangles)
+	{
+		uint32_t stack[packetStackDepth];
+		uint32_t stackIdx = 0u;
+		stack[stackIdx++] = 0u;
+
+		while (stackIdx > 0u)
+		{
+			const auto& node = nodes[stack[--stackIdx]];
+			if (0u == Lane::bits(hitBox(packet, node)))
+			{
+				continue;
+			}
+
+			const bool isLeaf = node.bufferRegion.y > 0u;
+			if (isLeaf)
+			{
+				for (uint32_t triangleId = node.bufferRegion.x; triangleId < node.bufferRegion.y; triangleId++)
+				{
+					hitTriangle(packet, triangles[triangleId], indexBits<Lane>(triangleId));
+				}
+				continue;
+			}
+
+			// Whole packet descends in one order, picked by the lead ray against the child centers
+			const uint32_t leftIdx = node.bufferRegion.x;
+			const uint32_t rightIdx = node.bufferRegion.x + 1u;
+			const auto& left = nodes[leftIdx];
+			const auto& right = nodes[rightIdx];
+
+			float towardsRight = 0.0f;
+			for (uint32_t axis = 0u; axis < 3u; axis++)
+			{
+				towardsRight += leadDirection[axis] * ((component(right.vMin, axis) + component(right.vMax, axis)) - (component(left.vMin, axis) + component(left.vMax, axis)));
+			}
+
+			const bool isLeftNear = towardsRight > 0.0f;
+			stack[stackIdx++] = isLeftNear ? rightIdx : leftIdx;
+			stack[stackIdx++] = isLeftNear ? leftIdx : rightIdx;
+		}
+	}
+
+	template <typename Lane>
+	void tracePackets(const PacketBatch& batch)
+	{
+		constexpr uint32_t width = Lane::width;
+		const auto* nodes = batch.nodes;
+		const auto* triangles = batch.triangles;
+		const auto* origins = batch.origins;
+		const auto* directions = batch.directions;
+		auto* packetHits = batch.hits;
+		const uint32_t rayCnt = batch.rayCnt;
+
+		alignas(64) float lanes[9][width];
+		for (uint32_t first = 0u; first < rayCnt; first += width)
+		{
+			// A partial packet repeats its last ray, the copies never change the result
+			const uint32_t count = rayCnt - first < width ? rayCnt - first : width;
+			for (uint32_t lane = 0u; lane < width; lane++)
+			{
+				const uint32_t rayIdx = first + (lane < count ? lane : count - 1u);
+				for (uint32_t axis = 0u; axis < 3u; axis++)
+				{
+					lanes[axis][lane] = component(origins[rayIdx], axis);
+					lanes[3u + axis][lane] = component(directions[rayIdx], axis);
+					lanes[6u + axis][lane] = 1.0f / component(directions[rayIdx], axis);
+				}
+			}
+
+			auto packet = RayPacket<Lane>{};
+			for (uint32_t axis = 0u; axis < 3u; axis++)
+			{
+				packet.origin[axis] = Lane::load(lanes[axis]);
+				packet.direction[axis] = Lane::load(lanes[3u + axis]);
+				packet.invDirection[axis] = Lane::load(lanes[6u + axis]);
+			}
+			packet.distance = Lane::set1(packetNoHitDistance);
+			packet.u = Lane::set1(0.0f);
+			packet.v = Lane::set1(0.0f);
+			packet.triangleId = indexBits<Lane>(PacketHit::noHit);
+
+			const float leadDirection[3] = { lanes[3][0], lanes[4][0], lanes[5][0] };
+			tracePacket(packet, leadDirection, nodes, triangles);
+
+			Lane::store(lanes[0], packet.distance);
+			Lane::store(lanes[1], packet.u);
+			Lane::store(lanes[2], packet.v);
+			Lane::store(lanes[3], packet.triangleId);
+			for (uint32_t lane = 0u; lane < count; lane++)
+			{
+				auto& hit = packetHits[first + lane];
+				hit.distance = lanes[0][lane];
+				hit.u = lanes[1][lane];
+				hit.v = lanes[2][lane];
+				std::memcpy(&hit.triangleId, &lanes[3][lane], sizeof(uint32_t));
+			}
+		}
+	}
+
+}
@@ -0,0 +1,39 @@
+#include "PacketKernel.h"
+
+#include <immintrin.h>
+
+namespace
+{
+
+	// Built with /arch:AVX2, only reached after PacketTracer::detectIsa confirmed support
+	struct Avx2Lane
+	{
+		using Float = __m256;
+		using Mask = __m256;
+
+		static constexpr uint32_t width = 8u;
+
+		static Float set1(const float value) { return _mm256_set1_ps(value); }
+		static Float load(const float* values) { return _mm256_load_ps(values); }
+		static void store(float* values, const Float a) { _mm256_store_ps(values, a); }
+
+		static Float add(const Float a, const Float b) { return _mm256_add_ps(a, b); }
+		static Float sub(const Float a, const Float b) { return _mm256_sub_ps(a, b); }
+		static Float mul(const Float a, const Float b) { return _mm256_mul_ps(a, b); }
+		static Float div(const Float a, const Float b) { return _mm256_div_ps(a, b); }
+		static Float min(const Float a, const Float b) { return _mm256_min_ps(a, b); }
+		static Float max(const Float a, const Float b) { return _mm256_max_ps(a, b); }
+
+		static Mask less(const Float a, const Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+		static Mask lessEqual(const Float a, const Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+		static Mask both(const Mask a, const Mask b) { return _mm256_and_ps(a, b); }
+		static uint32_t bits(const Mask mask) { return _mm256_movemask_ps(mask); }
+		static Float select(const Mask mask, const Float a, const Float b) { return _mm256_blendv_ps(b, a, mask); }
+	};
+
+}
+
+void PacketKernels::traceAvx2(const PacketBatch& batch)
+{
+	tracePackets<Avx2Lane>(batch);
+}
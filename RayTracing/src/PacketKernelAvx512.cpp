@@ -0,0 +1,39 @@
+#include "PacketKernel.h"
+
+#include <immintrin.h>
+
+namespace
+{
+
+	// Built with /arch:AVX512, only reached after PacketTracer::detectIsa confirmed support
+	struct Avx512Lane
+	{
+		using Float = __m512;
+		using Mask = __mmask16;
+
+		static constexpr uint32_t width = 16u;
+
+		static Float set1(const float value) { return _mm512_set1_ps(value); }
+		static Float load(const float* values) { return _mm512_load_ps(values); }
+		static void store(float* values, const Float a) { _mm512_store_ps(values, a); }
+
+		static Float add(const Float a, const Float b) { return _mm512_add_ps(a, b); }
+		static Float sub(const Float a, const Float b) { return _mm512_sub_ps(a, b); }
+		static Float mul(const Float a, const Float b) { return _mm512_mul_ps(a, b); }
+		static Float div(const Float a, const Float b) { return _mm512_div_ps(a, b); }
+		static Float min(const Float a, const Float b) { return _mm512_min_ps(a, b); }
+		static Float max(const Float a, const Float b) { return _mm512_max_ps(a, b); }
+
+		static Mask less(const Float a, const Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+		static Mask lessEqual(const Float a, const Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+		static Mask both(const Mask a, const Mask b) { return a & b; }
+		static uint32_t bits(const Mask mask) { return mask; }
+		static Float select(const Mask mask, const Float a, const Float b) { return _mm512_mask_blend_ps(mask, b, a); }
+	};
+
+}
+
+void PacketKernels::traceAvx512(const PacketBatch& batch)
+{
+	tracePackets<Avx512Lane>(batch);
+}
@@ -0,0 +1,39 @@
+#include "PacketKernel.h"
+
+#include <emmintrin.h>
+
+namespace
+{
+
+	// SSE2 only, so this unit runs on every x64 CPU and serves as the fallback
+	struct SseLane
+	{
+		using Float = __m128;
+		using Mask = __m128;
+
+		static constexpr uint32_t width = 4u;
+
+		static Float set1(const float value) { return _mm_set1_ps(value); }
+		static Float load(const float* values) { return _mm_load_ps(values); }
+		static void store(float* values, const Float a) { _mm_store_ps(values, a); }
+
+		static Float add(const Float a, const Float b) { return _mm_add_ps(a, b); }
+		static Float sub(const Float a, const Float b) { return _mm_sub_ps(a, b); }
+		static Float mul(const Float a, const Float b) { return _mm_mul_ps(a, b); }
+		static Float div(const Float a, const Float b) { return _mm_div_ps(a, b); }
+		static Float min(const Float a, const Float b) { return _mm_min_ps(a, b); }
+		static Float max(const Float a, const Float b) { return _mm_max_ps(a, b); }
+
+		static Mask less(const Float a, const Float b) { return _mm_cmplt_ps(a, b); }
+		static Mask lessEqual(const Float a, const Float b) { return _mm_cmple_ps(a, b); }
+		static Mask both(const Mask a, const Mask b) { return _mm_and_ps(a, b); }
+		static uint32_t bits(const Mask mask) { return _mm_movemask_ps(mask); }
+		static Float select(const Mask mask, const Float a, const Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	};
+
+}
+
+void PacketKernels::traceSse(const PacketBatch& batch)
+{
+	tracePackets<SseLane>(batch);
+}
@@ -0,0 +1,173 @@
+#include "PacketTracer.h"
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#else
+	#include <cpuid.h>
+#endif
+
+#include "Engine/Core/Log.h"
+#include "Engine/Core/Assert.h"
+#include "Engine/Core/ThreadPool.h"
+
+namespace
+{
+
+	constexpr uint32_t blockSize = 4u;
+
+	void cpuid(const uint32_t leaf, const uint32_t subleaf, uint32_t regs[4])
+	{
+	#ifdef _MSC_VER
+		__cpuidex((int32_t*)regs, leaf, subleaf);
+	#else
+		__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+	#endif
+	}
+
+	uint64_t xgetbv()
+	{
+	#ifdef _MSC_VER
+		return _xgetbv(0);
+	#else
+		uint32_t eax = 0u, edx = 0u;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return ((uint64_t)edx << 32u) | eax;
+	#endif
+	}
+
+	std::vector<VertexPosition> meshPositions(const RT::Mesh& mesh)
+	{
+		const auto& vertices = mesh.getModel().vertices;
+		auto positions = std::vector<VertexPosition>(vertices.size());
+		for (uint32_t i = 0u; i < vertices.size(); i++)
+		{
+			positions[i] = VertexPosition{ vertices[i].position, 0.0f };
+		}
+		return positions;
+	}
+
+}
+
+PacketTracer::PacketTracer(const BVH& bvh, const RT::Mesh& mesh)
+	: PacketTracer(bvh.getHierarchy(), bvh.buildTriangleIndices(mesh), meshPositions(mesh))
+{
+}
+
+PacketTracer::PacketTracer(std::span<const BoundingBox> hierarchy, std::span<const glm::uvec3> triangles, std::span<const VertexPosition> vertices)
+{
+	// Kernels test every triangle of a leaf per packet, so the vertex fetch and edge setup are done once up front
+	geometry.hierarchy.assign(hierarchy.begin(), hierarchy.end());
+	geometry.triangles.reserve(triangles.size());
+	for (const auto& triangle : triangles)
+	{
+		const auto& A = vertices[triangle.x].position;
+		const auto& B = vertices[triangle.y].position;
+		const auto& C = vertices[triangle.z].position;
+		geometry.triangles.push_back(PacketTriangle{ A, 0.0f, B - A, 0.0f, C - A, 0.0f });
+	}
+
+	setIsa(detectIsa());
+}
+
+PacketTracer::Isa PacketTracer::detectIsa()
+{
+	static const auto detectedIsa = []
+	{
+		uint32_t regs[4] = {};
+		cpuid(0u, 0u, regs);
+		const uint32_t maxLeaf = regs[0];
+
+		cpuid(1u, 0u, regs);
+		const bool hasOsxsave = 0u != (regs[2] & (1u << 27u));
+		const bool hasAvx = 0u != (regs[2] & (1u << 28u));
+		if (maxLeaf < 7u or not hasOsxsave or not hasAvx)
+		{
+			return Isa::SSE;
+		}
+
+		// The OS has to save the wide registers on context switches, not only the CPU support them
+		const uint64_t xcr0 = xgetbv();
+		const bool hasYmmState = 0x6u == (xcr0 & 0x6u);
+		const bool hasZmmState = 0xE6u == (xcr0 & 0xE6u);
+
+		cpuid(7u, 0u, regs);
+		const bool hasAvx2 = 0u != (regs[1] & (1u << 5u));
+		const bool hasAvx512 = 0u != (regs[1] & (1u << 16u));
+
+		if (hasAvx512 and hasZmmState)
+		{
+			return Isa::AVX512;
+		}
+		if (hasAvx2 and hasYmmState)
+		{
+			return Isa::AVX2;
+		}
+		return Isa::SSE;
+	}();
+	return detectedIsa;
+}
+
+void PacketTracer::setIsa(const Isa requestedIsa)
+{
+	isa = std::min(requestedIsa, detectIsa());
+	switch (isa)
+	{
+		case Isa::SSE: kernel = PacketKernels::traceSse; break;
+		case Isa::AVX2: kernel = PacketKernels::traceAvx2; break;
+		case Isa::AVX512: kernel = PacketKernels::traceAvx512; break;
+	}
+	LOG_DEBUG("Packet tracer: {} x{}", isa2Str(isa), isaWidth(isa));
+}
+
+void PacketTracer::intersect(const PacketRays& rays, std::span<PacketHit> hits) const
+{
+	ASSERT(rays.origins.size() == rays.directions.size() and rays.origins.size() == hits.size(), "Every ray needs an origin, a direction and a hit slot!");
+	if (geometry.hierarchy.empty())
+	{
+		std::fill(hits.begin(), hits.end(), PacketHit{ std::numeric_limits<float>::max(), PacketHit::noHit, 0.0f, 0.0f });
+		return;
+	}
+
+	// Tasks cover whole packets, only the last one may end with a partial packet
+	const uint32_t rayCnt = hits.size();
+	const uint32_t taskCnt = (rayCnt + raysPerTask - 1u) / raysPerTask;
+	RT::ThreadPool::get().parallelFor(0u, taskCnt, 1u, [&](const uint32_t task)
+	{
+		const uint32_t first = task * raysPerTask;
+		const uint32_t count = std::min(raysPerTask, rayCnt - first);
+		const auto batch = PacketBatch{
+			geometry.hierarchy.data(),
+			geometry.triangles.data(),
+			rays.origins.data() + first,
+			rays.directions.data() + first,
+			hits.data() + first,
+			count };
+		kernel(batch);
+	});
+}
+
+void PacketTracer::generateCameraRays(const RT::Camera::Spec& camera, const glm::uvec2 resolution, std::vector<glm::vec3>& origins, std::vector<glm::vec3>& directions)
+{
+	origins.assign(resolution.x * resolution.y, camera.position);
+	directions.resize(resolution.x * resolution.y);
+
+	const auto screenSize = glm::vec2{ resolution };
+	const auto blockCnt = (resolution + blockSize - 1u) / blockSize;
+
+	uint32_t rayIdx = 0u;
+	for (uint32_t block = 0u; block < blockCnt.x * blockCnt.y; block++)
+	{
+		const auto blockMin = glm::uvec2{ block % blockCnt.x, block / blockCnt.x } * blockSize;
+		const auto blockMax = glm::min(blockMin + blockSize, resolution);
+		for (uint32_t y = blockMin.y; y < blockMax.y; y++)
+		{
+			for (uint32_t x = blockMin.x; x < blockMax.x; x++)
+			{
+				const auto pixelCoord = glm::vec2{ x, y } / screenSize;
+				const auto coord = camera.invProjection * (2.0f * glm::vec4{ pixelCoord, 1.0f, 1.0f } - 1.0f);
+				const auto direction = glm::vec3{ camera.invView * glm::vec4{ glm::vec3{ coord } / coord.w, 0.0f } };
+				directions[rayIdx++] = glm::normalize(direction);
+			}
+		}
+	}
+}
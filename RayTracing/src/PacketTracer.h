@@ -0,0 +1,108 @@
+#pragma once
+#include <span>
+#include <vector>
+
+#include "SceneWrapper.h"
+
+#include "Engine/Render/Camera.h"
+
+struct PacketHit
+{
+	float distance;
+	uint32_t triangleId;	// index into the hierarchy's triangle order, noHit on a miss
+	float u;
+	float v;
+
+	static constexpr uint32_t noHit = ~0u;
+};
+
+// Leaf triangle of the kernels, resolved from the scene's indexed vertices once per tracer. The scene itself
+// keeps positions and uvs apart and forms the edges at each test, so this layout stays private to packets
+#pragma pack(push, 1)
+struct PacketTriangle
+{
+	glm::vec3 A; float pad1;
+	glm::vec3 edgeAB; float pad2;
+	glm::vec3 edgeAC; float pad3;
+};
+#pragma pack(pop)
+
+struct PacketGeometry
+{
+	std::vector<BoundingBox> hierarchy;
+	std::vector<PacketTriangle> triangles;
+};
+
+struct PacketRays
+{
+	std::span<const glm::vec3> origins;
+	std::span<const glm::vec3> directions;
+};
+
+// Plain pointers for the kernels, their units must not instantiate inline library code, see PacketKernel.h
+struct PacketBatch
+{
+	const BoundingBox* nodes;
+	const PacketTriangle* triangles;
+	const glm::vec3* origins;
+	const glm::vec3* directions;
+	PacketHit* hits;
+	uint32_t rayCnt;
+};
+
+/*
+* Traces coherent rays in packets of 4, 8 or 16 through the binary BoundingBox hierarchy
+* of a single mesh. A packet enters a node when any of its active rays hits it and tests
+* whole leaf ranges per triangle, so traversal cost is shared by all rays of the packet.
+* The widest instruction set the CPU supports is picked at runtime.
+*/
+class PacketTracer
+{
+public:
+	enum class Isa : uint8_t { SSE, AVX2, AVX512 };
+
+	using Kernel = void(*)(const PacketBatch& batch);
+
+public:
+	PacketTracer(const BVH& bvh, const RT::Mesh& mesh);
+	PacketTracer(std::span<const BoundingBox> hierarchy, std::span<const glm::uvec3> triangles, std::span<const VertexPosition> vertices);
+
+	static Isa detectIsa();
+	static constexpr uint32_t isaWidth(const Isa isa) { return 4u << (uint32_t)isa; }
+	static constexpr const char* isa2Str(const Isa isa)
+	{
+		switch (isa)
+		{
+			case Isa::SSE: return "SSE";
+			case Isa::AVX2: return "AVX2";
+			case Isa::AVX512: return "AVX-512";
+		}
+		return "Unknown";
+	}
+
+	// Falls back to the widest supported set when the requested one is not available
+	void setIsa(const Isa requestedIsa);
+	Isa getIsa() const { return isa; }
+
+	// Consecutive rays form a packet, callers keep neighbouring pixels next to each other
+	void intersect(const PacketRays& rays, std::span<PacketHit> hits) const;
+
+	// Jitter free primary rays of the shader, ordered in 4x4 pixel blocks so every packet width stays coherent
+	static void generateCameraRays(const RT::Camera::Spec& camera, const glm::uvec2 resolution, std::vector<glm::vec3>& origins, std::vector<glm::vec3>& directions);
+
+private:
+	PacketGeometry geometry = {};
+	Isa isa = Isa::SSE;
+	Kernel kernel = nullptr;
+
+	static constexpr uint32_t raysPerTask = 4096u;
+};
+
+namespace PacketKernels
+{
+
+	void traceSse(const PacketBatch& batch);
+	void traceAvx2(const PacketBatch& batch);
+	void traceAvx512(const PacketBatch& batch);
+
+}
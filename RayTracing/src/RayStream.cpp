@@ -0,0 +1,136 @@
+#include "RayStream.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace
+{
+
+	uint32_t expandBits9(uint32_t v)
+	{
+		v = (v * 0x00010001u) & 0xFF0000FFu;
+		v = (v * 0x00000101u) & 0x0F00F00Fu;
+		v = (v * 0x00000011u) & 0xC30C30C3u;
+		v = (v * 0x00000005u) & 0x49249249u;
+		return v;
+	}
+
+}
+
+void RayStream::resize(const uint32_t rayCnt)
+{
+	originX.resize(rayCnt);
+	originY.resize(rayCnt);
+	originZ.resize(rayCnt);
+	directionX.resize(rayCnt);
+	directionY.resize(rayCnt);
+	directionZ.resize(rayCnt);
+	pathIds.resize(rayCnt);
+	hitDistance.resize(rayCnt);
+	hitInstance.resize(rayCnt);
+	hitObject.resize(rayCnt);
+}
+
+void RayStream::setRay(const uint32_t rayIdx, const glm::vec3 origin, const glm::vec3 direction, const uint32_t pathId)
+{
+	originX[rayIdx] = origin.x;
+	originY[rayIdx] = origin.y;
+	originZ[rayIdx] = origin.z;
+	directionX[rayIdx] = direction.x;
+	directionY[rayIdx] = direction.y;
+	directionZ[rayIdx] = direction.z;
+	pathIds[rayIdx] = pathId;
+}
+
+void RayStream::sort()
+{
+	const uint32_t rayCnt = size();
+
+	auto boundsMin = glm::vec3{ std::numeric_limits<float>::max() };
+	auto boundsMax = glm::vec3{ std::numeric_limits<float>::lowest() };
+	for (uint32_t rayIdx = 0u; rayIdx < rayCnt; rayIdx++)
+	{
+		boundsMin = glm::min(boundsMin, getOrigin(rayIdx));
+		boundsMax = glm::max(boundsMax, getOrigin(rayIdx));
+	}
+
+	const float axisCells = (float)((1u << mortonAxisBits) - 1u);
+	const auto extent = glm::max(boundsMax - boundsMin, glm::vec3{ std::numeric_limits<float>::min() });
+
+	keys.resize(rayCnt);
+	order.resize(rayCnt);
+	for (uint32_t rayIdx = 0u; rayIdx < rayCnt; rayIdx++)
+	{
+		const uint32_t octant = (directionX[rayIdx] < 0.0f ? 4u : 0u) | (directionY[rayIdx] < 0.0f ? 2u : 0u) | (directionZ[rayIdx] < 0.0f ? 1u : 0u);
+		const auto cell = glm::uvec3(glm::clamp((getOrigin(rayIdx) - boundsMin) / extent, 0.0f, 1.0f) * axisCells);
+		const uint32_t mortonCode = (expandBits9(cell.x) << 2u) | (expandBits9(cell.y) << 1u) | expandBits9(cell.z);
+
+		keys[rayIdx] = (octant << (3u * mortonAxisBits)) | mortonCode;
+		order[rayIdx] = rayIdx;
+	}
+
+	// LSD radix sort over 8 bit digits, the same scheme BVH uses for Morton codes
+	constexpr uint32_t radixBits = 8u;
+	constexpr uint32_t radixSize = 1u << radixBits;
+	constexpr uint32_t passCnt = (3u * mortonAxisBits + 3u + radixBits - 1u) / radixBits;
+
+	sortedKeys.resize(rayCnt);
+	sortedOrder.resize(rayCnt);
+	for (uint32_t pass = 0u; pass < passCnt; pass++)
+	{
+		const uint32_t shift = pass * radixBits;
+
+		auto histogram = std::array<uint32_t, radixSize>{};
+		for (uint32_t rayIdx = 0u; rayIdx < rayCnt; rayIdx++)
+		{
+			histogram[(keys[rayIdx] >> shift) & (radixSize - 1u)]++;
+		}
+
+		uint32_t offset = 0u;
+		for (auto& digitCnt : histogram)
+		{
+			const uint32_t count = digitCnt;
+			digitCnt = offset;
+			offset += count;
+		}
+
+		for (uint32_t rayIdx = 0u; rayIdx < rayCnt; rayIdx++)
+		{
+			const uint32_t dst = histogram[(keys[rayIdx] >> shift) & (radixSize - 1u)]++;
+			sortedKeys[dst] = keys[rayIdx];
+			sortedOrder[dst] = order[rayIdx];
+		}
+
+		std::swap(keys, sortedKeys);
+		std::swap(order, sortedOrder);
+	}
+
+	auto floatScratch = std::vector<float>(rayCnt);
+	permute(originX, floatScratch);
+	permute(originY, floatScratch);
+	permute(originZ, floatScratch);
+	permute(directionX, floatScratch);
+	permute(directionY, floatScratch);
+	permute(directionZ, floatScratch);
+	permute(pathIds, sortedOrder);
+
+	resetHits();
+}
+
+void RayStream::resetHits()
+{
+	std::fill(hitDistance.begin(), hitDistance.end(), std::numeric_limits<float>::max());
+	std::fill(hitInstance.begin(), hitInstance.end(), -1);
+	std::fill(hitObject.begin(), hitObject.end(), -1);
+}
+
+template <typename T>
+void RayStream::permute(std::vector<T>& values, std::vector<T>& scratch) const
+{
+	for (uint32_t rayIdx = 0u; rayIdx < order.size(); rayIdx++)
+	{
+		scratch[rayIdx] = values[order[rayIdx]];
+	}
+	std::swap(values, scratch);
+}
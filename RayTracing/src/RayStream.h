@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/*
+* Every ray of one bounce in structure of arrays layout, with the closest hit found so far.
+* Sorting by direction octant and origin Morton code puts rays that visit the same nodes
+* next to each other, so a stream traversal touches every node once per batch of rays.
+*/
+class RayStream
+{
+public:
+	void resize(const uint32_t rayCnt);
+	uint32_t size() const { return (uint32_t)pathIds.size(); }
+
+	void setRay(const uint32_t rayIdx, const glm::vec3 origin, const glm::vec3 direction, const uint32_t pathId);
+	glm::vec3 getOrigin(const uint32_t rayIdx) const { return { originX[rayIdx], originY[rayIdx], originZ[rayIdx] }; }
+	glm::vec3 getDirection(const uint32_t rayIdx) const { return { directionX[rayIdx], directionY[rayIdx], directionZ[rayIdx] }; }
+
+	// Reorders the rays with their path ids, hits are reset afterwards
+	void sort();
+	void resetHits();
+
+public:
+	std::vector<float> originX;
+	std::vector<float> originY;
+	std::vector<float> originZ;
+	std::vector<float> directionX;
+	std::vector<float> directionY;
+	std::vector<float> directionZ;
+	std::vector<uint32_t> pathIds;
+
+	std::vector<float> hitDistance;
+	std::vector<int32_t> hitInstance;	// -1 for spheres, like closestInstance in the shader
+	std::vector<int32_t> hitObject;		// sphere or global triangle id, -1 on a miss
+
+private:
+	template <typename T>
+	void permute(std::vector<T>& values, std::vector<T>& scratch) const;
+
+private:
+	std::vector<uint32_t> keys = {};
+	std::vector<uint32_t> order = {};
+	std::vector<uint32_t> sortedKeys = {};
+	std::vector<uint32_t> sortedOrder = {};
+
+	// 3 octant bits above 27 Morton bits keep the key in 32 bits
+	static constexpr uint32_t mortonAxisBits = 9u;
+};
@@ -2,6 +2,8 @@
 #include <Engine/Startup/EntryPoint.h>
 
 #include <array>
+#include <chrono>
+#include <future>
 
 #include <Engine/Event/AppEvents.h>
 
@@ -13,7 +15,11 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/quaternion.hpp>
 
+#include "CpuTracer.h"
+#include "Headless.h"
+#include "MeshImporter.h"
 #include "SceneWrapper.h"
+#include "Scenes.h"
 
 class RayTracingClient : public RT::Frame
 {
@@ -52,8 +58,12 @@ public:
 		spheresStorage.reset();
 		bvhStorage.reset();
 		trianglesStorage.reset();
+		vertexPositionsStorage.reset();
+		vertexUVsStorage.reset();
 		meshWrappersStorage.reset();
 		meshInstanceWrappersStorage.reset();
+		instanceBoxesStorage.reset();
+		instanceIndicesStorage.reset();
 
 		accumulationTexture.reset();
 		outTexture.reset();
@@ -70,23 +80,41 @@ public:
 	float sampleSum = 0.0f;
 	void layout() final
 	{
+		collectCpuRender();
+
 		ImGui::Begin("Settings");
 		{
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 			ImGui::Text("App frame took: %.3fms", RT::Application::Get().appDuration());
-			ImGui::Text("GPU time: %.3fms", lastFrameDuration);
+			ImGui::Text("Render submit: %.3fms", lastFrameDuration);
 			ImGui::Text("CPU time: %.3fms", RT::Application::Get().appDuration() - lastFrameDuration);
+			for (const auto& scope : RT::Renderer::getGpuScopes())
+			{
+				ImGui::Text("GPU %s: %.3fms (avg %.3fms)", scope.name, scope.lastMs, scope.averageMs);
+				ImGui::PushID(scope.name);
+				ImGui::PlotLines("##history", scope.history.data(), scope.history.size(), scope.historyHead, nullptr, 0.0f, FLT_MAX, ImVec2{ 0.0f, 30.0f });
+				ImGui::PopID();
+			}
 			ImGui::Text("Frames: %d", infoUniform.frameIndex);
 
+			const auto memoryStats = RT::Renderer::getMemoryStats();
+			ImGui::Text("GPU memory: %.1f / %.1f MB (%u blocks, %u allocations, %.1f%% fragmented)",
+				memoryStats.usedSize / (1024.0f * 1024.0f),
+				memoryStats.reservedSize / (1024.0f * 1024.0f),
+				memoryStats.blockCnt,
+				memoryStats.allocationCnt,
+				100.0f * memoryStats.fragmentation);
+			ImGui::Text("Uploaded: %.1f KB/frame", memoryStats.frameUploadSize / 1024.0f);
+
 			infoUniform.frameIndex = accumulation ? infoUniform.frameIndex + 1 : 1;
 
-			if (ImGui::SliderInt("Bounces Limit", (int32_t*)&infoUniform.maxBounces, 1, 15))
+			if (ImGui::SliderInt("Bounces Limit", (int32_t*)&infoUniform.maxBounces, 1, (int32_t)bounceLimit))
 			{
-				ammountsUniform->setData(&infoUniform.maxBounces, sizeof(uint32_t), offsetof(InfoUniform, maxBounces));
+				selectShaderVariant();
 			}
-			if (ImGui::SliderInt("Acumulated Frames", (int32_t*)&infoUniform.maxFrames, 1, 5))
+			if (ImGui::SliderInt("Acumulated Frames", (int32_t*)&infoUniform.maxFrames, 1, (int32_t)frameLimit))
 			{
-				ammountsUniform->setData(&infoUniform.maxFrames, sizeof(uint32_t), offsetof(InfoUniform, maxFrames));
+				selectShaderVariant();
 			}
 			if (ImGui::Button("Reset"))
 			{
@@ -97,14 +125,14 @@ public:
 			if (ImGui::Checkbox("Draw Environment", &drawEnvironmentTranslator))
 			{
 				infoUniform.drawEnvironment = drawEnvironmentTranslator;
-				ammountsUniform->setData(&infoUniform.drawEnvironment, sizeof(float), offsetof(InfoUniform, drawEnvironment));
+				selectShaderVariant();
 			}
 
 			static auto prevSceneLabel = fmt::format("Scene: {}", selectedScene);
 			static int32_t selectedMeshId = 0;
 			if (ImGui::BeginCombo("Scenes", prevSceneLabel.c_str()))
 			{
-				for (int32_t i = 1; i <= 5; i++)
+				for (int32_t i = 1; i <= Scenes::count; i++)
 				{
 					const bool isSceneSelected = i == selectedScene;
 					const auto sceneLabel = fmt::format("Scene: {}", i);
@@ -130,6 +158,22 @@ public:
 			if (ImGui::SliderInt("Debug", (int32_t*)&infoUniform.debug, 0, 400))
 			{
 				ammountsUniform->setData(&infoUniform.debug, sizeof(uint32_t), offsetof(InfoUniform, debug));
+				selectShaderVariant();
+			}
+
+			ImGui::Separator();
+			ImGui::SliderInt("CPU Frames", &cpuFrameCnt, 1, 64);
+			if (nullptr != cpuRender)
+			{
+				ImGui::Text("Rendering on CPU: %u / %d frames", cpuRender->frameCnt.load(std::memory_order_relaxed), cpuRender->targetFrameCnt);
+			}
+			else if (ImGui::Button("Render on CPU"))
+			{
+				renderOnCpu();
+			}
+			if (cpuStats.rayCnt > 0u)
+			{
+				ImGui::Text("CPU render: %.3fms (%.2f Mrays/s)", cpuStats.renderTime, cpuStats.mraysPerSecond());
 			}
 		}
 		ImGui::End();
@@ -167,8 +211,11 @@ public:
 
 			bool shouldUpdateMaterials = false;
 			bool shouldUpdateSpeheres = false;
-			bool shouldUpdateMeshes = false;
+			// Imports finished since the last frame join the scene before its buffers are uploaded below
+			const auto importChanges = meshImporter.collect(scene, sceneWrapper);
+			bool shouldUpdateMeshes = importChanges.areMeshesChanged;
 			bool shouldUpdateObjects = false;
+			bool shouldRefitInstances = not importChanges.dirtyRegions.empty();
 
 			ImGui::Separator();
 
@@ -260,6 +307,7 @@ public:
 				{
 					sceneWrapper.spheres.emplace_back(Sphere{ { 0.0f, 0.0f, -2.0f }, 1.0f, 0 });
 					shouldUpdateSpeheres = true;
+					shouldRefitInstances = true;
 				}
 
 				for (size_t sphereId = 0u; sphereId < sceneWrapper.spheres.size(); sphereId++)
@@ -272,14 +320,18 @@ public:
 					ImGui::PushID((int32_t)sphereId);
 					auto& sphere = sceneWrapper.spheres[sphereId];
 
-					shouldUpdateSpeheres |= ImGui::DragFloat3("Position", glm::value_ptr(sphere.position), 0.1f);
-					shouldUpdateSpeheres |= ImGui::DragFloat("Radius", &sphere.radius, 0.01f, 0.0f, std::numeric_limits<float>::max());
+					// Spheres live in the top level hierarchy, so moving or resizing one refits it
+					bool isSphereMoved = ImGui::DragFloat3("Position", glm::value_ptr(sphere.position), 0.1f);
+					isSphereMoved |= ImGui::DragFloat("Radius", &sphere.radius, 0.01f, 0.0f, std::numeric_limits<float>::max());
+					shouldUpdateSpeheres |= isSphereMoved;
+					shouldRefitInstances |= isSphereMoved;
 					shouldUpdateSpeheres |= ImGui::SliderInt("Material", &sphere.materialId, 0, scene.materials.size() - 1);
 
 					if (ImGui::Button("Delete Sphere"))
 					{
 						sceneWrapper.spheres.erase(sceneWrapper.spheres.begin() + sphereId);
 						shouldUpdateSpeheres = true;
+						shouldRefitInstances = true;
 					}
 
 					ImGui::Separator();
@@ -295,7 +347,9 @@ public:
 				{
 					constexpr uint32_t maxPathLength = 260u;
 					static auto newMeshPathBuff = std::array<char, maxPathLength>{};
+					static auto newMeshBuildMode = BVH::BuildMode::SAH;
 					ImGui::InputText("Mesh path", newMeshPathBuff.data(), maxPathLength);
+					buildModeCombo("BVH builder", newMeshBuildMode);
 
 					if (ImGui::Button("Add Mesh"))
 					{
@@ -303,12 +357,56 @@ public:
 						const bool doesMeshExists = std::filesystem::exists(newMeshPath);
 						if (doesMeshExists)
 						{
-							auto& newMesh = scene.meshes.emplace_back();
-							newMesh.load(newMeshPath);
-							sceneWrapper.addMesh(newMesh);
+							meshImporter.submit(newMeshPath, newMeshBuildMode, sceneWrapper.getBinCount());
+						}
+					}
+
+					for (const auto& import : meshImporter.getImports())
+					{
+						const auto stage = import->stage.load(std::memory_order_acquire);
+						const auto importLabel = fmt::format("{}: {}", import->path.filename().string(), MeshImporter::stage2Str(stage));
+						ImGui::ProgressBar(MeshImporter::stage2Progress(stage), ImVec2{ -1.0f, 0.0f }, importLabel.c_str());
+					}
+
+					// Every mesh is rebuilt on change, so it happens only once the slider is released.
+					// Otherwise the scene's value is shown, a new scene starts from its own default.
+					auto binCount = draggedBinCount.value_or((int32_t)sceneWrapper.getBinCount());
+					if (ImGui::SliderInt("SAH bins", &binCount, 2, BVH::maxBinCount))
+					{
+						draggedBinCount = binCount;
+					}
+					if (ImGui::IsItemDeactivated() and draggedBinCount.has_value())
+					{
+						sceneWrapper.setBinCount(*std::exchange(draggedBinCount, std::nullopt));
+						shouldUpdateMeshes = true;
+					}
+				}
+
+				if (ImGui::TreeNode("Meshes"))
+				{
+					for (uint32_t meshId = 0u; meshId < scene.meshes.size(); meshId++)
+					{
+						ImGui::PushID((int32_t)meshId);
+						auto buildMode = sceneWrapper.buildModes[meshId];
+						if (buildModeCombo(fmt::format("Mesh: {}", meshId).c_str(), buildMode))
+						{
+							sceneWrapper.setBuildMode(meshId, buildMode);
 							shouldUpdateMeshes = true;
 						}
+
+						// Parsed and refitted on an import thread, collect hands back the ranges to upload
+						const auto& mesh = scene.meshes[meshId];
+						if (not mesh.getSourcePath().empty() and not meshImporter.isReloading(meshId))
+						{
+							ImGui::SameLine();
+							if (ImGui::Button("Reload"))
+							{
+								meshImporter.submitReload(meshId, scene, sceneWrapper);
+							}
+						}
+						ImGui::PopID();
 					}
+					ImGui::TreePop();
 				}
 
 				{
@@ -430,21 +528,54 @@ public:
 				}
 			if (shouldUpdateMeshes)
 			{
-				const uint32_t bvhStorSize = sizeof(BoundingBox) * sceneWrapper.boundingBoxes.size();
-				bvhStorage = RT::Uniform::create(RT::UniformType::Storage, bvhStorSize > 0 ? bvhStorSize : 1);
+				const uint32_t bvhStorSize = sizeof(WideNode) * sceneWrapper.wideNodes.size();
+				bvhStorage = RT::Uniform::create(RT::UniformType::StaticStorage, bvhStorSize > 0 ? bvhStorSize : 1);
 				pipeline->updateSet(1, 0, 2, *bvhStorage);
-				bvhStorage->setData(sceneWrapper.boundingBoxes.data(), bvhStorSize);
+				bvhStorage->setData(sceneWrapper.wideNodes.data(), bvhStorSize);
 
-				const uint32_t triStorSize = sizeof(RT::Triangle) * sceneWrapper.triangles.size();
-				trianglesStorage = RT::Uniform::create(RT::UniformType::Storage, triStorSize > 0 ? triStorSize : 1);
+				const uint32_t triStorSize = sizeof(glm::uvec3) * sceneWrapper.triangleIndices.size();
+				trianglesStorage = RT::Uniform::create(RT::UniformType::StaticStorage, triStorSize > 0 ? triStorSize : 1);
 				pipeline->updateSet(1, 0, 3, *trianglesStorage);
-				trianglesStorage->setData(sceneWrapper.triangles.data(), triStorSize);
+				trianglesStorage->setData(sceneWrapper.triangleIndices.data(), triStorSize);
+
+				const uint32_t posStorSize = sizeof(VertexPosition) * sceneWrapper.vertexPositions.size();
+				vertexPositionsStorage = RT::Uniform::create(RT::UniformType::StaticStorage, posStorSize > 0 ? posStorSize : 1);
+				pipeline->updateSet(1, 0, 9, *vertexPositionsStorage);
+				vertexPositionsStorage->setData(sceneWrapper.vertexPositions.data(), posStorSize);
+
+				const uint32_t uvStorSize = sizeof(glm::vec2) * sceneWrapper.vertexUVs.size();
+				vertexUVsStorage = RT::Uniform::create(RT::UniformType::StaticStorage, uvStorSize > 0 ? uvStorSize : 1);
+				pipeline->updateSet(1, 0, 10, *vertexUVsStorage);
+				vertexUVsStorage->setData(sceneWrapper.vertexUVs.data(), uvStorSize);
 
 				const uint32_t objStorSize = sizeof(MeshWrapper) * sceneWrapper.meshWrappers.size();
-				meshWrappersStorage = RT::Uniform::create(RT::UniformType::Storage, objStorSize > 0 ? objStorSize : 1);
+				meshWrappersStorage = RT::Uniform::create(RT::UniformType::StaticStorage, objStorSize > 0 ? objStorSize : 1);
 				pipeline->updateSet(1, 0, 4, *meshWrappersStorage);
 				meshWrappersStorage->setData(sceneWrapper.meshWrappers.data(), objStorSize);
 			}
+			else
+			{
+				// Same triangle and vertex counts keep the topology, so only the refitted part is uploaded
+				for (const auto& dirtyRegion : importChanges.dirtyRegions)
+				{
+					const auto [nodesBegin, nodesEnd] = dirtyRegion.nodes;
+					if (nodesBegin < nodesEnd)
+					{
+						bvhStorage->setData(&sceneWrapper.wideNodes[nodesBegin], sizeof(WideNode) * (nodesEnd - nodesBegin), sizeof(WideNode) * nodesBegin);
+					}
+					const auto [trianglesBegin, trianglesEnd] = dirtyRegion.triangles;
+					if (trianglesBegin < trianglesEnd)
+					{
+						trianglesStorage->setData(&sceneWrapper.triangleIndices[trianglesBegin], sizeof(glm::uvec3) * (trianglesEnd - trianglesBegin), sizeof(glm::uvec3) * trianglesBegin);
+					}
+					const auto [verticesBegin, verticesEnd] = dirtyRegion.vertices;
+					if (verticesBegin < verticesEnd)
+					{
+						vertexPositionsStorage->setData(&sceneWrapper.vertexPositions[verticesBegin], sizeof(VertexPosition) * (verticesEnd - verticesBegin), sizeof(VertexPosition) * verticesBegin);
+						vertexUVsStorage->setData(&sceneWrapper.vertexUVs[verticesBegin], sizeof(glm::vec2) * (verticesEnd - verticesBegin), sizeof(glm::vec2) * verticesBegin);
+					}
+				}
+			}
 			if (shouldUpdateObjects)
 			{
 				if (sceneWrapper.meshInstanceWrappers.size() != infoUniform.objectsCount)
@@ -460,6 +591,27 @@ public:
 				 
 				meshInstanceWrappersStorage->setData(sceneWrapper.meshInstanceWrappers.data(), sizeof(MeshInstanceWrapper) * sceneWrapper.meshInstanceWrappers.size());
 			}
+			if (shouldUpdateMeshes or shouldUpdateObjects or shouldRefitInstances)
+			{
+				// Transform and sphere edits only refit the TLAS, adding or removing instances or spheres rebuilds it
+				const auto instanceCount = sceneWrapper.instanceIndices.size();
+				const auto instanceBoxCount = sceneWrapper.instanceBoxes.size();
+				sceneWrapper.refitInstanceHierarchy();
+
+				const uint32_t boxStorSize = sizeof(BoundingBox) * sceneWrapper.instanceBoxes.size();
+				const uint32_t idxStorSize = sizeof(uint32_t) * sceneWrapper.instanceIndices.size();
+				if (instanceCount != sceneWrapper.instanceIndices.size() or instanceBoxCount != sceneWrapper.instanceBoxes.size())
+				{
+					instanceBoxesStorage = RT::Uniform::create(RT::UniformType::Storage, boxStorSize > 0 ? boxStorSize : 1);
+					pipeline->updateSet(1, 0, 7, *instanceBoxesStorage);
+
+					instanceIndicesStorage = RT::Uniform::create(RT::UniformType::Storage, idxStorSize > 0 ? idxStorSize : 1);
+					pipeline->updateSet(1, 0, 8, *instanceIndicesStorage);
+				}
+
+				instanceBoxesStorage->setData(sceneWrapper.instanceBoxes.data(), boxStorSize);
+				instanceIndicesStorage->setData(sceneWrapper.instanceIndices.data(), idxStorSize);
+			}
 		}
 		ImGui::End();
 
@@ -519,6 +671,30 @@ public:
 	}
 
 private:
+	bool buildModeCombo(const char* label, BVH::BuildMode& buildMode)
+	{
+		bool isChanged = false;
+		if (ImGui::BeginCombo(label, BVH::buildMode2Str(buildMode)))
+		{
+			for (const auto mode : { BVH::BuildMode::SAH, BVH::BuildMode::Linear, BVH::BuildMode::Spatial })
+			{
+				const bool isModeSelected = mode == buildMode;
+				if (ImGui::Selectable(BVH::buildMode2Str(mode), isModeSelected))
+				{
+					isChanged = not isModeSelected;
+					buildMode = mode;
+				}
+
+				if (isModeSelected)
+				{
+					ImGui::SetItemDefaultFocus();
+				}
+			}
+			ImGui::EndCombo();
+		}
+		return isChanged;
+	}
+
 	void updateView(float ts)
 	{
 		const float speed = 1.0f;
@@ -633,202 +809,108 @@ private:
 
 	void loadScene(const int32_t sceneNr)
 	{
-		switch (sceneNr)
+		textures.clear();
+		texturePaths.clear();
+		Scenes::load(sceneNr, scene, sceneWrapper, texturePaths);
+		for (const auto& path : texturePaths)
 		{
-			case 1:
-			{
-				//**// SCENE 1 //**//
-				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
-				scene.materials.emplace_back(RT::Material{ { 0.0f, 0.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
-				scene.materials.emplace_back(RT::Material{ { 1.0f, 0.0f, 0.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
-
-				sceneWrapper.spheres.emplace_back(Sphere{ { 0.0f, 0.0f, -10007.0f }, 10000.0f, 0 });
-				sceneWrapper.spheres.emplace_back(Sphere{ { 0.0f, 0.0f, 10003.0f }, 10000.0f, 0 });
-				sceneWrapper.spheres.emplace_back(Sphere{ { 0.0f, -10001.0f, -2.0f }, 10000.0f, 0 });
-				sceneWrapper.spheres.emplace_back(Sphere{ { 0.0f, 10009.0f, -2.0f }, 10000.0f, 0 });
-				sceneWrapper.spheres.emplace_back(Sphere{ { -10005.0f, 0.0f, -2.0f }, 10000.0f, 1 });
-				sceneWrapper.spheres.emplace_back(Sphere{ { 10005.0f, 0.0f, -2.0f }, 10000.0f, 2 });
-
-				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 1.0f, 1.0f, -1 });
-				sceneWrapper.spheres.emplace_back(Sphere{ { 0.0f, 18.8f, -2.0f }, 10.0f, 3 });
-				//**// SCENE 1 //**//
-			
-				break;
-			}
+			auto& texture = textures.emplace_back(RT::Texture::create(path));
+			texture->transition(RT::Texture::Access::Read, RT::Texture::Layout::General);
+		}
 
-			case 2:
-			{
-				//**// SCENE 2 //**//
-				textures.emplace_back(RT::Texture::create(assetDir / "textures" / "templategrid_albedo.png"));
-				textures[0]->transition(RT::Texture::Access::Read, RT::Texture::Layout::General);
-
-				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.7f, 0.0f, 0.0f, 1.5f, -1 });
-				scene.materials.emplace_back(RT::Material{ { 0.2f, 0.5f, 0.7f }, 0.0, { 0.2f, 0.5f, 0.7f }, 0.0f, 0.0f, 0.0f, 1.0f,  0 });
-				scene.materials.emplace_back(RT::Material{ { 0.8f, 0.6f, 0.5f }, 0.0, { 0.8f, 0.6f, 0.5f }, 0.0f, 0.0f, 1.0f, 1.0f, -1 });
-				scene.materials.emplace_back(RT::Material{ { 0.4f, 0.3f, 0.8f }, 0.0, { 0.8f, 0.6f, 0.5f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
-
-				sceneWrapper.spheres.emplace_back(Sphere{ { 0.0f, 0.0f, -2.0f }, 1.0f, 0 });
-				
-				auto triBuffer = std::vector<RT::Triangle>{
-					RT::Triangle{
-						{ -50.0f, -1.0f, -50.0f }, { -50.0f, -1.0f,  50.0f }, {  50.0f, -1.0f, -50.0f },
-						{  0.0,  0.0 }, {  0.0, 10.0 }, { 10.0,  0.0 }},
-					RT::Triangle{
-						{  50.0f, -1.0f,  50.0f }, {  50.0f, -1.0f, -50.0f }, { -50.0f, -1.0f,  50.0f },
-						{ 10.0, 10.0 }, { 10.0,  0.0 }, {  0.0, 10.0 }}};
-				scene.meshes.emplace_back(triBuffer);
-				
-				scene.objects.emplace_back(0);
-				scene.objects[0].materialId = 1;
-
-				sceneWrapper.spheres.emplace_back(Sphere{ {  2.5f, 0.0f, -2.0f }, 1.0f, 2 });
-				sceneWrapper.spheres.emplace_back(Sphere{ { -2.5f, 0.0f, -2.0f }, 1.0f, 3 });
-
-				//auto pcg_hash = [](uint32_t input) -> uint32_t
-				//{
-				//	uint32_t state = input * 747796405u + 2891336453u;
-				//	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
-				//	return (word >> 22u) ^ word;
-				//};
-
-				//auto FastRandom = [&pcg_hash](uint32_t& seed) -> float
-				//{
-				//	seed = pcg_hash(seed);
-				//	return (float)seed / std::numeric_limits<uint32_t>::max();
-				//}
-
-				//uint32_t seed = 93262352u;
-				//auto getRandPos = [&seed](float rad) { return FastRandom(seed) * rad - rad / 2; };
-
-				//for (int i = 0; i < 70; i++)
-				//{
-				//	scene.materials.emplace_back(RT::Material{ });
-				//	scene.materials[scene.materials.size() - 1].albedo = { FastRandom(seed), FastRandom(seed), FastRandom(seed) };
-				//	scene.materials[scene.materials.size() - 1].emissionColor = { FastRandom(seed), FastRandom(seed), FastRandom(seed) };
-				//	scene.materials[scene.materials.size() - 1].roughness = FastRandom(seed) > 0.9 ? 0.f : FastRandom(seed);
-				//	scene.materials[scene.materials.size() - 1].metalic = FastRandom(seed) > 0.9 ? FastRandom(seed) : 0.f;
-				//	scene.materials[scene.materials.size() - 1].specularProbability= FastRandom(seed) > 0.9 ? FastRandom(seed) : 0.f;
-				//	scene.materials[scene.materials.size() - 1].emissionPower = FastRandom(seed) > 0.9 ? FastRandom(seed) : 0.f;
-				//	scene.materials[scene.materials.size() - 1].refractionRatio = 1.0f;
-				//	scene.materials[scene.materials.size() - 1].textureId = -1;
-
-				//	scene.spheres.emplace_back(RT::Sphere{ });
-				//	scene.spheres[scene.spheres.size() - 1].position = { getRandPos(10.0f), -0.75, getRandPos(10.0f) - 2 };
-				//	scene.spheres[scene.spheres.size() - 1].radius = 0.25;
-				//	scene.spheres[scene.spheres.size() - 1].materialId = scene.materials.size() - 1;
-				//}
-				//**// SCENE 2 //**//
-			
-				break;
-			}
+		sceneWrapper.build();
+		constructScene();
+	}
 
-			case 3:
-			{
-				//**// SCENE 3 //**//
-				textures.emplace_back(RT::Texture::create(assetDir / "textures" / "checkered.jpg"));
-				textures[0]->transition(RT::Texture::Access::Read, RT::Texture::Layout::General);
-
-				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
-				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f,  0 });
-				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
-				scene.materials.emplace_back(RT::Material{ { 1.0f, 0.0f, 0.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
-				scene.materials.emplace_back(RT::Material{ { 0.0f, 1.0f, 0.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
-				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 8.0f, 1.0f, -1 });
-
-				scene.meshes.emplace_back().load(assetDir / "models" / "tinyStanfordDragon.glb");
-				auto& dragon = scene.objects.emplace_back(0);
-				dragon.position = glm::vec3{ 0.0f, 1.4f, -2.0f };
-				dragon.scale = glm::vec3{ 5.0f };
-				dragon.rotation = glm::vec3{ 0.0f, 128.0, 0.0f };
-				dragon.materialId = 0;
-
-				auto triBottom = std::vector<RT::Triangle>{
-					RT::Triangle{
-						{  3.0f, 0.0f,  1.0f }, {  3.0f, 0.0f, -5.0f }, { -3.0f, 0.0f, 1.0f },
-						{ 0.0, 0.0 }, { 0.0, 1.0 }, { 1.0, 0.0 }},
-					RT::Triangle{
-						{ -3.0f, 0.0f, -5.0f }, { -3.0f, 0.0f,  1.0f }, {  3.0f, 0.0f, -5.0f },
-						{ 1.0, 1.0 }, { 1.0, 0.0 }, { 0.0, 1.0 }}};
-				auto triTop = std::vector<RT::Triangle>{
-					RT::Triangle{
-						{  3.0f, 6.0f, -5.0f }, {  3.0f, 6.0f,  1.0f }, { -3.0f, 6.0f, -5.0f },
-						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }},
-					RT::Triangle{
-						{ -3.0f, 6.0f, -5.0f }, {  3.0f, 6.0f,  1.0f }, { -3.0f, 6.0f,  1.0f },
-						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }}};
-				auto triBack = std::vector<RT::Triangle>{
-					RT::Triangle{
-						{  3.0f, 0.0f, -5.0f }, {  3.0f, 6.0f, -5.0f }, { -3.0f, 0.0f, -5.0f },
-						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }},
-					RT::Triangle{
-						{ -3.0f, 0.0f, -5.0f }, {  3.0f, 6.0f, -5.0f }, { -3.0f, 6.0f, -5.0f },
-						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }} };
-				auto triFront = std::vector<RT::Triangle>{
-					RT::Triangle{
-						{  3.0f, 6.0f, 1.0f }, {  3.0f, 0.0f, 1.0f }, { -3.0f, 0.0f, 1.0f },
-						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }},
-					RT::Triangle{
-						{  3.0f, 6.0f, 1.0f }, { -3.0f, 0.0f, 1.0f }, { -3.0f, 6.0f, 1.0f },
-						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }} };
-				auto triLeft = std::vector<RT::Triangle>{
-					RT::Triangle{
-						{ 3.0f, 0.0f, -5.0f }, { 3.0f, 0.0f,  1.0f }, { 3.0f, 6.0f, -5.0f },
-						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }
-					},
-					RT::Triangle{
-						{ 3.0f, 0.0f,  1.0f }, { 3.0f, 6.0f,  1.0f }, { 3.0f, 6.0f, -5.0f },
-						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }} };
-				auto triRight = std::vector<RT::Triangle>{
-					RT::Triangle{
-						{ -3.0f, 0.0f, -5.0f }, { -3.0f, 6.0f, -5.0f }, { -3.0f, 0.0f,  1.0f },
-						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }},
-					RT::Triangle{
-						{ -3.0f, 0.0f,  1.0f }, { -3.0f, 6.0f, -5.0f }, { -3.0f, 6.0f,  1.0f },
-						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }} };
-
-				auto triLight = std::vector<RT::Triangle>{
-					RT::Triangle{
-						{  1.0f, 5.9f, -3.0f }, {  1.0f, 5.9f, -1.0f }, { -1.0f, 5.9f, -3.0f },
-						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }},
-					RT::Triangle{
-						{ -1.0f, 5.9f, -3.0f }, {  1.0f, 5.9f, -1.0f }, { -1.0f, 5.9f, -1.0f },
-						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }}};
-
-				scene.meshes.emplace_back(triBottom);
-				scene.meshes.emplace_back(triTop);
-				scene.meshes.emplace_back(triBack);
-				scene.meshes.emplace_back(triFront);
-				scene.meshes.emplace_back(triLeft);
-				scene.meshes.emplace_back(triRight);
-				scene.meshes.emplace_back(triLight);
-
-				scene.objects.emplace_back(1).materialId = 1;
-				scene.objects.emplace_back(2).materialId = 2;
-				scene.objects.emplace_back(3).materialId = 2;
-				scene.objects.emplace_back(4).materialId = 2;
-				scene.objects.emplace_back(5).materialId = 3;
-				scene.objects.emplace_back(6).materialId = 4;
-				scene.objects.emplace_back(7).materialId = 5;
-				//**// SCENE 3 //**//
-
-				break;
-			}
-			case 4:
-			{
-				//**// SCENE 4 //**//
-				// Dev platform
-				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
+	// Settings baked into the shader, a combination is built once and then reused while the pipeline keeps it
+	static RT::ShaderVariant shaderVariant(const uint32_t bounces, const uint32_t frames, const bool drawEnvironment, const bool isDebug)
+	{
+		auto variant = RT::ShaderVariant{};
+		variant.constants = { bounces, frames, drawEnvironment ? 1u : 0u };
+		variant.defines.emplace_back("BINARY_STACK_DEPTH", fmt::format("{}u", BVH::binaryStackDepth));
+		variant.defines.emplace_back("WIDE_STACK_DEPTH", fmt::format("{}u", BVH::wideStackDepth));
+		if (isDebug)
+		{
+			variant.defines.emplace_back("DEBUG_BVH", "");
+		}
+		return variant;
+	}
+
+	RT::ShaderVariant shaderVariant() const
+	{
+		return shaderVariant(infoUniform.maxBounces, infoUniform.maxFrames, drawEnvironmentTranslator, infoUniform.debug > 0);
+	}
 
-				scene.meshes.emplace_back().load(assetDir / "models" / "tinyStanfordDragon.glb");
-				scene.objects.emplace_back(0);
-				//**// SCENE 4 //**//
+	// Settings one slider step or toggle away, built in the background so the next change only rebinds a pipeline
+	std::vector<RT::ShaderVariant> neighbourVariants() const
+	{
+		const uint32_t bounces = infoUniform.maxBounces;
+		const uint32_t frames = infoUniform.maxFrames;
+		const bool isDebug = infoUniform.debug > 0;
+
+		auto variants = std::vector<RT::ShaderVariant>{};
+		if (bounces > 1u)
+		{
+			variants.push_back(shaderVariant(bounces - 1u, frames, drawEnvironmentTranslator, isDebug));
+		}
+		if (bounces < bounceLimit)
+		{
+			variants.push_back(shaderVariant(bounces + 1u, frames, drawEnvironmentTranslator, isDebug));
+		}
+		if (frames > 1u)
+		{
+			variants.push_back(shaderVariant(bounces, frames - 1u, drawEnvironmentTranslator, isDebug));
+		}
+		if (frames < frameLimit)
+		{
+			variants.push_back(shaderVariant(bounces, frames + 1u, drawEnvironmentTranslator, isDebug));
+		}
+		variants.push_back(shaderVariant(bounces, frames, not drawEnvironmentTranslator, isDebug));
+		variants.push_back(shaderVariant(bounces, frames, drawEnvironmentTranslator, not isDebug));
+		return variants;
+	}
 
-				break;
+	void selectShaderVariant()
+	{
+		pipeline->selectVariant(shaderVariant());
+		pipeline->prepareVariants(neighbourVariants());
+	}
+
+	// Traced on its own thread against a copy of the scene buffers, so the window keeps running and the scene may change
+	void renderOnCpu()
+	{
+		cpuRender = RT::makeLocal<CpuRender>(scene, sceneWrapper);
+		cpuRender->targetFrameCnt = cpuFrameCnt;
+
+		const auto settings = CpuTracer::Settings{ infoUniform.drawEnvironment, infoUniform.maxBounces, infoUniform.maxFrames };
+		cpuRender->task = std::async(std::launch::async, [&render = *cpuRender, texturePaths = texturePaths, resolution = glm::uvec2{ infoUniform.resolution }, cameraSpec = camera.getSpec(), settings]
+		{
+			render.tracer.loadTextures(texturePaths, Scenes::skyMapPath);
+			render.tracer.resize(resolution);
+			for (int32_t frame = 0; frame < render.targetFrameCnt; frame++)
+			{
+				const auto frameStats = render.tracer.render(cameraSpec, settings);
+				render.stats.rayCnt += frameStats.rayCnt;
+				render.stats.renderTime += frameStats.renderTime;
+				render.frameCnt.fetch_add(1u, std::memory_order_release);
 			}
+			render.isWritten = render.tracer.resolve().write(cpuRenderPath);
+		});
+	}
+
+	// Picks up a finished CPU render at the frame boundary, like MeshImporter::collect
+	void collectCpuRender()
+	{
+		using namespace std::chrono_literals;
+		if (nullptr == cpuRender or std::future_status::ready != cpuRender->task.wait_for(0s))
+		{
+			return;
 		}
 
-		sceneWrapper.build();
-		constructScene();
+		cpuStats = cpuRender->stats;
+		LOG_INFO("CPU render: {} frames, {} rays in {} ms, {} Mrays/s, {} {}",
+			cpuRender->targetFrameCnt, cpuStats.rayCnt, cpuStats.renderTime, cpuStats.mraysPerSecond(), cpuRender->isWritten ? "saved to" : "failed to save", cpuRenderPath);
+		cpuRender.reset();
 	}
 
 	void constructScene()
@@ -838,7 +920,7 @@ private:
 
 		outTexture = RT::Texture::create(lastWinSize, RT::Texture::Format::RGBA8);
 
-		skyMap = RT::Texture::create(assetDir / "skyMaps" / "evening_road_01_puresky_1k.hdr", RT::Texture::Filter::Linear, RT::Texture::Mode::ClampToEdge);
+		skyMap = RT::Texture::create(Scenes::skyMapPath, RT::Texture::Filter::Linear, RT::Texture::Mode::ClampToEdge);
 		skyMap->transition(RT::Texture::Access::Read, RT::Texture::Layout::General);
 
 		infoUniform.resolution = lastWinSize;
@@ -859,21 +941,31 @@ private:
 		spheresStorage = RT::Uniform::create(RT::UniformType::Storage, sceneWrapper.spheres.size() > 0 ? sizeof(Sphere) * sceneWrapper.spheres.size() : 1);
 		spheresStorage->setData(sceneWrapper.spheres.data(), sizeof(Sphere) * sceneWrapper.spheres.size());
 
-		bvhStorage = RT::Uniform::create(RT::UniformType::Storage, sceneWrapper.boundingBoxes.size() > 0 ? sizeof(BoundingBox) * sceneWrapper.boundingBoxes.size() : 1);
-		bvhStorage->setData(sceneWrapper.boundingBoxes.data(), sizeof(BoundingBox) * sceneWrapper.boundingBoxes.size());
+		bvhStorage = RT::Uniform::create(RT::UniformType::StaticStorage, sceneWrapper.wideNodes.size() > 0 ? sizeof(WideNode) * sceneWrapper.wideNodes.size() : 1);
+		bvhStorage->setData(sceneWrapper.wideNodes.data(), sizeof(WideNode) * sceneWrapper.wideNodes.size());
 
-		trianglesStorage = RT::Uniform::create(RT::UniformType::Storage, sceneWrapper.triangles.size() > 0 ? sizeof(RT::Triangle) * sceneWrapper.triangles.size() : 1);
-		trianglesStorage->setData(sceneWrapper.triangles.data(), sizeof(RT::Triangle) * sceneWrapper.triangles.size());
+		trianglesStorage = RT::Uniform::create(RT::UniformType::StaticStorage, sceneWrapper.triangleIndices.size() > 0 ? sizeof(glm::uvec3) * sceneWrapper.triangleIndices.size() : 1);
+		trianglesStorage->setData(sceneWrapper.triangleIndices.data(), sizeof(glm::uvec3) * sceneWrapper.triangleIndices.size());
 
-		meshWrappersStorage = RT::Uniform::create(RT::UniformType::Storage, sceneWrapper.meshWrappers.size() > 0 ? sizeof(MeshWrapper) * sceneWrapper.meshWrappers.size() : 1);
+		vertexPositionsStorage = RT::Uniform::create(RT::UniformType::StaticStorage, sceneWrapper.vertexPositions.size() > 0 ? sizeof(VertexPosition) * sceneWrapper.vertexPositions.size() : 1);
+		vertexPositionsStorage->setData(sceneWrapper.vertexPositions.data(), sizeof(VertexPosition) * sceneWrapper.vertexPositions.size());
+
+		vertexUVsStorage = RT::Uniform::create(RT::UniformType::StaticStorage, sceneWrapper.vertexUVs.size() > 0 ? sizeof(glm::vec2) * sceneWrapper.vertexUVs.size() : 1);
+		vertexUVsStorage->setData(sceneWrapper.vertexUVs.data(), sizeof(glm::vec2) * sceneWrapper.vertexUVs.size());
+
+		meshWrappersStorage = RT::Uniform::create(RT::UniformType::StaticStorage, sceneWrapper.meshWrappers.size() > 0 ? sizeof(MeshWrapper) * sceneWrapper.meshWrappers.size() : 1);
 		meshWrappersStorage->setData(sceneWrapper.meshWrappers.data(), sizeof(MeshWrapper) * sceneWrapper.meshWrappers.size());
 
 		meshInstanceWrappersStorage = RT::Uniform::create(RT::UniformType::Storage, sceneWrapper.meshInstanceWrappers.size() > 0 ? sizeof(MeshInstanceWrapper) * sceneWrapper.meshInstanceWrappers.size() : 1);
 		meshInstanceWrappersStorage->setData(sceneWrapper.meshInstanceWrappers.data(), sizeof(MeshInstanceWrapper) * sceneWrapper.meshInstanceWrappers.size());
 
-		auto pipelineSpec = RT::PipelineSpec{};
-		pipelineSpec.shaderPath = assetDir / "shaders" / "RayTracing.shader";
-		pipelineSpec.uniformLayouts = RT::UniformLayouts{
+		instanceBoxesStorage = RT::Uniform::create(RT::UniformType::Storage, sceneWrapper.instanceBoxes.size() > 0 ? sizeof(BoundingBox) * sceneWrapper.instanceBoxes.size() : 1);
+		instanceBoxesStorage->setData(sceneWrapper.instanceBoxes.data(), sizeof(BoundingBox) * sceneWrapper.instanceBoxes.size());
+
+		instanceIndicesStorage = RT::Uniform::create(RT::UniformType::Storage, sceneWrapper.instanceIndices.size() > 0 ? sizeof(uint32_t) * sceneWrapper.instanceIndices.size() : 1);
+		instanceIndicesStorage->setData(sceneWrapper.instanceIndices.data(), sizeof(uint32_t) * sceneWrapper.instanceIndices.size());
+
+		auto uniformLayouts = RT::UniformLayouts{
 			{.nrOfSets = 1, .layout = {
 				{.type = RT::UniformType::Image,	.count = 1 },
 				{.type = RT::UniformType::Image,	.count = 1 },
@@ -887,10 +979,28 @@ private:
 				{.type = RT::UniformType::Storage, .count = 1 },
 				{.type = RT::UniformType::Storage, .count = 1 },
 				{.type = RT::UniformType::Storage, .count = 1 },
-				{.type = RT::UniformType::Sampler, .count = 0 < (uint32_t)textures.size() ? (uint32_t)textures.size() : 1 } } }
+				{.type = RT::UniformType::Sampler, .count = 0 < (uint32_t)textures.size() ? (uint32_t)textures.size() : 1 },
+				{.type = RT::UniformType::Storage, .count = 1 },
+				{.type = RT::UniformType::Storage, .count = 1 },
+				{.type = RT::UniformType::Storage, .count = 1 },
+				{.type = RT::UniformType::Storage, .count = 1 } } }
 		};
-		pipelineSpec.attachmentFormats = {};
-		pipeline = RT::Pipeline::create(pipelineSpec);
+
+		// The built variants stay valid while the descriptor layout does, so only the bindings below are rewritten
+		if (nullptr == pipeline or uniformLayouts != pipelineLayouts)
+		{
+			// Stops the previous builds before the new pipeline compiles the same shader
+			pipeline.reset();
+			pipelineLayouts = uniformLayouts;
+
+			auto pipelineSpec = RT::PipelineSpec{};
+			pipelineSpec.shaderPath = assetDir / "shaders" / "RayTracing.shader";
+			pipelineSpec.uniformLayouts = std::move(uniformLayouts);
+			pipelineSpec.attachmentFormats = {};
+			pipelineSpec.variant = shaderVariant();
+			pipeline = RT::Pipeline::create(pipelineSpec);
+			pipeline->prepareVariants(neighbourVariants());
+		}
 
 		pipeline->updateSet(0, 0, 0, *accumulationTexture);
 		pipeline->updateSet(0, 0, 1, *outTexture);
@@ -903,6 +1013,10 @@ private:
 		pipeline->updateSet(1, 0, 3, *trianglesStorage);
 		pipeline->updateSet(1, 0, 4, *meshWrappersStorage);
 		pipeline->updateSet(1, 0, 5, *meshInstanceWrappersStorage);
+		pipeline->updateSet(1, 0, 7, *instanceBoxesStorage);
+		pipeline->updateSet(1, 0, 8, *instanceIndicesStorage);
+		pipeline->updateSet(1, 0, 9, *vertexPositionsStorage);
+		pipeline->updateSet(1, 0, 10, *vertexUVsStorage);
 		if (0 < textures.size())
 		{
 			pipeline->updateSet(1, 0, 6, textures);
@@ -919,11 +1033,13 @@ private:
 	RT::Camera camera;
 	RT::Scene scene;
 	SceneWrapper sceneWrapper;
+	MeshImporter meshImporter;
 
 	RT::Local<RT::Texture> accumulationTexture;
 	RT::Local<RT::Texture> outTexture;
 	RT::Local<RT::Texture> skyMap;
 	RT::TextureArray textures;
+	std::vector<std::filesystem::path> texturePaths;
 
 	RT::Local<RT::Uniform> cameraUniform;
 	RT::Local<RT::Uniform> ammountsUniform;
@@ -931,14 +1047,51 @@ private:
 	RT::Local<RT::Uniform> spheresStorage;
 	RT::Local<RT::Uniform> bvhStorage;
 	RT::Local<RT::Uniform> trianglesStorage;
+	RT::Local<RT::Uniform> vertexPositionsStorage;
+	RT::Local<RT::Uniform> vertexUVsStorage;
 	RT::Local<RT::Uniform> meshWrappersStorage;
 	RT::Local<RT::Uniform> meshInstanceWrappersStorage;
+	RT::Local<RT::Uniform> instanceBoxesStorage;
+	RT::Local<RT::Uniform> instanceIndicesStorage;
 
 	RT::Local<RT::Pipeline> pipeline;
+	RT::UniformLayouts pipelineLayouts;
+
+	// Ranges of the settings baked into shader variants
+	static constexpr uint32_t bounceLimit = 15u;
+	static constexpr uint32_t frameLimit = 5u;
 
 	bool accumulation = false;
 	bool drawEnvironmentTranslator = false;
 
+	std::optional<int32_t> draggedBinCount;	// slider value not yet applied to the scene
+
+	// Owns what its thread reads, the scene is declared first as the wrapper refers to it
+	struct CpuRender
+	{
+		CpuRender(const RT::Scene& sourceScene, const SceneWrapper& sourceWrapper)
+			: scene{ .materials = sourceScene.materials }	// the tracer reads nothing else from the scene
+			, sceneWrapper{ sourceWrapper.snapshot(scene) }
+			, tracer{ scene, sceneWrapper }
+		{
+		}
+
+		RT::Scene scene;
+		SceneWrapper sceneWrapper;
+		CpuTracer tracer;
+		int32_t targetFrameCnt = 0;
+
+		// Written by the render thread, only the progress is read before the task is ready
+		std::atomic<uint32_t> frameCnt = 0u;
+		CpuTracer::Stats stats = {};
+		bool isWritten = false;
+		std::future<void> task = {};
+	};
+
+	int32_t cpuFrameCnt = 16;
+	CpuTracer::Stats cpuStats = {};
+	RT::Local<CpuRender> cpuRender;
+
 	struct InfoUniform
 	{
 		float drawEnvironment = (float)false;
@@ -972,6 +1125,7 @@ private:
 	//static constexpr int32_t screenVerticesCount = sizeof(screenVertices) / sizeof(float);
 
 	inline static const auto assetDir = std::filesystem::path("assets");
+	inline static const auto cpuRenderPath = std::filesystem::path("cpu_render.png");
 };
 
-RegisterStartupFrame("Ray Tracing", RayTracingClient)
+RegisterStartupFrameWithHeadless("Ray Tracing", RayTracingClient, runHeadless)
@@ -1,5 +1,7 @@
 #include "SceneWrapper.h"
 
+#include <cstring>
+
 #include "Engine/Core/Log.h"
 
 SceneWrapper::SceneWrapper(RT::Scene& scene)
@@ -18,21 +20,131 @@ void SceneWrapper::build()
 	{
 		addMeshInstance(object);
 	}
+
+	buildInstanceHierarchy();
+}
+
+void SceneWrapper::addMesh(const RT::Mesh& mesh, const BVH::BuildMode buildMode)
+{
+	addMesh(mesh, buildMode, buildMesh(mesh, buildMode, binCount));
+}
+
+void SceneWrapper::addMesh(const RT::Mesh& mesh, const BVH::BuildMode buildMode, MeshBuild build)
+{
+	meshWrappers.emplace_back(MeshWrapper{ (uint32_t)wideNodes.size(), (uint32_t)triangleIndices.size(), 0, (uint32_t)boundingBoxes.size(), (uint32_t)vertexPositions.size() });
+	buildModes.push_back(buildMode);
+	meshBvhs.push_back(std::move(build.bvh));
+
+	boundingBoxes.insert(boundingBoxes.end(), build.hierarchy.begin(), build.hierarchy.end());
+	triangleIndices.insert(triangleIndices.end(), build.indices.begin(), build.indices.end());
+	wideNodes.insert(wideNodes.end(), build.nodes.begin(), build.nodes.end());
+	insertVertices(vertexPositions.size(), mesh.getModel().vertices);
+}
+
+void SceneWrapper::setBuildMode(const uint32_t meshId, const BVH::BuildMode buildMode)
+{
+	if (buildModes[meshId] == buildMode)
+	{
+		return;
+	}
+	buildModes[meshId] = buildMode;
+
+	rebuildMesh(meshId);
+}
+
+void SceneWrapper::setBinCount(const uint32_t binCount)
+{
+	if (this->binCount == binCount)
+	{
+		return;
+	}
+	this->binCount = binCount;
+
+	for (uint32_t meshId = 0u; meshId < meshWrappers.size(); meshId++)
+	{
+		rebuildMesh(meshId);
+	}
+}
+
+SceneWrapper SceneWrapper::snapshot(RT::Scene& scene) const
+{
+	// Hierarchies are only kept for refits and rebuilds, so the copy goes without them
+	auto copy = SceneWrapper{ scene };
+	copy.spheres = spheres;
+	copy.boundingBoxes = boundingBoxes;
+	copy.wideNodes = wideNodes;
+	copy.triangleIndices = triangleIndices;
+	copy.vertexPositions = vertexPositions;
+	copy.vertexUVs = vertexUVs;
+	copy.meshWrappers = meshWrappers;
+	copy.meshInstanceWrappers = meshInstanceWrappers;
+	copy.buildModes = buildModes;
+	copy.instanceBoxes = instanceBoxes;
+	copy.instanceIndices = instanceIndices;
+	copy.binCount = binCount;
+	return copy;
+}
+
+void SceneWrapper::returnMeshBvh(const uint32_t meshId, RT::Local<BVH> bvh)
+{
+	// A rebuild in the meantime already left a newer hierarchy behind
+	if (not meshBvhs[meshId])
+	{
+		meshBvhs[meshId] = std::move(bvh);
+	}
 }
 
-void SceneWrapper::addMesh(const RT::Mesh& mesh)
+std::optional<SceneWrapper::DirtyRegion> SceneWrapper::applyMeshUpdate(const uint32_t meshId, MeshUpdate update)
 {
-	const auto bvh = BVH(mesh);
+	// Build parameters changed while the update was underway
+	if (buildModes[meshId] != update.buildMode or binCount != update.binCount)
+	{
+		rebuildMesh(meshId);
+		return std::nullopt;
+	}
+
+	const auto& mesh = baseScene.meshes[meshId];
+	auto& bvh = meshBvhs[meshId];
+	bvh = std::move(update.build.bvh);
+	if (not update.dirtyBoxes)
+	{
+		replaceMesh(meshId, update.build.hierarchy, update.build.indices, update.build.nodes);
+		return std::nullopt;
+	}
+
+	// A rebuild of the previous mesh in the meantime may have left regions of another size behind
+	const auto& bvhHierarchy = bvh->getHierarchy();
+	const auto& bvhWideNodes = bvh->getWideNodes();
+	const auto& vertices = mesh.getModel().vertices;
+	const auto boxesRegion = getBoxesRegion(meshId);
+	const auto nodesRegion = getNodesRegion(meshId);
+	const auto verticesRegion = getVerticesRegion(meshId);
+	if (bvhHierarchy.size() != boxesRegion.y - boxesRegion.x or bvhWideNodes.size() != nodesRegion.y - nodesRegion.x
+		or vertices.size() != verticesRegion.y - verticesRegion.x)
+	{
+		replaceMesh(meshId, bvhHierarchy, bvh->buildTriangleIndices(mesh), bvhWideNodes);
+		return std::nullopt;
+	}
+
+	// Topology is kept, so the index triplets in leaf order are still the ones in the scene buffer
+	const auto dirtyBoxes = *update.dirtyBoxes;
+	std::copy(bvhHierarchy.begin() + dirtyBoxes.x, bvhHierarchy.begin() + dirtyBoxes.y, boundingBoxes.begin() + boxesRegion.x + dirtyBoxes.x);
+	writeVertices(verticesRegion.x, vertices);
 
-	const int32_t meshId = meshWrappers.size();
-	const auto trianglesOffset = triangles.size();
-	const auto boxesOffset = boundingBoxes.size();
-	const auto& bvhHierarchy = bvh.getHierarchy();
-	const auto bvhModel = bvh.buildTriangles();
+	// Wide nodes encode their children, so the dirty range is found by comparing the encodings
+	auto dirtyNodes = glm::uvec2{ nodesRegion.y, nodesRegion.x };
+	for (uint32_t i = 0u; i < bvhWideNodes.size(); i++)
+	{
+		auto& wideNode = wideNodes[nodesRegion.x + i];
+		if (0 != std::memcmp(&wideNode, &bvhWideNodes[i], sizeof(WideNode)))
+		{
+			wideNode = bvhWideNodes[i];
+			dirtyNodes.x = std::min(dirtyNodes.x, nodesRegion.x + i);
+			dirtyNodes.y = nodesRegion.x + i + 1u;
+		}
+	}
 
-	boundingBoxes.insert(boundingBoxes.end(), bvhHierarchy.begin(), bvhHierarchy.end());
-	triangles.insert(triangles.end(), bvhModel.begin(), bvhModel.end());
-	meshWrappers.emplace_back(MeshWrapper{ (uint32_t)boxesOffset, (uint32_t)trianglesOffset });
+	return DirtyRegion{ dirtyNodes.x < dirtyNodes.y ? dirtyNodes : glm::uvec2{ 0u }, glm::uvec2{ 0u }, verticesRegion };
 }
 
 void SceneWrapper::addMeshInstance(const RT::MeshInstance& object)
@@ -44,3 +156,215 @@ void SceneWrapper::removeInstanceWrapper(const uint32_t objectId)
 {
 	meshInstanceWrappers.erase(meshInstanceWrappers.begin() + objectId);
 }
+
+void SceneWrapper::buildInstanceHierarchy()
+{
+	instanceBvh.reset();
+	instanceBoxes.clear();
+	instanceIndices.clear();
+
+	if (meshInstanceWrappers.empty() and spheres.empty())
+	{
+		return;
+	}
+
+	instanceBvh = RT::makeLocal<BVH>(buildInstanceNodes());
+	instanceBoxes = instanceBvh->getHierarchy();
+	updateInstanceIndices();
+}
+
+void SceneWrapper::refitInstanceHierarchy()
+{
+	// Refit keeps the topology, so it is only valid while the set of instances and spheres stays the same
+	if (not instanceBvh or instanceIndices.size() != meshInstanceWrappers.size() + spheres.size())
+	{
+		buildInstanceHierarchy();
+		return;
+	}
+
+	instanceBvh->refit(buildInstanceNodes());
+	instanceBoxes = instanceBvh->getHierarchy();
+	updateInstanceIndices();
+}
+
+std::span<const BoundingBox> SceneWrapper::getMeshHierarchy(const uint32_t meshId) const
+{
+	const auto region = getBoxesRegion(meshId);
+	return std::span(boundingBoxes).subspan(region.x, region.y - region.x);
+}
+
+std::span<const glm::uvec3> SceneWrapper::getMeshTriangles(const uint32_t meshId) const
+{
+	const auto region = getTrianglesRegion(meshId);
+	return std::span(triangleIndices).subspan(region.x, region.y - region.x);
+}
+
+std::span<const VertexPosition> SceneWrapper::getMeshVertices(const uint32_t meshId) const
+{
+	const auto region = getVerticesRegion(meshId);
+	return std::span(vertexPositions).subspan(region.x, region.y - region.x);
+}
+
+SceneWrapper::MeshBuild SceneWrapper::buildMesh(const RT::Mesh& mesh, const BVH::BuildMode buildMode, const uint32_t binCount)
+{
+	auto build = MeshBuild{};
+	auto order = std::vector<uint32_t>{};
+	if (bvhCache.load(mesh, buildMode, binCount, build.hierarchy, build.indices, order, build.nodes))
+	{
+		build.bvh = RT::makeLocal<BVH>(mesh, buildMode, binCount, build.hierarchy, std::move(order), build.nodes);
+		return build;
+	}
+
+	build.bvh = RT::makeLocal<BVH>(mesh, buildMode, binCount);
+	build.hierarchy = build.bvh->getHierarchy();
+	build.indices = build.bvh->buildTriangleIndices(mesh);
+	build.nodes = build.bvh->getWideNodes();
+	bvhCache.store(mesh, buildMode, binCount, build.hierarchy, build.indices, build.bvh->getIndices(), build.nodes);
+	return build;
+}
+
+SceneWrapper::MeshUpdate SceneWrapper::updateMesh(RT::Local<BVH> bvh, const RT::Mesh& mesh, const uint32_t prevVertexCnt, const BVH::BuildMode buildMode, const uint32_t binCount)
+{
+	auto update = MeshUpdate{ .buildMode = buildMode, .binCount = binCount };
+
+	// A changed topology needs a new tree, and a changed vertex count moves the meshes after this one
+	if (mesh.getTriangleCount() != bvh->stats.triCnt or mesh.getModel().vertices.size() != prevVertexCnt)
+	{
+		update.build = buildMesh(mesh, buildMode, binCount);
+		return update;
+	}
+
+	// Degraded refit falls back to a full rebuild, which may change the node count and the duplicated triangles of SBVH
+	update.dirtyBoxes = bvh->refit(mesh);
+	if (not update.dirtyBoxes)
+	{
+		update.build.hierarchy = bvh->getHierarchy();
+		update.build.indices = bvh->buildTriangleIndices(mesh);
+		update.build.nodes = bvh->getWideNodes();
+	}
+	update.build.bvh = std::move(bvh);
+	return update;
+}
+
+void SceneWrapper::rebuildMesh(const uint32_t meshId)
+{
+	auto build = buildMesh(baseScene.meshes[meshId], buildModes[meshId], binCount);
+	meshBvhs[meshId] = std::move(build.bvh);
+
+	replaceMesh(meshId, build.hierarchy, build.indices, build.nodes);
+}
+
+void SceneWrapper::replaceMesh(const uint32_t meshId, const std::vector<BoundingBox>& hierarchy, const std::vector<glm::uvec3>& indices, const std::vector<WideNode>& nodes)
+{
+	const auto& vertices = baseScene.meshes[meshId].getModel().vertices;
+	const auto boxesRegion = getBoxesRegion(meshId);
+	const auto trianglesRegion = getTrianglesRegion(meshId);
+	const auto verticesRegion = getVerticesRegion(meshId);
+	const auto nodesRegion = getNodesRegion(meshId);
+
+	boundingBoxes.erase(boundingBoxes.begin() + boxesRegion.x, boundingBoxes.begin() + boxesRegion.y);
+	boundingBoxes.insert(boundingBoxes.begin() + boxesRegion.x, hierarchy.begin(), hierarchy.end());
+	triangleIndices.erase(triangleIndices.begin() + trianglesRegion.x, triangleIndices.begin() + trianglesRegion.y);
+	triangleIndices.insert(triangleIndices.begin() + trianglesRegion.x, indices.begin(), indices.end());
+	vertexPositions.erase(vertexPositions.begin() + verticesRegion.x, vertexPositions.begin() + verticesRegion.y);
+	vertexUVs.erase(vertexUVs.begin() + verticesRegion.x, vertexUVs.begin() + verticesRegion.y);
+	insertVertices(verticesRegion.x, vertices);
+	wideNodes.erase(wideNodes.begin() + nodesRegion.x, wideNodes.begin() + nodesRegion.y);
+	wideNodes.insert(wideNodes.begin() + nodesRegion.x, nodes.begin(), nodes.end());
+
+	// Meshes are packed back to back, so every one after the replaced mesh has to move
+	const int32_t boxesShift = hierarchy.size() - (boxesRegion.y - boxesRegion.x);
+	const int32_t trianglesShift = indices.size() - (trianglesRegion.y - trianglesRegion.x);
+	const int32_t verticesShift = vertices.size() - (verticesRegion.y - verticesRegion.x);
+	const int32_t nodesShift = nodes.size() - (nodesRegion.y - nodesRegion.x);
+	for (uint32_t i = meshId + 1u; i < meshWrappers.size(); i++)
+	{
+		meshWrappers[i].boxesRoot += boxesShift;
+		meshWrappers[i].modelRoot += trianglesShift;
+		meshWrappers[i].vertexRoot += verticesShift;
+		meshWrappers[i].bvhRoot += nodesShift;
+	}
+}
+
+void SceneWrapper::insertVertices(const uint32_t first, const std::vector<RT::Vertex>& vertices)
+{
+	vertexPositions.insert(vertexPositions.begin() + first, vertices.size(), VertexPosition{});
+	vertexUVs.insert(vertexUVs.begin() + first, vertices.size(), glm::vec2{});
+	writeVertices(first, vertices);
+}
+
+void SceneWrapper::writeVertices(const uint32_t first, const std::vector<RT::Vertex>& vertices)
+{
+	// Positions and uvs go to separate streams, the intersection loops never pull uvs into the cache
+	for (uint32_t i = 0u; i < vertices.size(); i++)
+	{
+		vertexPositions[first + i] = VertexPosition{ vertices[i].position, 0.0f };
+		vertexUVs[first + i] = vertices[i].uv;
+	}
+}
+
+glm::uvec2 SceneWrapper::getBoxesRegion(const uint32_t meshId) const
+{
+	const uint32_t end = meshId + 1u < meshWrappers.size() ? meshWrappers[meshId + 1u].boxesRoot : boundingBoxes.size();
+	return { meshWrappers[meshId].boxesRoot, end };
+}
+
+glm::uvec2 SceneWrapper::getNodesRegion(const uint32_t meshId) const
+{
+	const uint32_t end = meshId + 1u < meshWrappers.size() ? meshWrappers[meshId + 1u].bvhRoot : wideNodes.size();
+	return { meshWrappers[meshId].bvhRoot, end };
+}
+
+glm::uvec2 SceneWrapper::getTrianglesRegion(const uint32_t meshId) const
+{
+	const uint32_t end = meshId + 1u < meshWrappers.size() ? meshWrappers[meshId + 1u].modelRoot : triangleIndices.size();
+	return { meshWrappers[meshId].modelRoot, end };
+}
+
+glm::uvec2 SceneWrapper::getVerticesRegion(const uint32_t meshId) const
+{
+	const uint32_t end = meshId + 1u < meshWrappers.size() ? meshWrappers[meshId + 1u].vertexRoot : vertexPositions.size();
+	return { meshWrappers[meshId].vertexRoot, end };
+}
+
+std::vector<Node> SceneWrapper::buildInstanceNodes() const
+{
+	auto instanceNodes = std::vector<Node>{};
+	instanceNodes.reserve(meshInstanceWrappers.size() + spheres.size());
+
+	for (const auto& instance : meshInstanceWrappers)
+	{
+		const auto& meshRoot = boundingBoxes[meshWrappers[instance.meshId].boxesRoot];
+		const auto localToWorld = glm::inverse(instance.worldToLocalMatrix);
+
+		// Transform center and half extent instead of all 8 corners (Arvo)
+		const auto localCenter = 0.5f * (meshRoot.vMin + meshRoot.vMax);
+		const auto localExtent = glm::max(0.5f * (meshRoot.vMax - meshRoot.vMin), glm::vec3{ 0.0f });
+
+		const auto worldCenter = glm::vec3{ localToWorld * glm::vec4{ localCenter, 1.0f } };
+		const auto worldExtent = glm::abs(glm::vec3{ localToWorld[0] }) * localExtent.x
+			+ glm::abs(glm::vec3{ localToWorld[1] }) * localExtent.y
+			+ glm::abs(glm::vec3{ localToWorld[2] }) * localExtent.z;
+
+		instanceNodes.emplace_back(Node{ worldCenter - worldExtent, worldCenter + worldExtent, worldCenter });
+	}
+
+	for (const auto& sphere : spheres)
+	{
+		const auto extent = glm::vec3{ sphere.radius };
+		instanceNodes.emplace_back(Node{ sphere.position - extent, sphere.position + extent, sphere.position });
+	}
+
+	return instanceNodes;
+}
+
+void SceneWrapper::updateInstanceIndices()
+{
+	// Spheres are appended after the instances, so their primitive index is shifted back and tagged
+	const uint32_t instanceCount = meshInstanceWrappers.size();
+	instanceIndices = instanceBvh->getIndices();
+	for (auto& index : instanceIndices)
+	{
+		index = index < instanceCount ? index : (index - instanceCount) | sphereFlag;
+	}
+}
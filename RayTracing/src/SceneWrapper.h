@@ -1,5 +1,9 @@
 #pragma once
+#include <optional>
+#include <span>
+
 #include "BVH.h"
+#include "BVHCache.h"
 
 #include "Engine/Render/Scene.h"
 
@@ -12,12 +16,22 @@ struct Sphere
 };
 #pragma pack(pop)
 
+// Vertex shared by the triangles of a mesh, the intersection tests only read its position
+#pragma pack(push, 1)
+struct VertexPosition
+{
+	glm::vec3 position; float pad;
+};
+#pragma pack(pop)
+
 #pragma pack(push, 1)
 struct MeshWrapper
 {
 	uint32_t bvhRoot;
 	uint32_t modelRoot;
-	int32_t materialId; float pad[1];
+	int32_t materialId;
+	uint32_t boxesRoot;
+	uint32_t vertexRoot; uint32_t pad[3];
 };
 #pragma pack(pop)
 
@@ -32,22 +46,101 @@ struct MeshInstanceWrapper
 
 class SceneWrapper
 {
+public:
+	struct DirtyRegion
+	{
+		glm::uvec2 nodes;
+		glm::uvec2 triangles;
+		glm::uvec2 vertices;
+	};
+
+	// Hierarchy of a mesh not yet placed in the scene buffers, indices are relative to the mesh
+	struct MeshBuild
+	{
+		RT::Local<BVH> bvh;
+		std::vector<BoundingBox> hierarchy;
+		std::vector<glm::uvec3> indices;
+		std::vector<WideNode> nodes;
+	};
+
+	// Hierarchy of a reloaded mesh made away from the scene, a kept topology only refits the boxes
+	struct MeshUpdate
+	{
+		MeshBuild build;
+		std::optional<glm::uvec2> dirtyBoxes;	// set by a refit, the hierarchy is then read from build.bvh
+		BVH::BuildMode buildMode;
+		uint32_t binCount;
+	};
+
+public:
+	// Top level leafs reference mesh instances, or spheres when tagged with this bit
+	static constexpr uint32_t sphereFlag = 1u << 31u;
+
 public:
 	SceneWrapper(RT::Scene& scene);
+	SceneWrapper(SceneWrapper&&) = default;
 	~SceneWrapper() = default;
 
 	void build();
-	void addMesh(const RT::Mesh& mesh);
+	void addMesh(const RT::Mesh& mesh, const BVH::BuildMode buildMode = BVH::BuildMode::SAH);
+	void addMesh(const RT::Mesh& mesh, const BVH::BuildMode buildMode, MeshBuild build);
+	void setBuildMode(const uint32_t meshId, const BVH::BuildMode buildMode);
+	void setBinCount(const uint32_t binCount);
+	uint32_t getBinCount() const { return binCount; }
+	// Hands the hierarchy of a mesh to an update running elsewhere, applyMeshUpdate or returnMeshBvh gives it back
+	RT::Local<BVH> takeMeshBvh(const uint32_t meshId) { return std::move(meshBvhs[meshId]); }
+	void returnMeshBvh(const uint32_t meshId, RT::Local<BVH> bvh);
+	// Expects the reloaded mesh in the scene already, returns the refitted ranges when the buffers kept their layout
+	std::optional<DirtyRegion> applyMeshUpdate(const uint32_t meshId, MeshUpdate update);
 	void addMeshInstance(const RT::MeshInstance& object);
 	void removeInstanceWrapper(const uint32_t objectId);
+	void buildInstanceHierarchy();
+	void refitInstanceHierarchy();
+
+	// Traversal buffers bound to another scene holding the materials, for tracers running while this one changes
+	SceneWrapper snapshot(RT::Scene& scene) const;
+
+	// Binary hierarchy of a mesh with child and leaf indices relative to its own region
+	std::span<const BoundingBox> getMeshHierarchy(const uint32_t meshId) const;
+	// Index triplets are relative to the mesh's vertex region
+	std::span<const glm::uvec3> getMeshTriangles(const uint32_t meshId) const;
+	std::span<const VertexPosition> getMeshVertices(const uint32_t meshId) const;
+
+	// Touch no scene state, so imports call them from their own threads
+	static MeshBuild buildMesh(const RT::Mesh& mesh, const BVH::BuildMode buildMode, const uint32_t binCount);
+	static MeshUpdate updateMesh(RT::Local<BVH> bvh, const RT::Mesh& mesh, const uint32_t prevVertexCnt, const BVH::BuildMode buildMode, const uint32_t binCount);
+
+private:
+	void rebuildMesh(const uint32_t meshId);
+	void replaceMesh(const uint32_t meshId, const std::vector<BoundingBox>& hierarchy, const std::vector<glm::uvec3>& indices, const std::vector<WideNode>& nodes);
+	void insertVertices(const uint32_t first, const std::vector<RT::Vertex>& vertices);
+	void writeVertices(const uint32_t first, const std::vector<RT::Vertex>& vertices);
+	glm::uvec2 getBoxesRegion(const uint32_t meshId) const;
+	glm::uvec2 getNodesRegion(const uint32_t meshId) const;
+	glm::uvec2 getTrianglesRegion(const uint32_t meshId) const;
+	glm::uvec2 getVerticesRegion(const uint32_t meshId) const;
+	std::vector<Node> buildInstanceNodes() const;
+	void updateInstanceIndices();
 
 public:
 	std::vector<Sphere> spheres;
 	std::vector<BoundingBox> boundingBoxes;
-	std::vector<RT::Triangle> triangles;
+	std::vector<WideNode> wideNodes;
+	std::vector<glm::uvec3> triangleIndices;
+	std::vector<VertexPosition> vertexPositions;
+	std::vector<glm::vec2> vertexUVs;
 	std::vector<MeshWrapper> meshWrappers;
 	std::vector<MeshInstanceWrapper> meshInstanceWrappers;
+	std::vector<BVH::BuildMode> buildModes;
+	std::vector<BoundingBox> instanceBoxes;
+	std::vector<uint32_t> instanceIndices;
 
 private:
 	RT::Scene& baseScene;
+	std::vector<RT::Local<BVH>> meshBvhs;
+	RT::Local<BVH> instanceBvh;
+	uint32_t binCount = BVH::defaultBinCount;
+
+	inline static const auto cacheDir = std::filesystem::path("cache") / "bvh";
+	inline static const auto bvhCache = BVHCache{ cacheDir };
 };
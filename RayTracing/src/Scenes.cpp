@@ -0,0 +1,253 @@
+#include "Scenes.h"
+
+#include <limits>
+
+#include "Engine/Core/Log.h"
+
+namespace Scenes
+{
+
+	bool load(const int32_t sceneNr, RT::Scene& scene, SceneWrapper& sceneWrapper, std::vector<std::filesystem::path>& texturePaths)
+	{
+		switch (sceneNr)
+		{
+			case 1:
+			{
+				//**// SCENE 1 //**//
+				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
+				scene.materials.emplace_back(RT::Material{ { 0.0f, 0.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
+				scene.materials.emplace_back(RT::Material{ { 1.0f, 0.0f, 0.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
+
+				sceneWrapper.spheres.emplace_back(Sphere{ { 0.0f, 0.0f, -10007.0f }, 10000.0f, 0 });
+				sceneWrapper.spheres.emplace_back(Sphere{ { 0.0f, 0.0f, 10003.0f }, 10000.0f, 0 });
+				sceneWrapper.spheres.emplace_back(Sphere{ { 0.0f, -10001.0f, -2.0f }, 10000.0f, 0 });
+				sceneWrapper.spheres.emplace_back(Sphere{ { 0.0f, 10009.0f, -2.0f }, 10000.0f, 0 });
+				sceneWrapper.spheres.emplace_back(Sphere{ { -10005.0f, 0.0f, -2.0f }, 10000.0f, 1 });
+				sceneWrapper.spheres.emplace_back(Sphere{ { 10005.0f, 0.0f, -2.0f }, 10000.0f, 2 });
+
+				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 1.0f, 1.0f, -1 });
+				sceneWrapper.spheres.emplace_back(Sphere{ { 0.0f, 18.8f, -2.0f }, 10.0f, 3 });
+				//**// SCENE 1 //**//
+			
+				break;
+			}
+
+			case 2:
+			{
+				//**// SCENE 2 //**//
+				texturePaths.push_back(assetDir / "textures" / "templategrid_albedo.png");
+
+				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.7f, 0.0f, 0.0f, 1.5f, -1 });
+				scene.materials.emplace_back(RT::Material{ { 0.2f, 0.5f, 0.7f }, 0.0, { 0.2f, 0.5f, 0.7f }, 0.0f, 0.0f, 0.0f, 1.0f,  0 });
+				scene.materials.emplace_back(RT::Material{ { 0.8f, 0.6f, 0.5f }, 0.0, { 0.8f, 0.6f, 0.5f }, 0.0f, 0.0f, 1.0f, 1.0f, -1 });
+				scene.materials.emplace_back(RT::Material{ { 0.4f, 0.3f, 0.8f }, 0.0, { 0.8f, 0.6f, 0.5f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
+
+				sceneWrapper.spheres.emplace_back(Sphere{ { 0.0f, 0.0f, -2.0f }, 1.0f, 0 });
+				
+				auto triBuffer = std::vector<RT::Triangle>{
+					RT::Triangle{
+						{ -50.0f, -1.0f, -50.0f }, { -50.0f, -1.0f,  50.0f }, {  50.0f, -1.0f, -50.0f },
+						{  0.0,  0.0 }, {  0.0, 10.0 }, { 10.0,  0.0 }},
+					RT::Triangle{
+						{  50.0f, -1.0f,  50.0f }, {  50.0f, -1.0f, -50.0f }, { -50.0f, -1.0f,  50.0f },
+						{ 10.0, 10.0 }, { 10.0,  0.0 }, {  0.0, 10.0 }}};
+				scene.meshes.emplace_back(triBuffer);
+				
+				scene.objects.emplace_back(0);
+				scene.objects[0].materialId = 1;
+
+				sceneWrapper.spheres.emplace_back(Sphere{ {  2.5f, 0.0f, -2.0f }, 1.0f, 2 });
+				sceneWrapper.spheres.emplace_back(Sphere{ { -2.5f, 0.0f, -2.0f }, 1.0f, 3 });
+
+				//auto pcg_hash = [](uint32_t input) -> uint32_t
+				//{
+				//	uint32_t state = input * 747796405u + 2891336453u;
+				//	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+				//	return (word >> 22u) ^ word;
+				//};
+
+				//auto FastRandom = [&pcg_hash](uint32_t& seed) -> float
+				//{
+				//	seed = pcg_hash(seed);
+				//	return (float)seed / std::numeric_limits<uint32_t>::max();
+				//}
+
+				//uint32_t seed = 93262352u;
+				//auto getRandPos = [&seed](float rad) { return FastRandom(seed) * rad - rad / 2; };
+
+				//for (int i = 0; i < 70; i++)
+				//{
+				//	scene.materials.emplace_back(RT::Material{ });
+				//	scene.materials[scene.materials.size() - 1].albedo = { FastRandom(seed), FastRandom(seed), FastRandom(seed) };
+				//	scene.materials[scene.materials.size() - 1].emissionColor = { FastRandom(seed), FastRandom(seed), FastRandom(seed) };
+				//	scene.materials[scene.materials.size() - 1].roughness = FastRandom(seed) > 0.9 ? 0.f : FastRandom(seed);
+				//	scene.materials[scene.materials.size() - 1].metalic = FastRandom(seed) > 0.9 ? FastRandom(seed) : 0.f;
+				//	scene.materials[scene.materials.size() - 1].specularProbability= FastRandom(seed) > 0.9 ? FastRandom(seed) : 0.f;
+				//	scene.materials[scene.materials.size() - 1].emissionPower = FastRandom(seed) > 0.9 ? FastRandom(seed) : 0.f;
+				//	scene.materials[scene.materials.size() - 1].refractionRatio = 1.0f;
+				//	scene.materials[scene.materials.size() - 1].textureId = -1;
+
+				//	scene.spheres.emplace_back(RT::Sphere{ });
+				//	scene.spheres[scene.spheres.size() - 1].position = { getRandPos(10.0f), -0.75, getRandPos(10.0f) - 2 };
+				//	scene.spheres[scene.spheres.size() - 1].radius = 0.25;
+				//	scene.spheres[scene.spheres.size() - 1].materialId = scene.materials.size() - 1;
+				//}
+				//**// SCENE 2 //**//
+			
+				break;
+			}
+
+			case 3:
+			{
+				//**// SCENE 3 //**//
+				texturePaths.push_back(assetDir / "textures" / "checkered.jpg");
+
+				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
+				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f,  0 });
+				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
+				scene.materials.emplace_back(RT::Material{ { 1.0f, 0.0f, 0.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
+				scene.materials.emplace_back(RT::Material{ { 0.0f, 1.0f, 0.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
+				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 8.0f, 1.0f, -1 });
+
+				scene.meshes.emplace_back().load(assetDir / "models" / "tinyStanfordDragon.glb");
+				auto& dragon = scene.objects.emplace_back(0);
+				dragon.position = glm::vec3{ 0.0f, 1.4f, -2.0f };
+				dragon.scale = glm::vec3{ 5.0f };
+				dragon.rotation = glm::vec3{ 0.0f, 128.0, 0.0f };
+				dragon.materialId = 0;
+
+				auto triBottom = std::vector<RT::Triangle>{
+					RT::Triangle{
+						{  3.0f, 0.0f,  1.0f }, {  3.0f, 0.0f, -5.0f }, { -3.0f, 0.0f, 1.0f },
+						{ 0.0, 0.0 }, { 0.0, 1.0 }, { 1.0, 0.0 }},
+					RT::Triangle{
+						{ -3.0f, 0.0f, -5.0f }, { -3.0f, 0.0f,  1.0f }, {  3.0f, 0.0f, -5.0f },
+						{ 1.0, 1.0 }, { 1.0, 0.0 }, { 0.0, 1.0 }}};
+				auto triTop = std::vector<RT::Triangle>{
+					RT::Triangle{
+						{  3.0f, 6.0f, -5.0f }, {  3.0f, 6.0f,  1.0f }, { -3.0f, 6.0f, -5.0f },
+						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }},
+					RT::Triangle{
+						{ -3.0f, 6.0f, -5.0f }, {  3.0f, 6.0f,  1.0f }, { -3.0f, 6.0f,  1.0f },
+						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }}};
+				auto triBack = std::vector<RT::Triangle>{
+					RT::Triangle{
+						{  3.0f, 0.0f, -5.0f }, {  3.0f, 6.0f, -5.0f }, { -3.0f, 0.0f, -5.0f },
+						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }},
+					RT::Triangle{
+						{ -3.0f, 0.0f, -5.0f }, {  3.0f, 6.0f, -5.0f }, { -3.0f, 6.0f, -5.0f },
+						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }} };
+				auto triFront = std::vector<RT::Triangle>{
+					RT::Triangle{
+						{  3.0f, 6.0f, 1.0f }, {  3.0f, 0.0f, 1.0f }, { -3.0f, 0.0f, 1.0f },
+						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }},
+					RT::Triangle{
+						{  3.0f, 6.0f, 1.0f }, { -3.0f, 0.0f, 1.0f }, { -3.0f, 6.0f, 1.0f },
+						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }} };
+				auto triLeft = std::vector<RT::Triangle>{
+					RT::Triangle{
+						{ 3.0f, 0.0f, -5.0f }, { 3.0f, 0.0f,  1.0f }, { 3.0f, 6.0f, -5.0f },
+						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }
+					},
+					RT::Triangle{
+						{ 3.0f, 0.0f,  1.0f }, { 3.0f, 6.0f,  1.0f }, { 3.0f, 6.0f, -5.0f },
+						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }} };
+				auto triRight = std::vector<RT::Triangle>{
+					RT::Triangle{
+						{ -3.0f, 0.0f, -5.0f }, { -3.0f, 6.0f, -5.0f }, { -3.0f, 0.0f,  1.0f },
+						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }},
+					RT::Triangle{
+						{ -3.0f, 0.0f,  1.0f }, { -3.0f, 6.0f, -5.0f }, { -3.0f, 6.0f,  1.0f },
+						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }} };
+
+				auto triLight = std::vector<RT::Triangle>{
+					RT::Triangle{
+						{  1.0f, 5.9f, -3.0f }, {  1.0f, 5.9f, -1.0f }, { -1.0f, 5.9f, -3.0f },
+						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }},
+					RT::Triangle{
+						{ -1.0f, 5.9f, -3.0f }, {  1.0f, 5.9f, -1.0f }, { -1.0f, 5.9f, -1.0f },
+						{ 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 }}};
+
+				scene.meshes.emplace_back(triBottom);
+				scene.meshes.emplace_back(triTop);
+				scene.meshes.emplace_back(triBack);
+				scene.meshes.emplace_back(triFront);
+				scene.meshes.emplace_back(triLeft);
+				scene.meshes.emplace_back(triRight);
+				scene.meshes.emplace_back(triLight);
+
+				scene.objects.emplace_back(1).materialId = 1;
+				scene.objects.emplace_back(2).materialId = 2;
+				scene.objects.emplace_back(3).materialId = 2;
+				scene.objects.emplace_back(4).materialId = 2;
+				scene.objects.emplace_back(5).materialId = 3;
+				scene.objects.emplace_back(6).materialId = 4;
+				scene.objects.emplace_back(7).materialId = 5;
+				//**// SCENE 3 //**//
+
+				break;
+			}
+			case 4:
+			{
+				//**// SCENE 4 //**//
+				// Dev platform
+				scene.materials.emplace_back(RT::Material{ { 1.0f, 1.0f, 1.0f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
+
+				scene.meshes.emplace_back().load(assetDir / "models" / "tinyStanfordDragon.glb");
+				scene.objects.emplace_back(0);
+				//**// SCENE 4 //**//
+
+				break;
+			}
+			case 5:
+			{
+				//**// SCENE 5 //**//
+				// Sphere field, stresses the top level hierarchy
+				scene.materials.emplace_back(RT::Material{ { 0.8f, 0.8f, 0.8f }, 0.0, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, 0.0f, 1.0f, -1 });
+				sceneWrapper.spheres.emplace_back(Sphere{ { 0.0f, -10001.0f, -2.0f }, 10000.0f, 0 });
+
+				const auto pcgHash = [](const uint32_t input)
+				{
+					const uint32_t state = input * 747796405u + 2891336453u;
+					const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+					return (word >> 22u) ^ word;
+				};
+
+				uint32_t seed = 93262352u;
+				const auto fastRandom = [&pcgHash, &seed]
+				{
+					seed = pcgHash(seed);
+					return (float)seed / std::numeric_limits<uint32_t>::max();
+				};
+
+				constexpr uint32_t paletteSize = 16u;
+				for (uint32_t i = 0u; i < paletteSize; i++)
+				{
+					const auto albedo = glm::vec3{ fastRandom(), fastRandom(), fastRandom() };
+					const float emissionPower = fastRandom() > 0.9f ? 4.0f * fastRandom() : 0.0f;
+					scene.materials.emplace_back(RT::Material{ albedo, 0.0, albedo, fastRandom(), fastRandom() > 0.8f ? fastRandom() : 0.0f, emissionPower, 1.0f, -1 });
+				}
+
+				constexpr uint32_t sphereCount = 10000u;
+				constexpr float fieldSize = 200.0f;
+				for (uint32_t i = 0u; i < sphereCount; i++)
+				{
+					const float radius = 0.1f + 0.4f * fastRandom();
+					const auto position = glm::vec3{ (fastRandom() - 0.5f) * fieldSize, radius - 1.0f, (fastRandom() - 0.5f) * fieldSize - 2.0f };
+					sceneWrapper.spheres.emplace_back(Sphere{ position, radius, 1 + (int32_t)(pcgHash(i) % paletteSize) });
+				}
+				//**// SCENE 5 //**//
+
+				break;
+			}
+			default:
+			{
+				LOG_WARN("Unknown scene {}", sceneNr);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+}
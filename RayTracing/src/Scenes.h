@@ -0,0 +1,22 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+
+#include "SceneWrapper.h"
+
+/*
+* Built-in scenes shared by the interactive client and headless renders. Loading only
+* fills the host side scene, building the wrapper and uploading stays with the caller.
+*/
+namespace Scenes
+{
+
+	inline const auto assetDir = std::filesystem::path("assets");
+	inline const auto skyMapPath = assetDir / "skyMaps" / "evening_road_01_puresky_1k.hdr";
+
+	constexpr int32_t count = 5;
+
+	// Texture ids of the loaded materials index into texturePaths
+	bool load(const int32_t sceneNr, RT::Scene& scene, SceneWrapper& sceneWrapper, std::vector<std::filesystem::path>& texturePaths);
+
+}